@@ -13,6 +13,8 @@ https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
 #include "context.h"
 #include "log.h"
 #include "nbsf-management-build.h"
+#include "pcf-binding-ref.h"
+#include "ue-identity-key.h"
 #include "utils.h"
 
 #include "bsf-client-sess.h"
@@ -21,22 +23,29 @@ https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
 extern "C" {
 #endif
 
+static void __ue_identity_clear(bsf_client_sess_t *sess);
+
 bsf_client_sess_t *_bsf_client_sess_new(void)
 {
     bsf_client_sess_t *sess;
 
-    sess = ogs_calloc(1, sizeof(*sess));
-    ogs_assert(sess);
+    sess = _bsf_client_context_active_sessions_new();
+    if (!sess) {
+        ogs_error("No more BSF client sessions available");
+        return NULL;
+    }
 
-    _bsf_client_context_active_sessions_add(sess);
+    ogs_list_init(&sess->retrieve_callbacks);
 
     return sess;
 }
 
 void _bsf_client_sess_free(bsf_client_sess_t *sess)
 {
+    bsf_client_sess_retrieve_callback_t *cb, *next;
+
     if (!sess) return;
-    _bsf_client_context_active_sessions_remove(sess);
+    if (sess->is_pending_lookup) _bsf_client_context_pending_lookups_remove(sess);
     ogs_sbi_object_free(&sess->sbi);
     if (sess->ue_address) {
         ogs_freeaddrinfo(sess->ue_address);
@@ -50,22 +59,39 @@ void _bsf_client_sess_free(bsf_client_sess_t *sess)
         ogs_free(sess->ipv6prefix);
         sess->ipv6prefix = NULL;
     }
-    ogs_free(sess);
+    __ue_identity_clear(sess);
+    ogs_list_for_each_safe(&sess->retrieve_callbacks, next, cb) {
+        ogs_list_remove(&sess->retrieve_callbacks, cb);
+        ogs_free(cb);
+    }
+    _bsf_client_context_active_sessions_free(sess);
 }
 
 void _bsf_client_sess_log_debug(bsf_client_sess_t *sess, int indent)
 {
     char *ue_addr;
+    bsf_client_sess_retrieve_callback_t *cb;
 
     if (!sess) return;
 
+    ogs_debug("%*sSession id = %u", indent, "", sess->id);
     ogs_debug("%*sSBI object = %p", indent, "", &sess->sbi);
-    ue_addr = _sockaddr_string(sess->ue_address);
-    ogs_debug("%*sUE Address = %s", indent, "", ue_addr);
-    ogs_free(ue_addr);
+    if (sess->ue_address) {
+        ue_addr = _sockaddr_string(sess->ue_address);
+        ogs_debug("%*sUE Address = %s", indent, "", ue_addr);
+        ogs_free(ue_addr);
+    }
     ogs_debug("%*sIPv4 Address = %s", indent, "", sess->ipv4addr ? sess->ipv4addr : "<not set>");
     ogs_debug("%*sIPv6 Prefix = %s", indent, "", sess->ipv6prefix ? sess->ipv6prefix : "<not set>");
-    ogs_debug("%*sCallback = %p (..., %p)", indent, "", sess->retrieve.callback, sess->retrieve.user_data);
+    if (sess->identity_key) ogs_debug("%*sUE Identity = %s", indent, "", sess->identity_key);
+    ogs_debug("%*sPending lookup = %s", indent, "", sess->is_pending_lookup ? "yes" : "no");
+    ogs_list_for_each(&sess->retrieve_callbacks, cb) {
+        if (cb->ref_callback) {
+            ogs_debug("%*sReference callback = %p (..., %p)", indent, "", cb->ref_callback, cb->user_data);
+        } else {
+            ogs_debug("%*sCallback = %p (..., %p)", indent, "", cb->callback, cb->user_data);
+        }
+    }
 }
 
 bool _bsf_client_sess_ue_address_set(bsf_client_sess_t *sess, const ogs_sockaddr_t *ue_address)
@@ -76,9 +102,12 @@ bool _bsf_client_sess_ue_address_set(bsf_client_sess_t *sess, const ogs_sockaddr
             ogs_freeaddrinfo(sess->ue_address);
             sess->ue_address = NULL;
         }
+        memset(&sess->lookup_key, 0, sizeof(sess->lookup_key));
     } else {
         if (sess->ue_address) ogs_freeaddrinfo(sess->ue_address);
         ogs_copyaddrinfo(&sess->ue_address, (ogs_sockaddr_t*)ue_address);
+        if (!_ue_address_key_from_sockaddr(&sess->lookup_key, ue_address))
+            memset(&sess->lookup_key, 0, sizeof(sess->lookup_key));
     }
     return true;
 }
@@ -111,49 +140,139 @@ bool _bsf_client_sess_ipv6prefix_set_from_sockaddr(bsf_client_sess_t *sess, cons
     return true;
 }
 
-bool _bsf_client_sess_retrieve_callback_set(bsf_client_sess_t *sess, bsf_retrieve_callback_f cb, void *user_data)
+/* Look up by SUPI or GPSI, optionally for one DNN or DNN and S-NSSAI, instead of by UE address */
+bool _bsf_client_sess_ue_identity_set(bsf_client_sess_t *sess, const char *supi, const char *gpsi, const char *dnn, const OpenAPI_snssai_t *snssai)
 {
+    char *identity_key;
+
     if (!sess) return false;
-    
-    sess->retrieve.callback = cb;
-    sess->retrieve.user_data = user_data;
+
+    identity_key = supi ? _ue_identity_key_new("supi", supi, dnn, snssai) : _ue_identity_key_new("gpsi", gpsi, dnn, snssai);
+    if (!identity_key) return false;
+
+    __ue_identity_clear(sess);
+    sess->identity_key = identity_key;
+    if (supi) sess->supi = ogs_strdup(supi);
+    if (gpsi) sess->gpsi = ogs_strdup(gpsi);
+    if (dnn) sess->dnn = ogs_strdup(dnn);
+    if (snssai) sess->snssai = OpenAPI_snssai_copy(NULL, (OpenAPI_snssai_t*)snssai);
 
     return true;
 }
 
-bool _bsf_client_sess_retrieve_callback_call(bsf_client_sess_t *sess, const OpenAPI_pcf_binding_t *binding)
+/* What this session is looking up, for log messages, to be ogs_free()d */
+char *_bsf_client_sess_lookup_string(const bsf_client_sess_t *sess)
+{
+    if (sess->identity_key) return ogs_strdup(sess->identity_key);
+    if (sess->ue_address) return _sockaddr_string(sess->ue_address);
+    return ogs_strdup("<unknown>");
+}
+
+bool _bsf_client_sess_retrieve_callback_add(bsf_client_sess_t *sess, bsf_retrieve_callback_f cb, bsf_retrieve_ref_callback_f ref_cb, void *user_data)
 {
-    OpenAPI_pcf_binding_t *bind_copy = NULL;
-    bool ret;
+    bsf_client_sess_retrieve_callback_t *node;
 
     if (!sess) return false;
-    if (!sess->retrieve.callback) return false;
+    if (!cb && !ref_cb) return false;
 
-    if (binding)
-        bind_copy = OpenAPI_pcf_binding_copy(NULL, (OpenAPI_pcf_binding_t*)binding);
+    node = ogs_calloc(1, sizeof(*node));
+    ogs_assert(node);
+    node->callback = cb;
+    node->ref_callback = ref_cb;
+    node->user_data = user_data;
+    ogs_list_add(&sess->retrieve_callbacks, node);
 
-    ret = sess->retrieve.callback(bind_copy, sess->retrieve.user_data);
-    if (!ret) {
-        ogs_error("BSF client callback failed");
-        OpenAPI_pcf_binding_free(bind_copy);
+    return true;
+}
+
+bool _bsf_client_sess_retrieve_callback_call(bsf_client_sess_t *sess, bsf_pcf_binding_t *binding)
+{
+    bsf_client_sess_retrieve_callback_t *cb;
+    bool ret = true;
+
+    if (!sess) return false;
+
+    /* background revalidations have no one waiting */
+    ogs_list_for_each(&sess->retrieve_callbacks, cb) {
+        if (!_bsf_client_retrieve_callback_deliver(cb->callback, cb->ref_callback, cb->user_data, binding))
+            ret = false;
     }
 
     return ret;
 }
 
+/* The BSF could not be asked, answer with a stale-if-error binding if the cache still has one */
+bool _bsf_client_sess_retrieve_callback_call_on_error(bsf_client_sess_t *sess)
+{
+    bsf_pcf_binding_t *binding;
+
+    if (!sess) return false;
+
+    if (sess->identity_key) {
+        binding = _bsf_client_pcf_bindings_stale_if_error_from_cache_by_identity(sess->identity_key);
+    } else {
+        binding = _bsf_client_pcf_bindings_stale_if_error_from_cache(&sess->lookup_key);
+    }
+    if (binding) ogs_warn("BSF unavailable, using stale PCF binding");
+
+    return _bsf_client_sess_retrieve_callback_call(sess, binding);
+}
+
+bool _bsf_client_retrieve_callback_deliver(bsf_retrieve_callback_f cb, bsf_retrieve_ref_callback_f ref_cb, void *user_data, bsf_pcf_binding_t *binding)
+{
+    if (ref_cb) {
+        /* hand out a reference to the shared binding, no copying */
+        _bsf_pcf_binding_ref(binding);
+        if (!ref_cb(binding, user_data)) {
+            ogs_error("BSF client callback failed");
+            _bsf_pcf_binding_unref(binding);
+            return false;
+        }
+    } else if (cb) {
+        /* compatibility: the callback owns its own copy of the binding */
+        OpenAPI_pcf_binding_t *bind_copy = NULL;
+
+        if (binding)
+            bind_copy = OpenAPI_pcf_binding_copy(NULL, (OpenAPI_pcf_binding_t*)_bsf_pcf_binding_get(binding));
+
+        if (!cb(bind_copy, user_data)) {
+            ogs_error("BSF client callback failed");
+            OpenAPI_pcf_binding_free(bind_copy);
+            return false;
+        }
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
 bool _bsf_client_sess_discover_and_send(bsf_client_sess_t *sess)
 {
     int rv;
     ogs_sbi_xact_t *xact;
+    ogs_sbi_client_t *client;
 
     if (!sess) return false;
 
-    xact = ogs_sbi_xact_add(0, &sess->sbi, OGS_SBI_SERVICE_TYPE_NBSF_MANAGEMENT, NULL, (ogs_sbi_build_f)_nbsf_management_pcf_binding_build, sess, NULL);
+    xact = ogs_sbi_xact_add(sess->id, &sess->sbi, OGS_SBI_SERVICE_TYPE_NBSF_MANAGEMENT, NULL, (ogs_sbi_build_f)_nbsf_management_pcf_binding_build, sess, NULL);
     if (!xact) {
         ogs_error("bsf_client_sess_discover_and_send() failed");
         return false;
     }
 
+    /* A statically configured BSF doesn't need NRF discovery */
+    client = _bsf_client_context_get_bsf_client();
+    if (client) {
+        ogs_debug("Sending BSF query directly to configured BSF");
+        if (!ogs_sbi_send_request_to_client(client, ogs_sbi_client_handler, xact->request, OGS_UINT_TO_POINTER(xact->id))) {
+            ogs_error("bsf_client_sess_discover_and_send() failed");
+            ogs_sbi_xact_remove(xact);
+            return false;
+        }
+        return true;
+    }
+
     ogs_debug("Sending BSF query");
     rv = ogs_sbi_discover_and_send(xact);
     if (rv != OGS_OK) {
@@ -165,6 +284,32 @@ bool _bsf_client_sess_discover_and_send(bsf_client_sess_t *sess)
     return true;
 }
 
+/*** Private functions ***/
+
+static void __ue_identity_clear(bsf_client_sess_t *sess)
+{
+    if (sess->identity_key) {
+        ogs_free(sess->identity_key);
+        sess->identity_key = NULL;
+    }
+    if (sess->supi) {
+        ogs_free(sess->supi);
+        sess->supi = NULL;
+    }
+    if (sess->gpsi) {
+        ogs_free(sess->gpsi);
+        sess->gpsi = NULL;
+    }
+    if (sess->dnn) {
+        ogs_free(sess->dnn);
+        sess->dnn = NULL;
+    }
+    if (sess->snssai) {
+        OpenAPI_snssai_free(sess->snssai);
+        sess->snssai = NULL;
+    }
+}
+
 #ifdef __cplusplus
 }
 #endif
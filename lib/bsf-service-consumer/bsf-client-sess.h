@@ -13,6 +13,7 @@ https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
 #include "ogs-sbi.h"
 
 #include "bsf-service-consumer.h"
+#include "ue-address-key.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -20,18 +21,33 @@ extern "C" {
 
 typedef struct ogs_sockaddr_s ogs_sockaddr_t;
 
+typedef struct bsf_client_sess_retrieve_callback_s {
+    ogs_lnode_t node;
+    bsf_retrieve_callback_f callback;         /* copying callback, or... */
+    bsf_retrieve_ref_callback_f ref_callback; /* ...shared reference callback */
+    void *user_data;
+} bsf_client_sess_retrieve_callback_t;
+
 typedef struct bsf_client_sess_s {
+    ogs_lnode_t node;          /* bsf_client_context_t.active_sessions_list membership */
+    ogs_pool_id_t id;          /* session registry id, carried in events and as the xact sbi_object_id */
+
     ogs_sbi_object_t sbi;
 
-    ogs_sockaddr_t *ue_address; /* used as the key to store results in the cache */
+    ogs_sockaddr_t *ue_address;
+    bsf_ue_address_key_t lookup_key; /* normalised requested address, used as the key for the cache and pending lookups */
+    bool is_pending_lookup;    /* registered in the context pending lookups table */
 
     char *ipv4addr;
     char *ipv6prefix;
 
-    struct {
-        bsf_retrieve_callback_f callback;
-        void *user_data;
-    } retrieve;
+    char *identity_key;        /* UE identity key for a lookup by SUPI or GPSI, NULL for a lookup by UE address */
+    char *supi;
+    char *gpsi;
+    char *dnn;
+    OpenAPI_snssai_t *snssai;
+
+    ogs_list_t retrieve_callbacks; // Nodes of this list are bsf_client_sess_retrieve_callback_t
 } bsf_client_sess_t;
 
 bsf_client_sess_t *_bsf_client_sess_new(void);
@@ -42,9 +58,14 @@ void _bsf_client_sess_log_debug(bsf_client_sess_t *sess, int indent);
 bool _bsf_client_sess_ue_address_set(bsf_client_sess_t *sess, const ogs_sockaddr_t *ue_address);
 bool _bsf_client_sess_ipv4addr_set_from_sockaddr(bsf_client_sess_t *sess, const ogs_sockaddr_t *addr);
 bool _bsf_client_sess_ipv6prefix_set_from_sockaddr(bsf_client_sess_t *sess, const ogs_sockaddr_t *addr);
+bool _bsf_client_sess_ue_identity_set(bsf_client_sess_t *sess, const char *supi, const char *gpsi, const char *dnn, const OpenAPI_snssai_t *snssai);
+char *_bsf_client_sess_lookup_string(const bsf_client_sess_t *sess);
+
+bool _bsf_client_sess_retrieve_callback_add(bsf_client_sess_t *sess, bsf_retrieve_callback_f cb, bsf_retrieve_ref_callback_f ref_cb, void *user_data);
+bool _bsf_client_sess_retrieve_callback_call(bsf_client_sess_t *sess, bsf_pcf_binding_t *binding);
+bool _bsf_client_sess_retrieve_callback_call_on_error(bsf_client_sess_t *sess);
 
-bool _bsf_client_sess_retrieve_callback_set(bsf_client_sess_t *sess, bsf_retrieve_callback_f cb, void *user_data);
-bool _bsf_client_sess_retrieve_callback_call(bsf_client_sess_t *sess, const OpenAPI_pcf_binding_t *binding);
+bool _bsf_client_retrieve_callback_deliver(bsf_retrieve_callback_f cb, bsf_retrieve_ref_callback_f ref_cb, void *user_data, bsf_pcf_binding_t *binding);
 bool _bsf_client_sess_discover_and_send(bsf_client_sess_t *sess);
 
 #ifdef __cplusplus
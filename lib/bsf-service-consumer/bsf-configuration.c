@@ -21,6 +21,16 @@ extern "C" {
 
 static connection_addr_t *__connection_addr_new(const char *host, int port);
 static void __connection_addr_free(connection_addr_t *addr);
+static bool __connection_addr_resolve(connection_addr_t *addr);
+static bool __addrinfo_equal(const ogs_sockaddr_t *a, const ogs_sockaddr_t *b);
+static void __connection_addr_retire_client(connection_addr_t *addr);
+static void __connection_addr_reap_retired_clients(connection_addr_t *addr, bool force);
+static bool __client_is_idle(ogs_sbi_client_t *client);
+
+typedef struct retired_client_s {
+    ogs_lnode_t node;
+    ogs_sbi_client_t *client;
+} retired_client_t;
 
 /* Library Internals */
 void _bsf_configuration_init(bsf_configuration_t *config)
@@ -29,6 +39,16 @@ void _bsf_configuration_init(bsf_configuration_t *config)
     ogs_list_init(&config->bsf_servers_list);
     config->discover_flag = 0;
     config->discovered_bsf_nf_instance = NULL;
+    config->cache.max_entries = BSF_CLIENT_DEFAULT_CACHE_MAX_ENTRIES;
+    config->cache.stale_while_revalidate = 0;
+    config->cache.stale_if_error = 0;
+    config->cache.negative_ttl = BSF_CLIENT_DEFAULT_CACHE_NEGATIVE_TTL;
+    config->cache.negative_max_entries = BSF_CLIENT_DEFAULT_CACHE_NEGATIVE_MAX_ENTRIES;
+    config->cache.subscribe = 1;
+    config->cache.snapshot_file = NULL;
+    config->cache.snapshot_interval = BSF_CLIENT_DEFAULT_CACHE_SNAPSHOT_INTERVAL;
+    config->batch_max_in_flight = BSF_CLIENT_DEFAULT_BATCH_MAX_IN_FLIGHT;
+    config->resolve_interval = BSF_CLIENT_DEFAULT_RESOLVE_INTERVAL;
 }
 
 void _bsf_configuration_clear(bsf_configuration_t *config)
@@ -41,11 +61,16 @@ void _bsf_configuration_clear(bsf_configuration_t *config)
     }
 
     ogs_list_for_each_safe(&config->bsf_servers_list, next, node) {
-        ogs_list_remove(&config->bsf_client_notification_listener_list, node);
+        ogs_list_remove(&config->bsf_servers_list, node);
         __connection_addr_free(node);
     }
 
     config->discovered_bsf_nf_instance = NULL;
+
+    if (config->cache.snapshot_file) {
+        ogs_free(config->cache.snapshot_file);
+        config->cache.snapshot_file = NULL;
+    }
 }
 
 void _bsf_configuration_log_debug(bsf_configuration_t *config, int indent)
@@ -61,12 +86,31 @@ void _bsf_configuration_log_debug(bsf_configuration_t *config, int indent)
 
     ogs_debug("%*sBSF Service addresses:", indent, "");
     ogs_list_for_each(&config->bsf_servers_list, node) {
-        ogs_debug("%*s  %s:%i", indent, "", node->addr, node->port);
+        ogs_sockaddr_t *addr;
+
+        ogs_debug("%*s  %s:%i (client %p)", indent, "", node->addr, node->port, node->client);
+        for (addr = node->resolved; addr; addr = addr->next) {
+            char *ip = ogs_ipstrdup(addr);
+            ogs_debug("%*s    => %s", indent, "", ip);
+            ogs_free(ip);
+        }
     }
+    ogs_debug("%*sResolve interval = %is", indent, "", config->resolve_interval);
 
     ogs_debug("%*sDiscovery flag = %i", indent, "", config->discover_flag);
 
     ogs_debug("%*sDiscovered NF instance = %p", indent, "", config->discovered_bsf_nf_instance);
+
+    ogs_debug("%*sCache maximum entries = %i", indent, "", config->cache.max_entries);
+    ogs_debug("%*sCache default stale-while-revalidate = %is", indent, "", config->cache.stale_while_revalidate);
+    ogs_debug("%*sCache default stale-if-error = %is", indent, "", config->cache.stale_if_error);
+    ogs_debug("%*sCache negative TTL = %is", indent, "", config->cache.negative_ttl);
+    ogs_debug("%*sCache negative maximum entries = %i", indent, "", config->cache.negative_max_entries);
+    ogs_debug("%*sCache subscribes to binding changes = %s", indent, "", config->cache.subscribe ? "yes" : "no");
+    ogs_debug("%*sCache snapshot file = %s", indent, "", config->cache.snapshot_file ? config->cache.snapshot_file : "<none>");
+    ogs_debug("%*sCache snapshot interval = %is", indent, "", config->cache.snapshot_interval);
+
+    ogs_debug("%*sBatch maximum requests in flight = %i", indent, "", config->batch_max_in_flight);
 }
 
 void _bsf_configuration_set_discover_flag(bsf_configuration_t *config, int flag)
@@ -81,6 +125,135 @@ int _bsf_configuration_get_discover_flag(bsf_configuration_t *config)
     return config->discover_flag;
 }
 
+void _bsf_configuration_set_cache_max_entries(bsf_configuration_t *config, int max_entries)
+{
+    if (!config) return;
+    if (max_entries < 0) max_entries = 0;
+    config->cache.max_entries = max_entries;
+}
+
+int _bsf_configuration_get_cache_max_entries(bsf_configuration_t *config)
+{
+    if (!config) return 0;
+    return config->cache.max_entries;
+}
+
+void _bsf_configuration_set_cache_stale_while_revalidate(bsf_configuration_t *config, int seconds)
+{
+    if (!config) return;
+    if (seconds < 0) seconds = 0;
+    config->cache.stale_while_revalidate = seconds;
+}
+
+int _bsf_configuration_get_cache_stale_while_revalidate(bsf_configuration_t *config)
+{
+    if (!config) return 0;
+    return config->cache.stale_while_revalidate;
+}
+
+void _bsf_configuration_set_cache_stale_if_error(bsf_configuration_t *config, int seconds)
+{
+    if (!config) return;
+    if (seconds < 0) seconds = 0;
+    config->cache.stale_if_error = seconds;
+}
+
+int _bsf_configuration_get_cache_stale_if_error(bsf_configuration_t *config)
+{
+    if (!config) return 0;
+    return config->cache.stale_if_error;
+}
+
+void _bsf_configuration_set_cache_negative_ttl(bsf_configuration_t *config, int seconds)
+{
+    if (!config) return;
+    if (seconds < 0) seconds = 0;
+    config->cache.negative_ttl = seconds;
+}
+
+int _bsf_configuration_get_cache_negative_ttl(bsf_configuration_t *config)
+{
+    if (!config) return 0;
+    return config->cache.negative_ttl;
+}
+
+void _bsf_configuration_set_cache_negative_max_entries(bsf_configuration_t *config, int max_entries)
+{
+    if (!config) return;
+    if (max_entries < 0) max_entries = 0;
+    config->cache.negative_max_entries = max_entries;
+}
+
+int _bsf_configuration_get_cache_negative_max_entries(bsf_configuration_t *config)
+{
+    if (!config) return 0;
+    return config->cache.negative_max_entries;
+}
+
+void _bsf_configuration_set_cache_subscribe_flag(bsf_configuration_t *config, int flag)
+{
+    if (!config) return;
+    config->cache.subscribe = flag;
+}
+
+int _bsf_configuration_get_cache_subscribe_flag(bsf_configuration_t *config)
+{
+    if (!config) return 0;
+    return config->cache.subscribe;
+}
+
+void _bsf_configuration_set_cache_snapshot_file(bsf_configuration_t *config, const char *filename)
+{
+    if (!config) return;
+    if (config->cache.snapshot_file) ogs_free(config->cache.snapshot_file);
+    config->cache.snapshot_file = filename ? ogs_strdup(filename) : NULL;
+}
+
+const char *_bsf_configuration_get_cache_snapshot_file(bsf_configuration_t *config)
+{
+    if (!config) return NULL;
+    return config->cache.snapshot_file;
+}
+
+void _bsf_configuration_set_cache_snapshot_interval(bsf_configuration_t *config, int seconds)
+{
+    if (!config) return;
+    if (seconds < 0) seconds = 0;
+    config->cache.snapshot_interval = seconds;
+}
+
+int _bsf_configuration_get_cache_snapshot_interval(bsf_configuration_t *config)
+{
+    if (!config) return 0;
+    return config->cache.snapshot_interval;
+}
+
+void _bsf_configuration_set_batch_max_in_flight(bsf_configuration_t *config, int max_in_flight)
+{
+    if (!config) return;
+    if (max_in_flight < 1) max_in_flight = 1;
+    config->batch_max_in_flight = max_in_flight;
+}
+
+int _bsf_configuration_get_batch_max_in_flight(bsf_configuration_t *config)
+{
+    if (!config) return BSF_CLIENT_DEFAULT_BATCH_MAX_IN_FLIGHT;
+    return config->batch_max_in_flight;
+}
+
+void _bsf_configuration_set_resolve_interval(bsf_configuration_t *config, int seconds)
+{
+    if (!config) return;
+    if (seconds < 0) seconds = 0;
+    config->resolve_interval = seconds;
+}
+
+int _bsf_configuration_get_resolve_interval(bsf_configuration_t *config)
+{
+    if (!config) return 0;
+    return config->resolve_interval;
+}
+
 bool _bsf_configuration_notification_listeners_exist(bsf_configuration_t *config)
 {
     if (!config) return false;
@@ -118,26 +291,58 @@ bool _bsf_configuration_servers_exist(bsf_configuration_t *config)
     return ogs_list_first(&config->bsf_servers_list) != NULL;
 }
 
-ogs_sockaddr_t *_bsf_configuration_get_bsf_address(bsf_configuration_t *config)
+/* Resolve all configured BSF server names and (re)create their clients when the addresses change.
+ * Returns the number of servers that have usable addresses.
+ */
+int _bsf_configuration_servers_resolve(bsf_configuration_t *config)
+{
+    connection_addr_t *node;
+    int count = 0;
+
+    if (!config) return 0;
+
+    ogs_list_for_each(&config->bsf_servers_list, node) {
+        __connection_addr_reap_retired_clients(node, false);
+        if (__connection_addr_resolve(node)) count++;
+    }
+
+    return count;
+}
+
+/* Returned address belongs to the configuration, do not free */
+const ogs_sockaddr_t *_bsf_configuration_get_bsf_address(bsf_configuration_t *config)
 {
     connection_addr_t *node;
-    ogs_sockaddr_t *addr = NULL;
 
     if (!config) return NULL;
 
     node = ogs_list_first(&config->bsf_servers_list);
-    if (node) {
-        ogs_assert(ogs_addaddrinfo(&addr, AF_UNSPEC, node->addr, node->port, 0) == OGS_OK);
-    } else {
-        if (config->discovered_bsf_nf_instance) {
-            if (config->discovered_bsf_nf_instance->num_of_ipv6 > 0 /*&& ogs_app()->parameter.no_ipv6 == 0*/) {
-                ogs_copyaddrinfo(&addr, config->discovered_bsf_nf_instance->ipv6[0]);
-            } else if (config->discovered_bsf_nf_instance->num_of_ipv4 > 0 /*&& ogs_app()->parameter.no_ipv4 == 0*/) {
-                ogs_copyaddrinfo(&addr, config->discovered_bsf_nf_instance->ipv4[0]);
-            }
+    if (node) return node->resolved;
+
+    if (config->discovered_bsf_nf_instance) {
+        if (config->discovered_bsf_nf_instance->num_of_ipv6 > 0 /*&& ogs_app()->parameter.no_ipv6 == 0*/) {
+            return config->discovered_bsf_nf_instance->ipv6[0];
+        } else if (config->discovered_bsf_nf_instance->num_of_ipv4 > 0 /*&& ogs_app()->parameter.no_ipv4 == 0*/) {
+            return config->discovered_bsf_nf_instance->ipv4[0];
         }
     }
-    return addr;
+
+    return NULL;
+}
+
+/* First configured BSF server with a ready client, or NULL if none */
+ogs_sbi_client_t *_bsf_configuration_get_bsf_client(bsf_configuration_t *config)
+{
+    connection_addr_t *node;
+
+    if (!config) return NULL;
+
+    ogs_list_for_each(&config->bsf_servers_list, node) {
+        __connection_addr_reap_retired_clients(node, false);
+        if (node->client) return node->client;
+    }
+
+    return NULL;
 }
 
 /*** Private functions ***/
@@ -151,6 +356,7 @@ static connection_addr_t *__connection_addr_new(const char *host, int port)
 
     node->addr = ogs_strdup(host);
     node->port = port;
+    ogs_list_init(&node->retired_clients);
 
     return node;
 }
@@ -159,11 +365,95 @@ static void __connection_addr_free(connection_addr_t *addr)
 {
     if (!addr) return;
 
+    __connection_addr_reap_retired_clients(addr, true);
+    if (addr->client) ogs_sbi_client_remove(addr->client);
+    if (addr->resolved) ogs_freeaddrinfo(addr->resolved);
     if (addr->addr) ogs_free(addr->addr);
 
     ogs_free(addr);
 }
 
+static bool __connection_addr_resolve(connection_addr_t *addr)
+{
+    ogs_sockaddr_t *resolved = NULL;
+    ogs_sockaddr_t *ipv4 = NULL;
+    ogs_sockaddr_t *ipv6 = NULL;
+    ogs_sockaddr_t *it;
+
+    if (ogs_getaddrinfo(&resolved, AF_UNSPEC, addr->addr, addr->port, 0) != OGS_OK || !resolved) {
+        /* keep using the previous addresses, if any */
+        ogs_warn("Unable to resolve BSF server %s:%i", addr->addr, addr->port);
+        return addr->resolved != NULL;
+    }
+
+    if (addr->resolved && addr->client && __addrinfo_equal(addr->resolved, resolved)) {
+        ogs_freeaddrinfo(resolved);
+        return true;
+    }
+
+    /* requests already sent on the old client still need their responses */
+    __connection_addr_retire_client(addr);
+    if (addr->resolved) ogs_freeaddrinfo(addr->resolved);
+    addr->resolved = resolved;
+
+    for (it = resolved; it; it = it->next) {
+        if (!ipv4 && it->ogs_sa_family == AF_INET) ipv4 = it;
+        if (!ipv6 && it->ogs_sa_family == AF_INET6) ipv6 = it;
+    }
+
+    addr->client = ogs_sbi_client_add(OpenAPI_uri_scheme_http, NULL, 0, ipv4, ipv6);
+    if (!addr->client) ogs_error("Unable to create client for BSF server %s:%i", addr->addr, addr->port);
+
+    return true;
+}
+
+static bool __addrinfo_equal(const ogs_sockaddr_t *a, const ogs_sockaddr_t *b)
+{
+    while (a && b) {
+        if (!ogs_sockaddr_is_equal(a, b)) return false;
+        a = a->next;
+        b = b->next;
+    }
+    return a == NULL && b == NULL;
+}
+
+static void __connection_addr_retire_client(connection_addr_t *addr)
+{
+    retired_client_t *retired;
+
+    if (!addr->client) return;
+
+    if (__client_is_idle(addr->client)) {
+        ogs_sbi_client_remove(addr->client);
+        addr->client = NULL;
+        return;
+    }
+
+    retired = ogs_calloc(1, sizeof(*retired));
+    ogs_assert(retired);
+    retired->client = addr->client;
+    ogs_list_add(&addr->retired_clients, retired);
+    addr->client = NULL;
+}
+
+static void __connection_addr_reap_retired_clients(connection_addr_t *addr, bool force)
+{
+    retired_client_t *next, *retired;
+
+    ogs_list_for_each_safe(&addr->retired_clients, next, retired) {
+        if (!force && !__client_is_idle(retired->client)) continue;
+        ogs_list_remove(&addr->retired_clients, retired);
+        ogs_sbi_client_remove(retired->client);
+        ogs_free(retired);
+    }
+}
+
+static bool __client_is_idle(ogs_sbi_client_t *client)
+{
+    /* the client keeps one connection per request awaiting its response */
+    return ogs_list_first(&client->connection_list) == NULL;
+}
+
 #ifdef __cplusplus
 }
 #endif
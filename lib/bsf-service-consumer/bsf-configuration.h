@@ -22,8 +22,18 @@ typedef struct connection_addr_s {
     ogs_lnode_t node;	
     char *addr;
     int port;
+    ogs_sockaddr_t *resolved;   /* addresses for addr:port, NULL until resolved */
+    ogs_sbi_client_t *client;   /* persistent client for a BSF server, NULL for listeners */
+    ogs_list_t retired_clients; /* clients replaced after a re-resolve, kept until their requests finish */
 } connection_addr_t;
 
+#define BSF_CLIENT_DEFAULT_CACHE_MAX_ENTRIES 65536
+#define BSF_CLIENT_DEFAULT_CACHE_NEGATIVE_TTL 5 /* seconds */
+#define BSF_CLIENT_DEFAULT_CACHE_NEGATIVE_MAX_ENTRIES 4096
+#define BSF_CLIENT_DEFAULT_BATCH_MAX_IN_FLIGHT 64
+#define BSF_CLIENT_DEFAULT_RESOLVE_INTERVAL 0 /* seconds, 0 = only resolve at start up */
+#define BSF_CLIENT_DEFAULT_CACHE_SNAPSHOT_INTERVAL 60 /* seconds */
+
 typedef connection_addr_t bsf_server_t;
 typedef connection_addr_t bsf_client_notification_listener_t;
 
@@ -32,6 +42,18 @@ typedef struct bsf_configuration_s {
     ogs_list_t bsf_servers_list; // Nodes of this list are of type bsf_server_t*
     int discover_flag;
     ogs_sbi_nf_instance_t *discovered_bsf_nf_instance;
+    struct {
+        int max_entries; /* 0 = unbounded */
+        int stale_while_revalidate; /* seconds, used when the BSF response doesn't say */
+        int stale_if_error;         /* seconds, used when the BSF response doesn't say */
+        int negative_ttl;           /* seconds to remember "no binding" answers, 0 = don't */
+        int negative_max_entries;   /* 0 = unbounded */
+        int subscribe;              /* subscribe to binding changes for cached UEs */
+        char *snapshot_file;        /* where to keep the cache over restarts, NULL = don't */
+        int snapshot_interval;      /* seconds between snapshots, 0 = only on termination */
+    } cache;
+    int batch_max_in_flight; /* BSF requests a batch lookup may have outstanding at once */
+    int resolve_interval;    /* seconds between re-resolving the configured BSF server names, 0 = don't */
 } bsf_configuration_t;
 
 /* Library Internals */
@@ -43,6 +65,29 @@ void _bsf_configuration_log_debug(bsf_configuration_t *config, int indent);
 void _bsf_configuration_set_discover_flag(bsf_configuration_t *config, int flag);
 int _bsf_configuration_get_discover_flag(bsf_configuration_t *config);
 
+void _bsf_configuration_set_cache_max_entries(bsf_configuration_t *config, int max_entries);
+int _bsf_configuration_get_cache_max_entries(bsf_configuration_t *config);
+void _bsf_configuration_set_cache_stale_while_revalidate(bsf_configuration_t *config, int seconds);
+int _bsf_configuration_get_cache_stale_while_revalidate(bsf_configuration_t *config);
+void _bsf_configuration_set_cache_stale_if_error(bsf_configuration_t *config, int seconds);
+int _bsf_configuration_get_cache_stale_if_error(bsf_configuration_t *config);
+void _bsf_configuration_set_cache_negative_ttl(bsf_configuration_t *config, int seconds);
+int _bsf_configuration_get_cache_negative_ttl(bsf_configuration_t *config);
+void _bsf_configuration_set_cache_negative_max_entries(bsf_configuration_t *config, int max_entries);
+int _bsf_configuration_get_cache_negative_max_entries(bsf_configuration_t *config);
+void _bsf_configuration_set_cache_subscribe_flag(bsf_configuration_t *config, int flag);
+int _bsf_configuration_get_cache_subscribe_flag(bsf_configuration_t *config);
+void _bsf_configuration_set_cache_snapshot_file(bsf_configuration_t *config, const char *filename);
+const char *_bsf_configuration_get_cache_snapshot_file(bsf_configuration_t *config);
+void _bsf_configuration_set_cache_snapshot_interval(bsf_configuration_t *config, int seconds);
+int _bsf_configuration_get_cache_snapshot_interval(bsf_configuration_t *config);
+
+void _bsf_configuration_set_batch_max_in_flight(bsf_configuration_t *config, int max_in_flight);
+int _bsf_configuration_get_batch_max_in_flight(bsf_configuration_t *config);
+
+void _bsf_configuration_set_resolve_interval(bsf_configuration_t *config, int seconds);
+int _bsf_configuration_get_resolve_interval(bsf_configuration_t *config);
+
 bool _bsf_configuration_notification_listeners_exist(bsf_configuration_t *config);
 int _bsf_configuration_notification_listeners_add(bsf_configuration_t *config, const char *hostname,
                                                   int port);
@@ -50,7 +95,9 @@ int _bsf_configuration_notification_listeners_add(bsf_configuration_t *config, c
 int _bsf_configuration_server_add(bsf_configuration_t *config, const char *hostname, int port);
 bool _bsf_configuration_servers_exist(bsf_configuration_t *config);
 
-ogs_sockaddr_t *_bsf_configuration_get_bsf_address(bsf_configuration_t *config);
+int _bsf_configuration_servers_resolve(bsf_configuration_t *config);
+const ogs_sockaddr_t *_bsf_configuration_get_bsf_address(bsf_configuration_t *config);
+ogs_sbi_client_t *_bsf_configuration_get_bsf_client(bsf_configuration_t *config);
 
 #ifdef __cplusplus
 }
@@ -16,6 +16,7 @@ https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
 #include "nbsf-process.h"
 #include "context.h"
 #include "pcf-bind.h"
+#include "pcf-binding-ref.h"
 
 #include "bsf-service-consumer.h"
 
@@ -34,6 +35,45 @@ BSF_CLIENT_API bool bsf_retrieve_pcf_binding_for_pdu_session(ogs_sockaddr_t *ue_
     return _bsf_retrieve_pcf_binding_for_pdu_session(ue_address, callback, user_data);
 }
 
+BSF_CLIENT_API bool bsf_retrieve_pcf_binding_ref_for_pdu_session(ogs_sockaddr_t *ue_address, bsf_retrieve_ref_callback_f callback, void *user_data)
+{
+    return _bsf_retrieve_pcf_binding_ref_for_pdu_session(ue_address, callback, user_data);
+}
+
+BSF_CLIENT_API bool bsf_retrieve_pcf_binding_ref_for_supi(const char *supi, const char *dnn, const OpenAPI_snssai_t *snssai,
+                                                          bsf_retrieve_ref_callback_f callback, void *user_data)
+{
+    if (!supi) return false;
+    return _bsf_retrieve_pcf_binding_ref_for_ue_identity(supi, NULL, dnn, snssai, callback, user_data);
+}
+
+BSF_CLIENT_API bool bsf_retrieve_pcf_binding_ref_for_gpsi(const char *gpsi, const char *dnn, const OpenAPI_snssai_t *snssai,
+                                                          bsf_retrieve_ref_callback_f callback, void *user_data)
+{
+    if (!gpsi) return false;
+    return _bsf_retrieve_pcf_binding_ref_for_ue_identity(NULL, gpsi, dnn, snssai, callback, user_data);
+}
+
+BSF_CLIENT_API bool bsf_retrieve_pcf_bindings(ogs_sockaddr_t * const *ue_addresses, size_t count, bsf_retrieve_batch_callback_f callback, void *user_data)
+{
+    return _bsf_retrieve_pcf_bindings(ue_addresses, count, callback, user_data);
+}
+
+BSF_CLIENT_API const OpenAPI_pcf_binding_t *bsf_pcf_binding_get(const bsf_pcf_binding_t *pcf_binding)
+{
+    return _bsf_pcf_binding_get(pcf_binding);
+}
+
+BSF_CLIENT_API bsf_pcf_binding_t *bsf_pcf_binding_ref(bsf_pcf_binding_t *pcf_binding)
+{
+    return _bsf_pcf_binding_ref(pcf_binding);
+}
+
+BSF_CLIENT_API void bsf_pcf_binding_unref(bsf_pcf_binding_t *pcf_binding)
+{
+    _bsf_pcf_binding_unref(pcf_binding);
+}
+
 BSF_CLIENT_API bool bsf_process_event(ogs_event_t *e)
 {
     return _bsf_process_event(e);
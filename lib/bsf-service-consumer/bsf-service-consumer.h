@@ -45,10 +45,39 @@ extern "C" {
     #endif
 #endif
 
+/* Shared, immutable, reference counted PCF binding */
+typedef struct bsf_pcf_binding_s bsf_pcf_binding_t;
+
+/* Callback receives its own copy of the binding (NULL on failure) and frees it if it returns true */
 typedef bool (*bsf_retrieve_callback_f)(OpenAPI_pcf_binding_t *pcf_binding, void *user_data);
+/* Callback receives one reference to the shared binding (NULL on failure) and unrefs it if it returns true */
+typedef bool (*bsf_retrieve_ref_callback_f)(bsf_pcf_binding_t *pcf_binding, void *user_data);
+
+/* One result of a batch lookup, pcf_binding is NULL if there is no binding for ue_address. ue_address
+ * is a copy of the address given, without its hostname and next pointers.
+ */
+typedef struct bsf_pcf_binding_result_s {
+    ogs_sockaddr_t ue_address;
+    bsf_pcf_binding_t *pcf_binding;
+} bsf_pcf_binding_result_t;
+
+/* Receives results in the order the addresses were given, the bindings are only borrowed for the
+ * duration of the call so use bsf_pcf_binding_ref() to keep one. If the library terminates first, the
+ * callback is called from bsf_terminate() with no binding for the addresses not yet answered.
+ */
+typedef void (*bsf_retrieve_batch_callback_f)(const bsf_pcf_binding_result_t *results, size_t count, void *user_data);
 
 BSF_CLIENT_API bool bsf_parse_config(const char *bsf_sect, const char *bsf_client_sect);
 BSF_CLIENT_API bool bsf_retrieve_pcf_binding_for_pdu_session(ogs_sockaddr_t *ue_address, bsf_retrieve_callback_f callback, void *user_data);
+BSF_CLIENT_API bool bsf_retrieve_pcf_binding_ref_for_pdu_session(ogs_sockaddr_t *ue_address, bsf_retrieve_ref_callback_f callback, void *user_data);
+BSF_CLIENT_API bool bsf_retrieve_pcf_binding_ref_for_supi(const char *supi, const char *dnn, const OpenAPI_snssai_t *snssai,
+                                                          bsf_retrieve_ref_callback_f callback, void *user_data);
+BSF_CLIENT_API bool bsf_retrieve_pcf_binding_ref_for_gpsi(const char *gpsi, const char *dnn, const OpenAPI_snssai_t *snssai,
+                                                          bsf_retrieve_ref_callback_f callback, void *user_data);
+BSF_CLIENT_API bool bsf_retrieve_pcf_bindings(ogs_sockaddr_t * const *ue_addresses, size_t count, bsf_retrieve_batch_callback_f callback, void *user_data);
+BSF_CLIENT_API const OpenAPI_pcf_binding_t *bsf_pcf_binding_get(const bsf_pcf_binding_t *pcf_binding);
+BSF_CLIENT_API bsf_pcf_binding_t *bsf_pcf_binding_ref(bsf_pcf_binding_t *pcf_binding);
+BSF_CLIENT_API void bsf_pcf_binding_unref(bsf_pcf_binding_t *pcf_binding);
 BSF_CLIENT_API bool bsf_process_event(ogs_event_t *e);
 BSF_CLIENT_API void bsf_terminate(void);
 
@@ -0,0 +1,340 @@
+/*
+License: 5G-MAG Public License (v1.0)
+Copyright: (C) 2023 British Broadcasting Corporation
+
+For full license terms please see the LICENSE file distributed with this
+program. If this file is missing then the license can be retrieved from
+https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
+*/
+
+#include "ogs-core.h"
+#include "ogs-sbi.h"
+
+#include "context.h"
+#include "log.h"
+#include "nbsf-management-build.h"
+#include "pcf-binding-ref.h"
+#include "ue-address-key.h"
+
+#include "bsf-subscription.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+static bsf_client_subscription_t *__subscription_new(const char *supi);
+static bool __subscription_send(bsf_client_subscription_t *subsc, ogs_sbi_build_f build);
+static void __unsubscribe(bsf_client_subscription_t *subsc);
+static bool __xact_is_delete(ogs_sbi_xact_t *xact);
+static const char *__response_location(ogs_sbi_response_t *response);
+static int __invalidate_pdu_session_info(const cJSON *info);
+
+/* Library Internals */
+
+/* A cache entry now holds binding, subscribe to binding events for its SUPI if not already subscribed */
+void _bsf_client_subscription_binding_cached(const bsf_pcf_binding_t *binding)
+{
+    const OpenAPI_pcf_binding_t *pcf_binding = _bsf_pcf_binding_get(binding);
+    bsf_client_subscription_t *subsc;
+
+    if (!pcf_binding || !pcf_binding->supi) return;
+
+    subsc = _bsf_client_context_subscriptions_find_by_supi(pcf_binding->supi);
+    if (!subsc) {
+        if (!_bsf_client_context_get_subscribe_flag()) return;
+
+        /* needs somewhere for the notifications to go and a known BSF to subscribe with */
+        if (!_bsf_client_context_get_notification_server() || !_bsf_client_context_get_bsf_client()) return;
+
+        subsc = __subscription_new(pcf_binding->supi);
+        if (!subsc) return;
+
+        /* on failure keep the record so we don't retry for every cached binding, TTLs still apply */
+        subsc->creating = __subscription_send(subsc, (ogs_sbi_build_f)_nbsf_management_subscription_build_create);
+        if (!subsc->creating) ogs_warn("Unable to subscribe to PCF binding events for %s", subsc->supi);
+    }
+
+    subsc->cached_bindings++;
+}
+
+/* A cache entry no longer holds binding, unsubscribe once nothing is cached for the SUPI */
+void _bsf_client_subscription_binding_uncached(const bsf_pcf_binding_t *binding)
+{
+    const OpenAPI_pcf_binding_t *pcf_binding = _bsf_pcf_binding_get(binding);
+    bsf_client_subscription_t *subsc;
+
+    if (!pcf_binding || !pcf_binding->supi) return;
+
+    subsc = _bsf_client_context_subscriptions_find_by_supi(pcf_binding->supi);
+    if (!subsc) return;
+
+    if (--subsc->cached_bindings > 0) return;
+
+    _bsf_client_context_subscriptions_supi_index_remove(subsc);
+    __unsubscribe(subsc);
+}
+
+void _bsf_client_subscription_free(bsf_client_subscription_t *subsc)
+{
+    if (!subsc) return;
+
+    if (subsc->in_supi_index) _bsf_client_context_subscriptions_supi_index_remove(subsc);
+    ogs_sbi_xact_remove_all(&subsc->sbi);
+    ogs_sbi_object_free(&subsc->sbi);
+    if (subsc->supi) {
+        ogs_free(subsc->supi);
+        subsc->supi = NULL;
+    }
+    if (subsc->subscription_id) {
+        ogs_free(subsc->subscription_id);
+        subsc->subscription_id = NULL;
+    }
+    _bsf_client_context_subscriptions_free(subsc);
+}
+
+/* Takes ownership of xact and response */
+bool _bsf_client_subscription_process_response(bsf_client_subscription_t *subsc, ogs_sbi_xact_t *xact, ogs_sbi_response_t *response)
+{
+    bool is_delete;
+
+    ogs_assert(subsc);
+    ogs_assert(xact);
+    ogs_assert(response);
+
+    is_delete = __xact_is_delete(xact);
+    ogs_sbi_xact_remove(xact);
+
+    if (is_delete) {
+        if (response->status != OGS_SBI_HTTP_STATUS_NO_CONTENT && response->status != OGS_SBI_HTTP_STATUS_NOT_FOUND)
+            ogs_warn("BSF subscription removal for %s failed with status %i", subsc->supi, response->status);
+        ogs_sbi_response_free(response);
+        _bsf_client_subscription_free(subsc);
+        return true;
+    }
+
+    subsc->creating = false;
+    if (response->status == OGS_SBI_HTTP_STATUS_CREATED) {
+        const char *location = __response_location(response);
+
+        if (location) {
+            const char *id = strrchr(location, '/');
+            subsc->subscription_id = ogs_sbi_url_decode(id ? id + 1 : location);
+            ogs_debug("Subscribed to PCF binding events for %s as %s", subsc->supi, subsc->subscription_id);
+        } else {
+            ogs_error("BSF subscription for %s created without a Location", subsc->supi);
+        }
+    } else {
+        ogs_warn("BSF refused subscription to PCF binding events for %s with status %i", subsc->supi, response->status);
+    }
+    ogs_sbi_response_free(response);
+
+    if (subsc->unsubscribe_on_create) __unsubscribe(subsc);
+
+    return true;
+}
+
+/* Takes ownership of xact */
+bool _bsf_client_subscription_process_timeout(bsf_client_subscription_t *subsc, ogs_sbi_xact_t *xact)
+{
+    bool is_delete;
+
+    ogs_assert(subsc);
+    ogs_assert(xact);
+
+    is_delete = __xact_is_delete(xact);
+    ogs_sbi_xact_remove(xact);
+
+    if (is_delete) {
+        ogs_warn("Timed out removing BSF subscription for %s", subsc->supi);
+        _bsf_client_subscription_free(subsc);
+        return true;
+    }
+
+    ogs_warn("Timed out subscribing to PCF binding events for %s", subsc->supi);
+    subsc->creating = false;
+    if (subsc->unsubscribe_on_create) __unsubscribe(subsc);
+
+    return true;
+}
+
+/* Handle a BsfNotification sent to one of our notification listeners, returns false if the request isn't ours */
+bool _bsf_client_subscription_process_notification(ogs_event_t *e)
+{
+    ogs_sbi_request_t *request = e->sbi.request;
+    ogs_sbi_stream_t *stream;
+    ogs_sbi_server_t *server;
+    ogs_sbi_message_t message;
+    ogs_sbi_response_t *response;
+    bsf_client_subscription_t *subsc = NULL;
+    cJSON *json, *event_notifs, *event_notif;
+    int invalidated = 0;
+
+    if (!request) return false;
+
+    stream = ogs_sbi_stream_find_by_id(OGS_POINTER_TO_UINT(e->sbi.data));
+    if (!stream) return false;
+
+    server = ogs_sbi_server_from_stream(stream);
+    if (!server || !_bsf_client_context_is_notification_server(server)) return false;
+
+    if (ogs_sbi_parse_header(&message, &request->h) != OGS_OK) return false;
+
+    if (!message.h.service.name || strcmp(message.h.service.name, BSF_CLIENT_NOTIFICATION_SERVICE_NAME)) {
+        ogs_sbi_message_free(&message);
+        return false;
+    }
+
+    if (!message.h.method || strcmp(message.h.method, OGS_SBI_HTTP_METHOD_POST)) {
+        ogs_warn("Received BSF notification with wrong HTTP method: %s", message.h.method);
+        ogs_sbi_server_send_error(stream, OGS_SBI_HTTP_STATUS_METHOD_NOT_ALLOWED, &message, "Method Not Allowed", "Unsupported HTTP method", NULL);
+        ogs_sbi_message_free(&message);
+        return true;
+    }
+
+    if (message.h.resource.component[0] && !strcmp(message.h.resource.component[0], OGS_SBI_RESOURCE_NAME_SUBSCRIPTIONS) &&
+            message.h.resource.component[1])
+        subsc = _bsf_client_context_subscriptions_find_by_id((ogs_pool_id_t)atoll(message.h.resource.component[1]));
+    if (!subsc) {
+        ogs_warn("Received BSF notification for an unknown subscription");
+        ogs_sbi_server_send_error(stream, OGS_SBI_HTTP_STATUS_NOT_FOUND, &message, "Not Found", "Unknown subscription", NULL);
+        ogs_sbi_message_free(&message);
+        return true;
+    }
+
+    json = request->http.content ? cJSON_Parse(request->http.content) : NULL;
+    event_notifs = json ? cJSON_GetObjectItemCaseSensitive(json, "eventNotifs") : NULL;
+    if (!cJSON_IsArray(event_notifs)) {
+        ogs_warn("Received BSF notification with malformed body");
+        ogs_debug("malformed body:\n%s", request->http.content);
+        ogs_sbi_server_send_error(stream, OGS_SBI_HTTP_STATUS_BAD_REQUEST, &message, "Bad Request", "Not a BsfNotification", "INVALID_MSG_FORMAT");
+        if (json) cJSON_Delete(json);
+        ogs_sbi_message_free(&message);
+        return true;
+    }
+
+    ogs_debug("BSF notification for %s", subsc->supi);
+
+    /* Registrations and deregistrations both mean the cached answers for these UE addresses may be
+     * wrong, drop them and let the next lookup ask the BSF. This may also end, and free, subsc.
+     */
+    cJSON_ArrayForEach(event_notif, event_notifs) {
+        const cJSON *event = cJSON_GetObjectItemCaseSensitive(event_notif, "event");
+
+        ogs_debug("PCF binding event %s", cJSON_IsString(event) ? event->valuestring : "<unknown>");
+        invalidated += __invalidate_pdu_session_info(cJSON_GetObjectItemCaseSensitive(event_notif, "pcfForPduSessInfo"));
+    }
+    cJSON_Delete(json);
+
+    ogs_debug("BSF notification invalidated %i cache entries", invalidated);
+
+    response = ogs_sbi_build_response(&message, OGS_SBI_HTTP_STATUS_NO_CONTENT);
+    ogs_assert(response);
+    ogs_sbi_server_send_response(stream, response);
+
+    ogs_sbi_message_free(&message);
+
+    return true;
+}
+
+/*** Private functions ***/
+
+static bsf_client_subscription_t *__subscription_new(const char *supi)
+{
+    bsf_client_subscription_t *subsc;
+
+    subsc = _bsf_client_context_subscriptions_new();
+    if (!subsc) {
+        ogs_error("No more BSF client subscriptions available");
+        return NULL;
+    }
+
+    subsc->supi = ogs_strdup(supi);
+    ogs_assert(subsc->supi);
+    _bsf_client_context_subscriptions_supi_index_add(subsc);
+
+    return subsc;
+}
+
+static bool __subscription_send(bsf_client_subscription_t *subsc, ogs_sbi_build_f build)
+{
+    ogs_sbi_xact_t *xact;
+    ogs_sbi_client_t *client;
+
+    client = _bsf_client_context_get_bsf_client();
+    if (!client) return false;
+
+    xact = ogs_sbi_xact_add(subsc->id, &subsc->sbi, OGS_SBI_SERVICE_TYPE_NBSF_MANAGEMENT, NULL, build, subsc, NULL);
+    if (!xact) {
+        ogs_error("ogs_sbi_xact_add() failed");
+        return false;
+    }
+
+    if (!ogs_sbi_send_request_to_client(client, ogs_sbi_client_handler, xact->request, OGS_UINT_TO_POINTER(xact->id))) {
+        ogs_error("ogs_sbi_send_request_to_client() failed");
+        ogs_sbi_xact_remove(xact);
+        return false;
+    }
+
+    return true;
+}
+
+/* The subscription is no longer in the SUPI index, remove it from the BSF and then free it */
+static void __unsubscribe(bsf_client_subscription_t *subsc)
+{
+    if (subsc->creating) {
+        subsc->unsubscribe_on_create = true;
+        return;
+    }
+
+    /* freed when the BSF answers */
+    if (subsc->subscription_id &&
+            __subscription_send(subsc, (ogs_sbi_build_f)_nbsf_management_subscription_build_delete))
+        return;
+
+    _bsf_client_subscription_free(subsc);
+}
+
+static bool __xact_is_delete(ogs_sbi_xact_t *xact)
+{
+    return xact->request && xact->request->h.method && !strcmp(xact->request->h.method, OGS_SBI_HTTP_METHOD_DELETE);
+}
+
+static const char *__response_location(ogs_sbi_response_t *response)
+{
+    ogs_hash_index_t *hi;
+
+    for (hi = ogs_hash_first(response->http.headers); hi; hi = ogs_hash_next(hi)) {
+        if (!ogs_strcasecmp(ogs_hash_this_key(hi), OGS_SBI_LOCATION)) return ogs_hash_this_val(hi);
+    }
+
+    return NULL;
+}
+
+/* Invalidate the cache entries for the UE addresses in a PcfForPduSessionInfo */
+static int __invalidate_pdu_session_info(const cJSON *info)
+{
+    const cJSON *ipv4_addr, *ipv6_prefixes, *ipv6_prefix;
+    bsf_ue_address_key_t key;
+    int count = 0;
+
+    if (!cJSON_IsObject(info)) return 0;
+
+    ipv4_addr = cJSON_GetObjectItemCaseSensitive(info, "ipv4Addr");
+    if (cJSON_IsString(ipv4_addr) && _ue_address_key_from_ipv4_string(&key, ipv4_addr->valuestring))
+        count += _bsf_client_context_invalidate_pcf_bindings(&key);
+
+    ipv6_prefixes = cJSON_GetObjectItemCaseSensitive(info, "ipv6Prefixes");
+    cJSON_ArrayForEach(ipv6_prefix, ipv6_prefixes) {
+        if (cJSON_IsString(ipv6_prefix) && _ue_address_key_from_ipv6_prefix_string(&key, ipv6_prefix->valuestring))
+            count += _bsf_client_context_invalidate_pcf_bindings(&key);
+    }
+
+    return count;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+/* vim:ts=8:sts=4:sw=4:expandtab:
+ */
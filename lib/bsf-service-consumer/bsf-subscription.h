@@ -0,0 +1,55 @@
+/*
+License: 5G-MAG Public License (v1.0)
+Copyright: (C) 2023 British Broadcasting Corporation
+
+For full license terms please see the LICENSE file distributed with this
+program. If this file is missing then the license can be retrieved from
+https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
+*/
+
+#ifndef BSF_CLIENT_SUBSCRIPTION_H
+#define BSF_CLIENT_SUBSCRIPTION_H
+
+#include "ogs-proto.h"
+#include "ogs-sbi.h"
+
+#include "bsf-service-consumer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BSF_CLIENT_NOTIFICATION_SERVICE_NAME "nbsf-management-notify"
+
+typedef struct bsf_client_subscription_s {
+    ogs_lnode_t node;          /* bsf_client_context_t.subscriptions_list membership */
+    ogs_pool_id_t id;          /* subscription registry id, the xact sbi_object_id and the notification URI id */
+
+    ogs_sbi_object_t sbi;
+
+    char *supi;                /* UE these binding events are for */
+    char *subscription_id;     /* BSF subscription id from the Location header, NULL until created */
+    int cached_bindings;       /* number of cache entries holding a binding for this SUPI */
+    bool in_supi_index;        /* registered in the context subscriptions by SUPI table */
+    bool creating;             /* subscription create request in flight */
+    bool unsubscribe_on_create;/* no longer needed, remove as soon as the BSF has created it */
+} bsf_client_subscription_t;
+
+/* Library Internals */
+void _bsf_client_subscription_binding_cached(const bsf_pcf_binding_t *binding);
+void _bsf_client_subscription_binding_uncached(const bsf_pcf_binding_t *binding);
+
+void _bsf_client_subscription_free(bsf_client_subscription_t *subsc);
+
+bool _bsf_client_subscription_process_response(bsf_client_subscription_t *subsc, ogs_sbi_xact_t *xact, ogs_sbi_response_t *response);
+bool _bsf_client_subscription_process_timeout(bsf_client_subscription_t *subsc, ogs_sbi_xact_t *xact);
+bool _bsf_client_subscription_process_notification(ogs_event_t *e);
+
+#ifdef __cplusplus
+}
+#endif
+
+/* vim:ts=8:sts=4:sw=4:expandtab:
+ */
+
+#endif /* BSF_CLIENT_SUBSCRIPTION_H */
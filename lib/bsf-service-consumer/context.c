@@ -13,7 +13,10 @@
 
 #include "bsf-configuration.h"
 #include "bsf-client-sess.h"
+#include "bsf-subscription.h"
 #include "log.h"
+#include "pcf-bind.h"
+#include "pcf-binding-ref.h"
 #include "pcf-bindings-cache.h"
 
 #include "context.h"
@@ -24,10 +27,8 @@ extern "C" {
 
 static bsf_client_context_t *__self = NULL;
 
-typedef struct bsf_client_sess_node_s {
-    ogs_lnode_t node;
-    bsf_client_sess_t *sess;
-} bsf_client_sess_node_t;
+static OGS_POOL(__sess_pool, bsf_client_sess_t);
+static OGS_POOL(__subscription_pool, bsf_client_subscription_t);
 
 typedef int (*parse_server_add_f)(const char *hostname, int port);
 typedef int (*parse_server_start_f)(ogs_list_t *ipv4_listen, ogs_list_t *ipv6_listen, ogs_sockaddr_t *addr, ogs_sockopt_t *option);
@@ -37,15 +38,23 @@ static void __parse_server_config(ogs_yaml_iter_t *iter, parse_server_add_f adde
 static int  __server_add(const char *hostname, int port);
 static int  __notification_listener_add(const char *hostname, int port);
 static int  __notification_listener_start(ogs_list_t *ipv4_listen, ogs_list_t *ipv6_listen, ogs_sockaddr_t *addr, ogs_sockopt_t *option);
+static void __parse_cache_config(ogs_yaml_iter_t *iter);
 static int  __bsf_client_context_validation(void);
-static bsf_client_sess_node_t *__bsf_client_context_active_sessions_find(bsf_client_sess_t *sess);
 static void __active_sessions_log_debug(int indent);
+static void __servers_resolve(void);
+static void __resolve_timer_expired(void *data);
+static void __snapshot_load(void);
+static void __snapshot_save(void);
+static void __snapshot_timer_expired(void *data);
+static void __cache_binding_added(const bsf_pcf_binding_t *binding, void *data);
+static void __cache_binding_removed(const bsf_pcf_binding_t *binding, void *data);
 
 /* Library Internal Public */
 bool _bsf_parse_config(const char *local)
 {
     yaml_document_t *document = NULL;
     ogs_yaml_iter_t root_iter;
+    int rv;
 
     if (!__self) __bsf_client_context_init();
     ogs_assert(__self);
@@ -73,6 +82,14 @@ bool _bsf_parse_config(const char *local)
                     /* ignore */
                 } else if (!strcmp(bsf_key, "discovery")) {
                     _bsf_configuration_set_discover_flag(&__self->config, 1);
+                } else if (!strcmp(bsf_key, "cache")) {
+                    __parse_cache_config(&bsf_iter);
+                } else if (!strcmp(bsf_key, "resolveInterval")) {
+                    const char *v = ogs_yaml_iter_value(&bsf_iter);
+                    if (v) _bsf_configuration_set_resolve_interval(&__self->config, atoi(v));
+                } else if (!strcmp(bsf_key, "batchMaxInFlight")) {
+                    const char *v = ogs_yaml_iter_value(&bsf_iter);
+                    if (v) _bsf_configuration_set_batch_max_in_flight(&__self->config, atoi(v));
                 } else {
                     ogs_warn("unknown key `%s`", bsf_key);
                 }
@@ -80,24 +97,61 @@ bool _bsf_parse_config(const char *local)
         }
     }
 
-    return __bsf_client_context_validation();
+    _pcf_bindings_cache_set_max_entries(__self->pcf_bindings_cache, _bsf_configuration_get_cache_max_entries(&__self->config));
+    _pcf_bindings_cache_set_max_negative_entries(__self->pcf_bindings_cache, _bsf_configuration_get_cache_negative_max_entries(&__self->config));
+
+    rv = __bsf_client_context_validation();
+
+    /* come back with a hot cache, after validation so reloaded bindings can be subscribed to */
+    if (rv == OGS_OK) __snapshot_load();
+
+    return rv;
 }
 
 void _bsf_client_context_final(void)
 {
-    bsf_client_sess_node_t *node, *next;
+    bsf_client_sess_t *sess, *next;
+    bsf_client_subscription_t *subsc, *next_subsc;
+    bsf_client_notification_server_t *notif_server, *next_notif_server;
 
     if (!__self) return;
 
     ogs_debug("Finalising BSF client context");
 
+    /* give batch callers what they have so far, nothing else will answer them now */
+    _bsf_retrieve_pcf_bindings_abort_all();
+
+    if (__self->resolve_timer) ogs_timer_delete(__self->resolve_timer);
+
+    __snapshot_save();
+    if (__self->snapshot_timer) ogs_timer_delete(__self->snapshot_timer);
+
     _bsf_configuration_clear(&__self->config);
 
+    /* shutting down, don't unsubscribe as the cache empties */
+    _pcf_bindings_cache_set_binding_listener(__self->pcf_bindings_cache, NULL, NULL, NULL);
     _pcf_bindings_cache_clear(&__self->pcf_bindings_cache);
 
-    ogs_list_for_each_safe(&__self->active_sessions_list, next, node) {
-        _bsf_client_sess_free(node->sess); /* calls _bsf_client_context_active_sessions_remove() to remove list entry */
+    ogs_list_for_each_safe(&__self->subscriptions_list, next_subsc, subsc) {
+        _bsf_client_subscription_free(subsc); /* calls _bsf_client_context_subscriptions_free() to remove list entry */
     }
+    ogs_pool_final(&__subscription_pool);
+    ogs_hash_destroy(__self->subscriptions_by_supi);
+
+    ogs_list_for_each_safe(&__self->notification_servers, next_notif_server, notif_server) {
+        ogs_list_remove(&__self->notification_servers, notif_server);
+        ogs_free(notif_server);
+    }
+
+    ogs_list_for_each_safe(&__self->active_sessions_list, next, sess) {
+        _bsf_client_sess_free(sess); /* calls _bsf_client_context_active_sessions_free() to remove list entry */
+    }
+    ogs_pool_final(&__sess_pool);
+
+    ogs_hash_destroy(__self->pending_lookups);
+    ogs_hash_destroy(__self->pending_identity_lookups);
+
+    if (__self->queued_sends.sess_ids) ogs_free(__self->queued_sends.sess_ids);
 
     ogs_free(__self);
 
@@ -126,51 +180,296 @@ void _bsf_client_context_log_debug(void)
     __active_sessions_log_debug(4);
 }
 
-ogs_sockaddr_t *_bsf_client_context_get_bsf_address(void)
+const ogs_sockaddr_t *_bsf_client_context_get_bsf_address(void)
 {
     if (!__self) return NULL;
     return _bsf_configuration_get_bsf_address(&__self->config);
 }
 
-OpenAPI_pcf_binding_t *_bsf_client_pcf_bindings_from_cache(ogs_sockaddr_t *ue_address)
+ogs_sbi_client_t *_bsf_client_context_get_bsf_client(void)
+{
+    if (!__self) return NULL;
+    return _bsf_configuration_get_bsf_client(&__self->config);
+}
+
+int _bsf_client_context_get_batch_max_in_flight(void)
+{
+    if (!__self) return BSF_CLIENT_DEFAULT_BATCH_MAX_IN_FLIGHT;
+    return _bsf_configuration_get_batch_max_in_flight(&__self->config);
+}
+
+bool _bsf_client_context_get_subscribe_flag(void)
+{
+    if (!__self) return false;
+    return _bsf_configuration_get_cache_subscribe_flag(&__self->config) != 0;
+}
+
+ogs_sbi_server_t *_bsf_client_context_get_notification_server(void)
+{
+    bsf_client_notification_server_t *notif_server;
+
+    if (!__self) return NULL;
+    notif_server = ogs_list_first(&__self->notification_servers);
+    if (!notif_server) return NULL;
+    return notif_server->server;
+}
+
+bool _bsf_client_context_is_notification_server(ogs_sbi_server_t *server)
+{
+    bsf_client_notification_server_t *notif_server;
+
+    if (!__self) return false;
+    ogs_list_for_each(&__self->notification_servers, notif_server) {
+        if (notif_server->server == server) return true;
+    }
+    return false;
+}
+
+bsf_pcf_binding_t *_bsf_client_pcf_bindings_from_cache(const bsf_ue_address_key_t *ue_address, bool *stale, bool *negative)
+{
+    if (stale) *stale = false;
+    if (negative) *negative = false;
+    if (!__self) return NULL;
+
+    return _pcf_bindings_cache_find(__self->pcf_bindings_cache, ue_address, stale, negative);
+}
+
+bsf_pcf_binding_t *_bsf_client_pcf_bindings_stale_if_error_from_cache(const bsf_ue_address_key_t *ue_address)
+{
+    if (!__self) return NULL;
+
+    return _pcf_bindings_cache_find_stale_if_error(__self->pcf_bindings_cache, ue_address);
+}
+
+int _bsf_client_context_invalidate_pcf_bindings(const bsf_ue_address_key_t *key)
+{
+    if (!__self) return 0;
+
+    return _pcf_bindings_cache_invalidate(__self->pcf_bindings_cache, key);
+}
+
+void _bsf_client_context_response_cache_lifetime(ogs_sbi_response_t *response, bsf_cache_lifetime_t *lifetime)
+{
+    ogs_time_t stale_while_revalidate = 0;
+    ogs_time_t stale_if_error = 0;
+
+    if (__self) {
+        stale_while_revalidate = _bsf_configuration_get_cache_stale_while_revalidate(&__self->config);
+        stale_if_error = _bsf_configuration_get_cache_stale_if_error(&__self->config);
+    }
+
+    _response_to_cache_lifetime(response, stale_while_revalidate, stale_if_error, lifetime);
+}
+
+bsf_pcf_binding_t *_bsf_client_pcf_bindings_from_cache_by_identity(const char *identity_key, bool *stale)
 {
+    if (stale) *stale = false;
     if (!__self) return NULL;
 
-    return _pcf_bindings_cache_find(__self->pcf_bindings_cache, ue_address);
+    return _pcf_bindings_cache_find_by_identity(__self->pcf_bindings_cache, identity_key, stale);
+}
+
+bsf_pcf_binding_t *_bsf_client_pcf_bindings_stale_if_error_from_cache_by_identity(const char *identity_key)
+{
+    if (!__self) return NULL;
+
+    return _pcf_bindings_cache_find_by_identity_stale_if_error(__self->pcf_bindings_cache, identity_key);
+}
+
+const char *_bsf_client_context_pcf_binding_etag(const bsf_ue_address_key_t *ue_address)
+{
+    if (!__self) return NULL;
+
+    return _pcf_bindings_cache_find_etag(__self->pcf_bindings_cache, ue_address);
+}
+
+bsf_pcf_binding_t *_bsf_client_context_revalidated_pcf_binding(const bsf_ue_address_key_t *ue_address, const bsf_cache_lifetime_t *lifetime)
+{
+    if (!__self) return NULL;
+
+    return _pcf_bindings_cache_revalidated(__self->pcf_bindings_cache, ue_address, lifetime);
+}
+
+bool _bsf_client_context_add_pcf_binding(const bsf_ue_address_key_t *lookup_key, bsf_pcf_binding_t *binding, const bsf_cache_lifetime_t *lifetime)
+{
+    const OpenAPI_pcf_binding_t *pcf_binding;
+    bsf_ue_address_key_t prefix;
+
+    if (!__self) return false;
+
+    /* If the BSF told us the UE's IPv6 prefix then cache against the whole
+     * prefix so that other addresses in it are answered from the cache too.
+     */
+    pcf_binding = _bsf_pcf_binding_get(binding);
+    if (lookup_key->family == AF_INET6 && pcf_binding && pcf_binding->ipv6_prefix &&
+            _ue_address_key_from_ipv6_prefix_string(&prefix, pcf_binding->ipv6_prefix) &&
+            _ue_address_key_contains(&prefix, lookup_key)) {
+        return _pcf_bindings_cache_add(__self->pcf_bindings_cache, &prefix, binding, lifetime);
+    }
+
+    return _pcf_bindings_cache_add(__self->pcf_bindings_cache, lookup_key, binding, lifetime);
 }
 
-bool _bsf_client_context_add_pcf_binding(const ogs_sockaddr_t *ue_address, const OpenAPI_pcf_binding_t *binding, ogs_time_t expires)
+/* Cache the answer to a lookup by UE identity against the UE address in the binding, it is then
+ * found by that address and by every identity key for it.
+ */
+bool _bsf_client_context_add_pcf_binding_for_identity(const char *identity_key, bsf_pcf_binding_t *binding, const bsf_cache_lifetime_t *lifetime)
 {
+    const OpenAPI_pcf_binding_t *pcf_binding;
+    bsf_ue_address_key_t key;
+
     if (!__self) return false;
 
-    return _pcf_bindings_cache_add(__self->pcf_bindings_cache, ue_address, binding, expires);
+    pcf_binding = _bsf_pcf_binding_get(binding);
+    if (!pcf_binding) return false;
+
+    if (pcf_binding->ipv4_addr) {
+        if (!_ue_address_key_from_ipv4_string(&key, pcf_binding->ipv4_addr)) return false;
+    } else if (pcf_binding->ipv6_prefix) {
+        if (!_ue_address_key_from_ipv6_prefix_string(&key, pcf_binding->ipv6_prefix)) return false;
+    } else {
+        /* e.g. a MAC address binding, nothing to key the entry on */
+        return false;
+    }
+
+    if (!_pcf_bindings_cache_add(__self->pcf_bindings_cache, &key, binding, lifetime)) return false;
+
+    return _pcf_bindings_cache_add_identity(__self->pcf_bindings_cache, &key, identity_key);
 }
 
-bool _bsf_client_context_active_sessions_add(bsf_client_sess_t *sess)
+bool _bsf_client_context_add_pcf_binding_not_found(const bsf_ue_address_key_t *lookup_key)
 {
-    bsf_client_sess_node_t *node;
+    int ttl;
+
     if (!__self) return false;
-    node = ogs_calloc(1, sizeof(*node));
-    node->sess = sess;
-    ogs_list_add(&__self->active_sessions_list, node);
+
+    ttl = _bsf_configuration_get_cache_negative_ttl(&__self->config);
+    if (ttl <= 0) return false;
+
+    return _pcf_bindings_cache_add_negative(__self->pcf_bindings_cache, lookup_key, ogs_time_now() + ogs_time_from_sec(ttl));
+}
+
+bsf_client_sess_t *_bsf_client_context_active_sessions_new(void)
+{
+    bsf_client_sess_t *sess = NULL;
+
+    if (!__self) return NULL;
+    ogs_pool_id_calloc(&__sess_pool, &sess);
+    if (!sess) return NULL;
+    ogs_list_add(&__self->active_sessions_list, sess);
+    return sess;
+}
+
+void _bsf_client_context_active_sessions_free(bsf_client_sess_t *sess)
+{
+    if (!__self) return;
+    ogs_list_remove(&__self->active_sessions_list, sess);
+    ogs_pool_id_free(&__sess_pool, sess);
+}
+
+bsf_client_sess_t *_bsf_client_context_active_sessions_find_by_id(ogs_pool_id_t id)
+{
+    if (!__self) return NULL;
+    return ogs_pool_find_by_id(&__sess_pool, id);
+}
+
+void _bsf_client_context_pcf_bindings_batches_add(ogs_lnode_t *batch)
+{
+    if (!__self) return;
+    ogs_list_add(&__self->pcf_bindings_batches, batch);
+}
+
+void _bsf_client_context_pcf_bindings_batches_remove(ogs_lnode_t *batch)
+{
+    if (!__self) return;
+    ogs_list_remove(&__self->pcf_bindings_batches, batch);
+}
+
+bsf_client_subscription_t *_bsf_client_context_subscriptions_new(void)
+{
+    bsf_client_subscription_t *subsc = NULL;
+
+    if (!__self) return NULL;
+    ogs_pool_id_calloc(&__subscription_pool, &subsc);
+    if (!subsc) return NULL;
+    ogs_list_add(&__self->subscriptions_list, subsc);
+    return subsc;
+}
+
+void _bsf_client_context_subscriptions_free(bsf_client_subscription_t *subsc)
+{
+    if (!__self) return;
+    ogs_list_remove(&__self->subscriptions_list, subsc);
+    ogs_pool_id_free(&__subscription_pool, subsc);
+}
+
+bsf_client_subscription_t *_bsf_client_context_subscriptions_find_by_id(ogs_pool_id_t id)
+{
+    if (!__self) return NULL;
+    return ogs_pool_find_by_id(&__subscription_pool, id);
+}
+
+bsf_client_subscription_t *_bsf_client_context_subscriptions_find_by_supi(const char *supi)
+{
+    if (!__self || !supi) return NULL;
+    return (bsf_client_subscription_t*)ogs_hash_get(__self->subscriptions_by_supi, supi, OGS_HASH_KEY_STRING);
+}
+
+bool _bsf_client_context_subscriptions_supi_index_add(bsf_client_subscription_t *subsc)
+{
+    if (!__self) return false;
+    if (ogs_hash_get(__self->subscriptions_by_supi, subsc->supi, OGS_HASH_KEY_STRING)) return false;
+    ogs_hash_set(__self->subscriptions_by_supi, subsc->supi, OGS_HASH_KEY_STRING, subsc);
+    subsc->in_supi_index = true;
     return true;
 }
 
-bool _bsf_client_context_active_sessions_remove(bsf_client_sess_t *sess)
+bool _bsf_client_context_subscriptions_supi_index_remove(bsf_client_subscription_t *subsc)
 {
-    bsf_client_sess_node_t *node;
+    if (!__self) return false;
+    if (!subsc->in_supi_index) return false;
+    ogs_hash_set(__self->subscriptions_by_supi, subsc->supi, OGS_HASH_KEY_STRING, NULL);
+    subsc->in_supi_index = false;
+    return true;
+}
 
+bsf_client_sess_t *_bsf_client_context_pending_lookups_find(const bsf_ue_address_key_t *ue_address)
+{
+    if (!__self) return NULL;
+    return (bsf_client_sess_t*)ogs_hash_get(__self->pending_lookups, ue_address, sizeof(*ue_address));
+}
+
+bsf_client_sess_t *_bsf_client_context_pending_identity_lookups_find(const char *identity_key)
+{
+    if (!__self) return NULL;
+    return (bsf_client_sess_t*)ogs_hash_get(__self->pending_identity_lookups, identity_key, OGS_HASH_KEY_STRING);
+}
+
+bool _bsf_client_context_pending_lookups_add(bsf_client_sess_t *sess)
+{
     if (!__self) return false;
-    node = __bsf_client_context_active_sessions_find(sess);
-    if (!node) return false;
-    ogs_list_remove(&__self->active_sessions_list, node);
-    ogs_free(node);
+    if (sess->identity_key) {
+        if (ogs_hash_get(__self->pending_identity_lookups, sess->identity_key, OGS_HASH_KEY_STRING)) return false;
+        ogs_hash_set(__self->pending_identity_lookups, sess->identity_key, OGS_HASH_KEY_STRING, sess);
+    } else {
+        if (ogs_hash_get(__self->pending_lookups, &sess->lookup_key, sizeof(sess->lookup_key))) return false;
+        ogs_hash_set(__self->pending_lookups, &sess->lookup_key, sizeof(sess->lookup_key), sess);
+    }
+    sess->is_pending_lookup = true;
     return true;
 }
 
-bool _bsf_client_context_active_sessions_exists(bsf_client_sess_t *sess)
+bool _bsf_client_context_pending_lookups_remove(bsf_client_sess_t *sess)
 {
-    return __bsf_client_context_active_sessions_find(sess) != NULL;
+    if (!__self) return false;
+    if (!sess->is_pending_lookup) return false;
+    if (sess->identity_key) {
+        ogs_hash_set(__self->pending_identity_lookups, sess->identity_key, OGS_HASH_KEY_STRING, NULL);
+    } else {
+        ogs_hash_set(__self->pending_lookups, &sess->lookup_key, sizeof(sess->lookup_key), NULL);
+    }
+    sess->is_pending_lookup = false;
+    return true;
 }
 
 /*** Private functions ***/
@@ -190,8 +489,20 @@ static void __bsf_client_context_init(void)
 
     /* Initialise context fields */
     _bsf_configuration_init(&__self->config);
-    _pcf_bindings_cache_init(&__self->pcf_bindings_cache);
+    _pcf_bindings_cache_init(&__self->pcf_bindings_cache, _bsf_configuration_get_cache_max_entries(&__self->config),
+                             _bsf_configuration_get_cache_negative_max_entries(&__self->config));
     ogs_list_init(&__self->active_sessions_list);
+    ogs_pool_init(&__sess_pool, ogs_app()->pool.sess);
+    __self->pending_lookups = ogs_hash_make();
+    __self->pending_identity_lookups = ogs_hash_make();
+    ogs_list_init(&__self->notification_servers);
+    ogs_list_init(&__self->subscriptions_list);
+    ogs_pool_init(&__subscription_pool, ogs_app()->pool.sess);
+    __self->subscriptions_by_supi = ogs_hash_make();
+    ogs_list_init(&__self->pcf_bindings_batches);
+
+    /* keep binding event subscriptions in step with the cache contents */
+    _pcf_bindings_cache_set_binding_listener(__self->pcf_bindings_cache, __cache_binding_added, __cache_binding_removed, NULL);
 
     ogs_debug("BSF client context initialised");
 }
@@ -324,6 +635,43 @@ static void __parse_server_config(ogs_yaml_iter_t *iter, parse_server_add_f adde
     } while (ogs_yaml_iter_type(&sbi_array) == YAML_SEQUENCE_NODE);
 }
 
+static void __parse_cache_config(ogs_yaml_iter_t *iter)
+{
+    ogs_yaml_iter_t cache_iter;
+
+    ogs_yaml_iter_recurse(iter, &cache_iter);
+    while (ogs_yaml_iter_next(&cache_iter)) {
+        const char *cache_key = ogs_yaml_iter_key(&cache_iter);
+        ogs_assert(cache_key);
+
+        if (!strcmp(cache_key, "maxEntries")) {
+            const char *v = ogs_yaml_iter_value(&cache_iter);
+            if (v) _bsf_configuration_set_cache_max_entries(&__self->config, atoi(v));
+        } else if (!strcmp(cache_key, "staleWhileRevalidate")) {
+            const char *v = ogs_yaml_iter_value(&cache_iter);
+            if (v) _bsf_configuration_set_cache_stale_while_revalidate(&__self->config, atoi(v));
+        } else if (!strcmp(cache_key, "staleIfError")) {
+            const char *v = ogs_yaml_iter_value(&cache_iter);
+            if (v) _bsf_configuration_set_cache_stale_if_error(&__self->config, atoi(v));
+        } else if (!strcmp(cache_key, "negativeTtl")) {
+            const char *v = ogs_yaml_iter_value(&cache_iter);
+            if (v) _bsf_configuration_set_cache_negative_ttl(&__self->config, atoi(v));
+        } else if (!strcmp(cache_key, "negativeMaxEntries")) {
+            const char *v = ogs_yaml_iter_value(&cache_iter);
+            if (v) _bsf_configuration_set_cache_negative_max_entries(&__self->config, atoi(v));
+        } else if (!strcmp(cache_key, "snapshotFile")) {
+            _bsf_configuration_set_cache_snapshot_file(&__self->config, ogs_yaml_iter_value(&cache_iter));
+        } else if (!strcmp(cache_key, "snapshotInterval")) {
+            const char *v = ogs_yaml_iter_value(&cache_iter);
+            if (v) _bsf_configuration_set_cache_snapshot_interval(&__self->config, atoi(v));
+        } else if (!strcmp(cache_key, "subscribe")) {
+            _bsf_configuration_set_cache_subscribe_flag(&__self->config, ogs_yaml_iter_bool(&cache_iter));
+        } else {
+            ogs_warn("unknown key `%s`", cache_key);
+        }
+    }
+}
+
 static int __server_add(const char *hostname, int port)
 {
     if (!__self) return OGS_ERROR;
@@ -339,6 +687,7 @@ static int __notification_listener_add(const char *hostname, int port)
 static int  __notification_listener_start(ogs_list_t *ipv4_listen, ogs_list_t *ipv6_listen, ogs_sockaddr_t *addr, ogs_sockopt_t *option)
 {
     ogs_socknode_t *node;
+    bsf_client_notification_server_t *notif_server;
 
     node = ogs_list_first(ipv4_listen);
     if (node) {
@@ -347,6 +696,11 @@ static int  __notification_listener_start(ogs_list_t *ipv4_listen, ogs_list_t *i
 
         if (addr)
             ogs_sbi_server_set_advertise(server, AF_INET, addr);
+
+        notif_server = ogs_calloc(1, sizeof(*notif_server));
+        ogs_assert(notif_server);
+        notif_server->server = server;
+        ogs_list_add(&__self->notification_servers, notif_server);
     }
 
     node = ogs_list_first(ipv6_listen);
@@ -356,6 +710,11 @@ static int  __notification_listener_start(ogs_list_t *ipv4_listen, ogs_list_t *i
 
         if (addr)
             ogs_sbi_server_set_advertise(server, AF_INET6, addr);
+
+        notif_server = ogs_calloc(1, sizeof(*notif_server));
+        ogs_assert(notif_server);
+        notif_server->server = server;
+        ogs_list_add(&__self->notification_servers, notif_server);
     }
 
     return OGS_OK;
@@ -368,10 +727,22 @@ static int  __bsf_client_context_validation(void)
         return OGS_ERROR;
     }
 
+    if (_bsf_configuration_servers_exist(&__self->config)) {
+        /* resolve the BSF servers now so that lookups never wait on DNS */
+        __servers_resolve();
+    }
+
     if (!_bsf_configuration_servers_exist(&__self->config) && _bsf_configuration_get_discover_flag(&__self->config)) {
         int rv;
         ogs_sbi_xact_t *xact;
-        xact = ogs_sbi_xact_add(0, (ogs_sbi_object_t*)_bsf_client_sess_new() ,OGS_SBI_SERVICE_TYPE_NBSF_MANAGEMENT , NULL, NULL, NULL, NULL);
+        bsf_client_sess_t *sess;
+
+        sess = _bsf_client_sess_new();
+        if (!sess) {
+            ogs_error("_bsf_client_sess_new() failed");
+            return OGS_ERROR;
+        }
+        xact = ogs_sbi_xact_add(sess->id, &sess->sbi, OGS_SBI_SERVICE_TYPE_NBSF_MANAGEMENT, NULL, NULL, NULL, NULL);
         if (!xact) {
             ogs_error("ogs_sbi_xact_add() failed");
             return OGS_ERROR;
@@ -386,30 +757,92 @@ static int  __bsf_client_context_validation(void)
     return OGS_OK;
 }
 
-static bsf_client_sess_node_t *__bsf_client_context_active_sessions_find(bsf_client_sess_t *sess)
-{
-    bsf_client_sess_node_t *node;
-    if (!__self) return NULL;
-    ogs_list_for_each(&__self->active_sessions_list, node) {
-        if (node->sess == sess) return node;
-    }
-    return NULL;
-}
-
 static void __active_sessions_log_debug(int indent)
 {
     const char *sep = NULL;
-    bsf_client_sess_node_t *node;
+    bsf_client_sess_t *sess;
 
     if (!__self) return;
 
-    ogs_list_for_each(&__self->active_sessions_list, node) {
+    ogs_list_for_each(&__self->active_sessions_list, sess) {
         if (sep) ogs_debug("%s", sep);
-        _bsf_client_sess_log_debug(node->sess, indent);
+        _bsf_client_sess_log_debug(sess, indent);
         sep = "---------------------";
     }
 }
 
+static void __servers_resolve(void)
+{
+    int interval;
+
+    if (!_bsf_configuration_servers_resolve(&__self->config))
+        ogs_error("None of the configured BSF servers could be resolved");
+
+    /* ogs_getaddrinfo() blocks the event loop, so periodic re-resolution is only done when configured */
+    interval = _bsf_configuration_get_resolve_interval(&__self->config);
+    if (interval <= 0) return;
+
+    if (!__self->resolve_timer) {
+        __self->resolve_timer = ogs_timer_add(ogs_app()->timer_mgr, __resolve_timer_expired, NULL);
+        ogs_assert(__self->resolve_timer);
+    }
+    ogs_timer_start(__self->resolve_timer, ogs_time_from_sec(interval));
+}
+
+static void __resolve_timer_expired(void *data)
+{
+    if (!__self) return;
+
+    ogs_debug("Refreshing BSF server addresses");
+    __servers_resolve();
+}
+
+static void __snapshot_load(void)
+{
+    const char *filename = _bsf_configuration_get_cache_snapshot_file(&__self->config);
+    int interval;
+
+    if (!filename) return;
+
+    _pcf_bindings_cache_snapshot_load(__self->pcf_bindings_cache, filename);
+
+    interval = _bsf_configuration_get_cache_snapshot_interval(&__self->config);
+    if (interval <= 0) return;
+
+    if (!__self->snapshot_timer) {
+        __self->snapshot_timer = ogs_timer_add(ogs_app()->timer_mgr, __snapshot_timer_expired, NULL);
+        ogs_assert(__self->snapshot_timer);
+    }
+    ogs_timer_start(__self->snapshot_timer, ogs_time_from_sec(interval));
+}
+
+static void __snapshot_save(void)
+{
+    const char *filename = _bsf_configuration_get_cache_snapshot_file(&__self->config);
+
+    if (!filename) return;
+
+    _pcf_bindings_cache_snapshot_save(__self->pcf_bindings_cache, filename);
+}
+
+static void __snapshot_timer_expired(void *data)
+{
+    if (!__self) return;
+
+    __snapshot_save();
+    ogs_timer_start(__self->snapshot_timer, ogs_time_from_sec(_bsf_configuration_get_cache_snapshot_interval(&__self->config)));
+}
+
+static void __cache_binding_added(const bsf_pcf_binding_t *binding, void *data)
+{
+    _bsf_client_subscription_binding_cached(binding);
+}
+
+static void __cache_binding_removed(const bsf_pcf_binding_t *binding, void *data)
+{
+    _bsf_client_subscription_binding_uncached(binding);
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -14,17 +14,38 @@
 #include "ogs-sbi.h"
 
 #include "bsf-configuration.h"
+#include "pcf-bindings-cache.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 typedef struct bsf_client_sess_s bsf_client_sess_t;
+typedef struct bsf_client_subscription_s bsf_client_subscription_t;
+
+typedef struct bsf_client_notification_server_s {
+    ogs_lnode_t node;
+    ogs_sbi_server_t *server;
+} bsf_client_notification_server_t;
 
 typedef struct bsf_client_context_s {
     bsf_configuration_t config;
-    ogs_hash_t *pcf_bindings_cache;  // ue-address => pcf_bindings_cache_t
-    ogs_list_t active_sessions_list; // Nodes of this list are bsf_client_sess_t
+    pcf_bindings_cache_t *pcf_bindings_cache;
+    ogs_list_t active_sessions_list; // Nodes of this list are bsf_client_sess_t (intrusive, pool allocated)
+    ogs_hash_t *pending_lookups;     // bsf_ue_address_key_t => bsf_client_sess_t with a BSF request in flight
+    ogs_hash_t *pending_identity_lookups; // UE identity key => bsf_client_sess_t with a BSF request in flight
+    ogs_timer_t *resolve_timer;      // periodic re-resolution of the configured BSF servers
+    ogs_timer_t *snapshot_timer;     // periodic save of the PCF bindings cache
+    ogs_list_t notification_servers; // Nodes of this list are bsf_client_notification_server_t
+    ogs_list_t subscriptions_list;   // Nodes of this list are bsf_client_subscription_t (intrusive, pool allocated)
+    ogs_hash_t *subscriptions_by_supi; // SUPI => bsf_client_subscription_t for SUPIs with cached bindings
+    ogs_list_t pcf_bindings_batches; // Nodes of this list are the batch lookups in progress (see pcf-bind.c)
+    struct {
+        ogs_pool_id_t *sess_ids;     // bsf_client_sess_t ids waiting to be sent to the BSF, oldest first
+        int count;
+        int capacity;
+        bool event_queued;           // a BSF_CLIENT_LOCAL_DISCOVER_AND_SEND event is on the queue for these
+    } queued_sends;
 } bsf_client_context_t;
 
 /* Library Internal Public */
@@ -35,12 +56,42 @@ bsf_client_context_t *_bsf_client_self(void);
 
 void _bsf_client_context_log_debug(void);
 
-OpenAPI_pcf_binding_t *_bsf_client_pcf_bindings_from_cache(ogs_sockaddr_t *ue_address);
-bool _bsf_client_context_add_pcf_binding(const ogs_sockaddr_t *ue_address, const OpenAPI_pcf_binding_t *binding, ogs_time_t expires);
+const ogs_sockaddr_t *_bsf_client_context_get_bsf_address(void);
+ogs_sbi_client_t *_bsf_client_context_get_bsf_client(void);
+int _bsf_client_context_get_batch_max_in_flight(void);
+bool _bsf_client_context_get_subscribe_flag(void);
+ogs_sbi_server_t *_bsf_client_context_get_notification_server(void);
+bool _bsf_client_context_is_notification_server(ogs_sbi_server_t *server);
+bsf_pcf_binding_t *_bsf_client_pcf_bindings_from_cache(const bsf_ue_address_key_t *ue_address, bool *stale, bool *negative);
+bsf_pcf_binding_t *_bsf_client_pcf_bindings_stale_if_error_from_cache(const bsf_ue_address_key_t *ue_address);
+bsf_pcf_binding_t *_bsf_client_pcf_bindings_from_cache_by_identity(const char *identity_key, bool *stale);
+bsf_pcf_binding_t *_bsf_client_pcf_bindings_stale_if_error_from_cache_by_identity(const char *identity_key);
+const char *_bsf_client_context_pcf_binding_etag(const bsf_ue_address_key_t *ue_address);
+bsf_pcf_binding_t *_bsf_client_context_revalidated_pcf_binding(const bsf_ue_address_key_t *ue_address, const bsf_cache_lifetime_t *lifetime);
+bool _bsf_client_context_add_pcf_binding(const bsf_ue_address_key_t *lookup_key, bsf_pcf_binding_t *binding, const bsf_cache_lifetime_t *lifetime);
+bool _bsf_client_context_add_pcf_binding_for_identity(const char *identity_key, bsf_pcf_binding_t *binding, const bsf_cache_lifetime_t *lifetime);
+bool _bsf_client_context_add_pcf_binding_not_found(const bsf_ue_address_key_t *lookup_key);
+int _bsf_client_context_invalidate_pcf_bindings(const bsf_ue_address_key_t *key);
+void _bsf_client_context_response_cache_lifetime(ogs_sbi_response_t *response, bsf_cache_lifetime_t *lifetime);
+
+bsf_client_sess_t *_bsf_client_context_active_sessions_new(void);
+void _bsf_client_context_active_sessions_free(bsf_client_sess_t *sess);
+bsf_client_sess_t *_bsf_client_context_active_sessions_find_by_id(ogs_pool_id_t id);
+
+bsf_client_subscription_t *_bsf_client_context_subscriptions_new(void);
+void _bsf_client_context_subscriptions_free(bsf_client_subscription_t *subsc);
+bsf_client_subscription_t *_bsf_client_context_subscriptions_find_by_id(ogs_pool_id_t id);
+bsf_client_subscription_t *_bsf_client_context_subscriptions_find_by_supi(const char *supi);
+bool _bsf_client_context_subscriptions_supi_index_add(bsf_client_subscription_t *subsc);
+bool _bsf_client_context_subscriptions_supi_index_remove(bsf_client_subscription_t *subsc);
+
+bsf_client_sess_t *_bsf_client_context_pending_lookups_find(const bsf_ue_address_key_t *ue_address);
+bsf_client_sess_t *_bsf_client_context_pending_identity_lookups_find(const char *identity_key);
+bool _bsf_client_context_pending_lookups_add(bsf_client_sess_t *sess);
+bool _bsf_client_context_pending_lookups_remove(bsf_client_sess_t *sess);
 
-bool _bsf_client_context_active_sessions_add(bsf_client_sess_t *sess);
-bool _bsf_client_context_active_sessions_remove(bsf_client_sess_t *sess);
-bool _bsf_client_context_active_sessions_exists(bsf_client_sess_t *sess);
+void _bsf_client_context_pcf_bindings_batches_add(ogs_lnode_t *batch);
+void _bsf_client_context_pcf_bindings_batches_remove(ogs_lnode_t *batch);
 
 #ifdef __cplusplus
 }
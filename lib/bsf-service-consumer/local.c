@@ -20,23 +20,44 @@ https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
 extern "C" {
 #endif
 
+/* Queue sess to be sent to the BSF. Sessions queued while the event loop is busy are sent together
+ * from a single event, so a burst of lookups costs one queue push and one pollset wakeup.
+ */
 bool _bsf_client_local_discover_and_send(bsf_client_sess_t *sess)
 {
     int rv;
+    bsf_client_context_t *self = _bsf_client_self();
     bsf_client_event_t *ev;
 
+    if (!self || !sess) return false;
+
+    if (self->queued_sends.count == self->queued_sends.capacity) {
+        self->queued_sends.capacity = self->queued_sends.capacity ? self->queued_sends.capacity * 2 : 16;
+        self->queued_sends.sess_ids = ogs_realloc(self->queued_sends.sess_ids,
+                                                  self->queued_sends.capacity * sizeof(self->queued_sends.sess_ids[0]));
+        ogs_assert(self->queued_sends.sess_ids);
+    }
+    self->queued_sends.sess_ids[self->queued_sends.count++] = sess->id;
+
+    /* already an event on its way to send this batch */
+    if (self->queued_sends.event_queued) return true;
+
     ev = ogs_event_size(BSF_CLIENT_LOCAL_EVENT, sizeof(*ev));
     ogs_assert(ev);
 
     ev->id = BSF_CLIENT_LOCAL_DISCOVER_AND_SEND;
-    ev->h.sbi.data = sess;
+    ev->h.sbi.data = &self->queued_sends;
 
     ogs_debug("Queueing discover & send event (%p)", ev);
+
     rv = ogs_queue_push(ogs_app()->queue, &ev->h);
     if (rv != OGS_OK) {
+        /* the session stays queued, the next lookup will try again */
         ogs_error("Failed to push discover and send event onto the queue");
+        ogs_event_free(ev);
         return false;
     }
+    self->queued_sends.event_queued = true;
 
     /* process the event queue */
     ogs_pollset_notify(ogs_app()->pollset);
@@ -48,25 +69,49 @@ bool _bsf_client_local_discover_and_send(bsf_client_sess_t *sess)
 
 bool _bsf_client_local_process_event(ogs_event_t *e)
 {
-    bsf_client_sess_t *sess;
+    bsf_client_context_t *self = _bsf_client_self();
+    bsf_client_event_t *bsf_event;
 
-    if (!e) return false;
+    if (!e || !self) return false;
     if (e->id != BSF_CLIENT_LOCAL_EVENT) return false;
+    if (e->sbi.data != &self->queued_sends) return false;
+
+    bsf_event = ogs_container_of(e, bsf_client_event_t, h);
+    switch (bsf_event->id) {
+        case BSF_CLIENT_LOCAL_DISCOVER_AND_SEND:
+        {
+            ogs_pool_id_t *sess_ids = self->queued_sends.sess_ids;
+            int count = self->queued_sends.count;
+            int i;
+
+            /* take the batch, sessions queued by callbacks from here on go in the next one */
+            self->queued_sends.sess_ids = NULL;
+            self->queued_sends.count = 0;
+            self->queued_sends.capacity = 0;
+            self->queued_sends.event_queued = false;
+
+            ogs_debug("Discover & Send event for %i sessions", count);
+
+            for (i = 0; i < count; i++) {
+                bsf_client_sess_t *sess = _bsf_client_context_active_sessions_find_by_id(sess_ids[i]);
+
+                if (!sess) continue;
+                if (!_bsf_client_sess_discover_and_send(sess)) {
+                    /* don't leave waiters attached to a request that was never sent */
+                    _bsf_client_context_pending_lookups_remove(sess);
+                    _bsf_client_sess_retrieve_callback_call_on_error(sess);
+                    _bsf_client_sess_free(sess);
+                }
+            }
 
-    sess = (bsf_client_sess_t*)e->sbi.data;
-    if (_bsf_client_context_active_sessions_exists(sess)) {
-        bsf_client_event_t *bsf_event = ogs_container_of(e, bsf_client_event_t, h);
-        switch (bsf_event->id) {
-            case BSF_CLIENT_LOCAL_DISCOVER_AND_SEND:
-                ogs_debug("Discover & Send event");
-                _bsf_client_sess_discover_and_send(sess);
-                break;
-            default:
-                break;
+            if (sess_ids) ogs_free(sess_ids);
+            break;
         }
-        return true;
+        default:
+            break;
     }
-    return false;
+
+    return true;
 }
 
 const char *_bsf_client_local_get_event_name(ogs_event_t *e)
@@ -74,9 +119,9 @@ const char *_bsf_client_local_get_event_name(ogs_event_t *e)
     if (e->id < OGS_MAX_NUM_OF_PROTO_EVENT)
         return ogs_event_get_name(e);
     if (e->id == BSF_CLIENT_LOCAL_EVENT) {
-        bsf_client_sess_t *sess;
-        sess = (bsf_client_sess_t*)e->sbi.data;
-        if (_bsf_client_context_active_sessions_exists(sess)) {
+        bsf_client_context_t *self = _bsf_client_self();
+
+        if (self && e->sbi.data == &self->queued_sends) {
             bsf_client_event_t *bsf_event = ogs_container_of(e, bsf_client_event_t, h);
             switch (bsf_event->id) {
                 case BSF_CLIENT_LOCAL_DISCOVER_AND_SEND:
@@ -10,6 +10,8 @@ https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
 #include "ogs-sbi.h"
 
 #include "bsf-client-sess.h"
+#include "bsf-subscription.h"
+#include "context.h"
 
 #include "nbsf-management-build.h"
 
@@ -21,6 +23,7 @@ ogs_sbi_request_t *_nbsf_management_pcf_binding_build(bsf_client_sess_t *sess, v
 {
     ogs_sbi_message_t message;
     ogs_sbi_request_t *request;
+    const char *etag;
 
     ogs_assert(sess);
 
@@ -37,6 +40,112 @@ ogs_sbi_request_t *_nbsf_management_pcf_binding_build(bsf_client_sess_t *sess, v
     request = ogs_sbi_build_request(&message);
     ogs_expect(request);
 
+    if (!request) return NULL;
+
+    if (sess->identity_key) {
+        /* lookup by UE identity, set as query parameters directly */
+        if (sess->supi) ogs_sbi_header_set(request->http.params, "supi", sess->supi);
+        if (sess->gpsi) ogs_sbi_header_set(request->http.params, "gpsi", sess->gpsi);
+        if (sess->dnn) ogs_sbi_header_set(request->http.params, "dnn", sess->dnn);
+        if (sess->snssai) {
+            cJSON *json = OpenAPI_snssai_convertToJSON(sess->snssai);
+            char *snssai = json ? cJSON_PrintUnformatted(json) : NULL;
+
+            if (json) cJSON_Delete(json);
+            if (snssai) {
+                ogs_sbi_header_set(request->http.params, "snssai", snssai);
+                ogs_free(snssai);
+            }
+        }
+    } else {
+        /* revalidate what we have cached, a 304 answer saves sending the binding again */
+        etag = _bsf_client_context_pcf_binding_etag(&sess->lookup_key);
+        if (etag) ogs_sbi_header_set(request->http.headers, "If-None-Match", etag);
+    }
+
+    return request;
+}
+
+/* Nbsf_Management BsfSubscription create, built by hand as the OpenAPI message layer doesn't carry it */
+ogs_sbi_request_t *_nbsf_management_subscription_build_create(bsf_client_subscription_t *subsc, void *data)
+{
+    ogs_sbi_message_t message;
+    ogs_sbi_request_t *request;
+    ogs_sbi_header_t header;
+    ogs_sbi_server_t *server;
+    cJSON *json, *events;
+    char *notif_corre_id;
+    char *notif_uri;
+    char *body;
+
+    ogs_assert(subsc);
+
+    server = _bsf_client_context_get_notification_server();
+    if (!server) return NULL;
+
+    notif_corre_id = ogs_msprintf("%u", (unsigned int)subsc->id);
+
+    memset(&header, 0, sizeof(header));
+    header.service.name = (char *)BSF_CLIENT_NOTIFICATION_SERVICE_NAME;
+    header.api.version = (char *)OGS_SBI_API_V1;
+    header.resource.component[0] = (char *)OGS_SBI_RESOURCE_NAME_SUBSCRIPTIONS;
+    header.resource.component[1] = notif_corre_id;
+    notif_uri = ogs_sbi_server_uri(server, &header);
+
+    json = cJSON_CreateObject();
+    ogs_assert(json);
+    events = cJSON_AddArrayToObject(json, "events");
+    cJSON_AddItemToArray(events, cJSON_CreateString("PCF_PDU_SESSION_BINDING_REGISTRATION"));
+    cJSON_AddItemToArray(events, cJSON_CreateString("PCF_PDU_SESSION_BINDING_DEREGISTRATION"));
+    cJSON_AddStringToObject(json, "notifUri", notif_uri);
+    cJSON_AddStringToObject(json, "notifCorreId", notif_corre_id);
+    cJSON_AddStringToObject(json, "supi", subsc->supi);
+    body = cJSON_PrintUnformatted(json);
+    cJSON_Delete(json);
+
+    ogs_free(notif_uri);
+    ogs_free(notif_corre_id);
+
+    memset(&message, 0, sizeof(message));
+    message.h.method = (char *)OGS_SBI_HTTP_METHOD_POST;
+    message.h.service.name = (char *)OGS_SBI_SERVICE_NAME_NBSF_MANAGEMENT;
+    message.h.api.version = (char *)OGS_SBI_API_V1;
+    message.h.resource.component[0] =
+        (char *)OGS_SBI_RESOURCE_NAME_SUBSCRIPTIONS;
+    message.http.content_type = (char *)OGS_SBI_CONTENT_JSON_TYPE;
+
+    request = ogs_sbi_build_request(&message);
+    ogs_expect(request);
+
+    if (request) {
+        request->http.content = body;
+        request->http.content_length = body ? strlen(body) : 0;
+    } else if (body) {
+        cJSON_free(body);
+    }
+
+    return request;
+}
+
+ogs_sbi_request_t *_nbsf_management_subscription_build_delete(bsf_client_subscription_t *subsc, void *data)
+{
+    ogs_sbi_message_t message;
+    ogs_sbi_request_t *request;
+
+    ogs_assert(subsc);
+    ogs_assert(subsc->subscription_id);
+
+    memset(&message, 0, sizeof(message));
+    message.h.method = (char *)OGS_SBI_HTTP_METHOD_DELETE;
+    message.h.service.name = (char *)OGS_SBI_SERVICE_NAME_NBSF_MANAGEMENT;
+    message.h.api.version = (char *)OGS_SBI_API_V1;
+    message.h.resource.component[0] =
+        (char *)OGS_SBI_RESOURCE_NAME_SUBSCRIPTIONS;
+    message.h.resource.component[1] = subsc->subscription_id;
+
+    request = ogs_sbi_build_request(&message);
+    ogs_expect(request);
+
     return request;
 }
 
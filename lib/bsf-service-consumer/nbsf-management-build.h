@@ -15,9 +15,12 @@ extern "C" {
 #endif
 
 typedef struct bsf_client_sess_s bsf_client_sess_t;
+typedef struct bsf_client_subscription_s bsf_client_subscription_t;
 typedef struct ogs_sbi_request_s ogs_sbi_request_t;
 
 ogs_sbi_request_t *_nbsf_management_pcf_binding_build(bsf_client_sess_t *sess, void *data);
+ogs_sbi_request_t *_nbsf_management_subscription_build_create(bsf_client_subscription_t *subsc, void *data);
+ogs_sbi_request_t *_nbsf_management_subscription_build_delete(bsf_client_subscription_t *subsc, void *data);
 
 #ifdef __cplusplus
 }
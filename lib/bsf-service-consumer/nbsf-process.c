@@ -11,9 +11,11 @@ https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
 #include "ogs-sbi.h"
 
 #include "bsf-client-sess.h"
+#include "bsf-subscription.h"
 #include "context.h"
 #include "local.h"
 #include "log.h"
+#include "pcf-binding-ref.h"
 #include "utils.h"
 
 #include "nbsf-process.h"
@@ -30,6 +32,9 @@ bool _bsf_process_event(ogs_event_t *e)
     ogs_debug("_bsf_process_event: %s", _bsf_client_local_get_event_name(e));
 
     switch (e->id) {
+        case OGS_EVENT_SBI_SERVER:
+            /* possible PCF binding event notification */
+            return _bsf_client_subscription_process_notification(e);
         case OGS_EVENT_SBI_CLIENT:
         {
             int rv;
@@ -42,8 +47,14 @@ bool _bsf_process_event(ogs_event_t *e)
             if (!xact) return false;
 
             /* Check if this is one of ours */
-            sess = ogs_container_of(xact->sbi_object, bsf_client_sess_t, sbi);
-            if (!_bsf_client_context_active_sessions_exists(sess)) return false;
+            sess = _bsf_client_context_active_sessions_find_by_id(xact->sbi_object_id);
+            if (!sess || &sess->sbi != xact->sbi_object) {
+                bsf_client_subscription_t *subsc = _bsf_client_context_subscriptions_find_by_id(xact->sbi_object_id);
+                if (!subsc || &subsc->sbi != xact->sbi_object) return false;
+
+                ogs_assert(response);
+                return _bsf_client_subscription_process_response(subsc, xact, response);
+            }
 
             ogs_assert(response);
             rv = ogs_sbi_parse_header(&message, &response->h);
@@ -106,8 +117,12 @@ bool _bsf_process_event(ogs_event_t *e)
                         _bsf_client_context_log_debug();
                         ogs_debug("bsf_client_sess_t = %p", sess);
 
+                        /* answer all waiters, new lookups from the callbacks will start afresh */
+                        _bsf_client_context_pending_lookups_remove(sess);
+
                         if (message.res_status == OGS_SBI_HTTP_STATUS_OK) {
-                            ogs_time_t expires;
+                            bsf_cache_lifetime_t lifetime;
+                            bsf_pcf_binding_t *binding;
                             char *method = response->h.method; /* save this */
 
                             ogs_sbi_message_free(&message);
@@ -121,16 +136,56 @@ bool _bsf_process_event(ogs_event_t *e)
                                 break;
                             }
 
-                            expires = _response_to_expiry_time(response);
-                            _bsf_client_context_add_pcf_binding(sess->ue_address, message.PcfBinding, expires);
-                                
-                            if (!_bsf_client_sess_retrieve_callback_call(sess, message.PcfBinding)) {
+                            /* take ownership of the parsed binding, shared by the cache and the callbacks */
+                            binding = _bsf_pcf_binding_new(message.PcfBinding);
+                            message.PcfBinding = NULL;
+
+                            _bsf_client_context_response_cache_lifetime(response, &lifetime);
+                            if (binding) {
+                                if (sess->identity_key) {
+                                    _bsf_client_context_add_pcf_binding_for_identity(sess->identity_key, binding, &lifetime);
+                                } else {
+                                    _bsf_client_context_add_pcf_binding(&sess->lookup_key, binding, &lifetime);
+                                }
+                            }
+
+                            if (!_bsf_client_sess_retrieve_callback_call(sess, binding)) {
                                 ogs_error("_bsf_client_sess_retrieve_callback_call() failed");
                             }
+                            _bsf_pcf_binding_unref(binding);
+                        } else if (message.res_status == OGS_SBI_HTTP_STATUS_NOT_MODIFIED) {
+                            bsf_cache_lifetime_t lifetime;
+                            bsf_pcf_binding_t *binding;
+
+                            /* our If-None-Match matched, the cached binding is current again */
+                            _bsf_client_context_response_cache_lifetime(response, &lifetime);
+                            binding = NULL;
+                            /* only lookups by UE address send If-None-Match */
+                            if (!sess->identity_key)
+                                binding = _bsf_pcf_binding_ref(_bsf_client_context_revalidated_pcf_binding(&sess->lookup_key, &lifetime));
+                            if (binding) {
+                                if (!_bsf_client_sess_retrieve_callback_call(sess, binding)) {
+                                    ogs_error("_bsf_client_sess_retrieve_callback_call() failed");
+                                }
+                                _bsf_pcf_binding_unref(binding);
+                            } else {
+                                /* cached binding has gone since we asked */
+                                ogs_error("PCF binding revalidated but no longer cached");
+                                _bsf_client_sess_retrieve_callback_call_on_error(sess);
+                            }
                         } else {
-                            char *ip = ogs_ipstrdup(sess->ue_address);
+                            char *ip = _bsf_client_sess_lookup_string(sess);
                             ogs_error("Unable to find PCF binding for %s", ip);
-                            _bsf_client_sess_retrieve_callback_call(sess, NULL);
+                            if (message.res_status >= 500) {
+                                /* BSF failure rather than a definitive answer */
+                                _bsf_client_sess_retrieve_callback_call_on_error(sess);
+                            } else {
+                                /* "no binding" is only remembered per UE address */
+                                if (!sess->identity_key && (message.res_status == OGS_SBI_HTTP_STATUS_NO_CONTENT ||
+                                        message.res_status == OGS_SBI_HTTP_STATUS_NOT_FOUND))
+                                    _bsf_client_context_add_pcf_binding_not_found(&sess->lookup_key);
+                                _bsf_client_sess_retrieve_callback_call(sess, NULL);
+                            }
                             ogs_free(ip);
                         }
                         ogs_sbi_xact_remove(xact);
@@ -175,13 +230,19 @@ bool _bsf_process_event(ogs_event_t *e)
                 if (!xact) return false;
 
                 /* Check if this is one of ours */
-                sess = ogs_container_of(xact->sbi_object, bsf_client_sess_t, sbi);
-                if (!_bsf_client_context_active_sessions_exists(sess)) return false;
+                sess = _bsf_client_context_active_sessions_find_by_id(xact->sbi_object_id);
+                if (!sess || &sess->sbi != xact->sbi_object) {
+                    bsf_client_subscription_t *subsc = _bsf_client_context_subscriptions_find_by_id(xact->sbi_object_id);
+                    if (!subsc || &subsc->sbi != xact->sbi_object) return false;
+
+                    return _bsf_client_subscription_process_timeout(subsc, xact);
+                }
 
-                /* inform the callback of the error */
-                ip = ogs_ipstrdup(sess->ue_address);
+                /* inform the waiting callbacks of the error */
+                _bsf_client_context_pending_lookups_remove(sess);
+                ip = _bsf_client_sess_lookup_string(sess);
                 ogs_error("Timed out trying to find PCF binding for %s", ip);
-                _bsf_client_sess_retrieve_callback_call(sess, NULL);
+                _bsf_client_sess_retrieve_callback_call_on_error(sess);
                 ogs_free(ip);
 
                 /* destroy this transaction and BSF session */
@@ -12,6 +12,8 @@ https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
 #include "context.h"
 #include "local.h"
 #include "log.h"
+#include "pcf-binding-ref.h"
+#include "ue-identity-key.h"
 
 #include "pcf-bind.h"
 
@@ -19,30 +21,244 @@ https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
 extern "C" {
 #endif
 
+typedef struct bsf_pcf_bindings_batch_s bsf_pcf_bindings_batch_t;
+
+typedef struct bsf_pcf_bindings_batch_lookup_s {
+    bsf_pcf_bindings_batch_t *batch;
+    size_t index;                       /* index of the result this lookup answers */
+} bsf_pcf_bindings_batch_lookup_t;
+
+struct bsf_pcf_bindings_batch_s {
+    ogs_lnode_t node;                   /* in the context's list of batches in progress, must be first */
+    bsf_retrieve_batch_callback_f callback;
+    void *user_data;
+    size_t count;
+    bsf_pcf_binding_result_t *results;  /* results[i].pcf_binding is a counted reference unless a duplicate */
+    size_t *first_index;                /* results[i] is a duplicate of results[first_index[i]] when different */
+    bsf_pcf_bindings_batch_lookup_t *lookups; /* distinct addresses that were not in the cache */
+    size_t lookups_count;
+    size_t next_lookup;                 /* next entry in lookups to send */
+    int in_flight;
+    int max_in_flight;
+    bool issuing;                       /* inside __batch_issue(), answers may arrive synchronously */
+};
+
+static bool __retrieve_pcf_binding(ogs_sockaddr_t *ue_address, bsf_retrieve_callback_f callback, bsf_retrieve_ref_callback_f ref_callback, void *user_data);
+static bsf_client_sess_t *__start_lookup(ogs_sockaddr_t *ue_address);
+static bsf_client_sess_t *__start_identity_lookup(const char *supi, const char *gpsi, const char *dnn, const OpenAPI_snssai_t *snssai);
+static bsf_pcf_binding_t *__cached_pcf_binding(ogs_sockaddr_t *ue_address, const bsf_ue_address_key_t *key, bool *negative);
+static void __batch_issue(bsf_pcf_bindings_batch_t *batch);
+static bool __batch_lookup_answered(bsf_pcf_binding_t *binding, void *data);
+static void __batch_complete(bsf_pcf_bindings_batch_t *batch);
+
 bool _bsf_retrieve_pcf_binding_for_pdu_session(ogs_sockaddr_t *ue_address, bsf_retrieve_callback_f callback, void *user_data)
 {
-    OpenAPI_pcf_binding_t *binding;
+    ogs_debug("_bsf_retrieve_pcf_binding_for_pdu_session(ue_address=%p, callback=%p, user_data=%p)", ue_address, callback, user_data);
+    return __retrieve_pcf_binding(ue_address, callback, NULL, user_data);
+}
+
+bool _bsf_retrieve_pcf_binding_ref_for_pdu_session(ogs_sockaddr_t *ue_address, bsf_retrieve_ref_callback_f callback, void *user_data)
+{
+    ogs_debug("_bsf_retrieve_pcf_binding_ref_for_pdu_session(ue_address=%p, callback=%p, user_data=%p)", ue_address, callback, user_data);
+    return __retrieve_pcf_binding(ue_address, NULL, callback, user_data);
+}
+
+/* Find the PCF for a UE by SUPI or GPSI before its address is known, optionally narrowed to a DNN or a
+ * DNN and S-NSSAI. Answers are cached against the UE address in the binding and indexed by every UE
+ * identity in it, so later lookups by address or any of those identities are answered from the cache.
+ */
+bool _bsf_retrieve_pcf_binding_ref_for_ue_identity(const char *supi, const char *gpsi, const char *dnn, const OpenAPI_snssai_t *snssai,
+                                                   bsf_retrieve_ref_callback_f callback, void *user_data)
+{
+    bsf_pcf_binding_t *binding;
     bsf_client_sess_t *sess;
+    char *identity_key;
+    bool stale = false;
 
-    ogs_assert(ue_address);
+    ogs_debug("_bsf_retrieve_pcf_binding_ref_for_ue_identity(supi=%s, gpsi=%s, dnn=%s, snssai=%p, callback=%p, user_data=%p)",
+              supi, gpsi, dnn, snssai, callback, user_data);
+
+    if (!callback) return false;
+
+    identity_key = supi ? _ue_identity_key_new("supi", supi, dnn, snssai) : _ue_identity_key_new("gpsi", gpsi, dnn, snssai);
+    if (!identity_key) {
+        ogs_error("PCF binding lookup needs a SUPI or GPSI, and a DNN to go with an S-NSSAI");
+        return false;
+    }
 
-    ogs_debug("_bsf_retrieve_pcf_binding_for_pdu_session(ue_address=%p, callback=%p, user_data=%p)", ue_address, callback, user_data);
     /* Check the cache */
-    binding = _bsf_client_pcf_bindings_from_cache(ue_address);
+    binding = _bsf_client_pcf_bindings_from_cache_by_identity(identity_key, &stale);
     if (binding) {
-        OpenAPI_pcf_binding_t *bind_copy;
+        if (stale && !_bsf_client_context_pending_identity_lookups_find(identity_key)) {
+            ogs_debug("Revalidating stale PCF binding");
+            __start_identity_lookup(supi, gpsi, dnn, snssai);
+        }
+        ogs_free(identity_key);
+        _bsf_client_retrieve_callback_deliver(NULL, callback, user_data, binding);
+        return true;
+    }
 
-        bind_copy = OpenAPI_pcf_binding_copy(NULL, binding);
-        if (!callback(bind_copy, user_data)) {
-            ogs_error("BSF client callback failed");
-            OpenAPI_pcf_binding_free(bind_copy);
+    /* Join a request already in flight for this UE identity */
+    sess = _bsf_client_context_pending_identity_lookups_find(identity_key);
+    ogs_free(identity_key);
+    if (sess) {
+        ogs_debug("Joining pending BSF lookup %p", sess);
+        _bsf_client_sess_retrieve_callback_add(sess, NULL, callback, user_data);
+        return true;
+    }
+
+    /* Send the request */
+    sess = __start_identity_lookup(supi, gpsi, dnn, snssai);
+    if (!sess) return false;
+
+    _bsf_client_sess_retrieve_callback_add(sess, NULL, callback, user_data);
+
+    return true;
+}
+
+/* Resolve many UE addresses with a single completion callback. Duplicate addresses are resolved
+ * once, cached answers are taken immediately and the rest are sent to the BSF with at most
+ * batchMaxInFlight requests outstanding at a time.
+ */
+bool _bsf_retrieve_pcf_bindings(ogs_sockaddr_t * const *ue_addresses, size_t count, bsf_retrieve_batch_callback_f callback, void *user_data)
+{
+    bsf_pcf_bindings_batch_t *batch;
+    bsf_ue_address_key_t *keys;
+    ogs_hash_t *seen;
+    size_t i;
+
+    ogs_debug("_bsf_retrieve_pcf_bindings(ue_addresses=%p, count=%zu, callback=%p, user_data=%p)", ue_addresses, count, callback, user_data);
+
+    if (!callback) return false;
+    if (count && !ue_addresses) return false;
+
+    batch = ogs_calloc(1, sizeof(*batch));
+    ogs_assert(batch);
+    batch->callback = callback;
+    batch->user_data = user_data;
+    batch->count = count;
+    batch->max_in_flight = _bsf_client_context_get_batch_max_in_flight();
+    if (count) {
+        batch->results = ogs_calloc(count, sizeof(batch->results[0]));
+        ogs_assert(batch->results);
+        batch->first_index = ogs_calloc(count, sizeof(batch->first_index[0]));
+        ogs_assert(batch->first_index);
+        batch->lookups = ogs_calloc(count, sizeof(batch->lookups[0]));
+        ogs_assert(batch->lookups);
+    }
+
+    keys = count ? ogs_calloc(count, sizeof(keys[0])) : NULL;
+    seen = ogs_hash_make();
+    ogs_assert(seen);
+
+    for (i = 0; i < count; i++) {
+        size_t *first;
+        bool negative = false;
+
+        batch->first_index[i] = i;
+        if (!ue_addresses[i]) continue;
+
+        /* the caller's addresses may be gone before the batch completes, so don't keep their pointers */
+        memcpy(&batch->results[i].ue_address, ue_addresses[i], sizeof(batch->results[i].ue_address));
+        batch->results[i].ue_address.next = NULL;
+        batch->results[i].ue_address.hostname = NULL;
+
+        if (!_ue_address_key_from_sockaddr(&keys[i], ue_addresses[i])) continue;
+
+        first = ogs_hash_get(seen, &keys[i], sizeof(keys[i]));
+        if (first) {
+            batch->first_index[i] = *first;
+            continue;
         }
+        ogs_hash_set(seen, &keys[i], sizeof(keys[i]), &batch->first_index[i]);
+
+        batch->results[i].pcf_binding = _bsf_pcf_binding_ref(__cached_pcf_binding(&batch->results[i].ue_address, &keys[i], &negative));
+        if (batch->results[i].pcf_binding || negative) continue;
+
+        batch->lookups[batch->lookups_count].batch = batch;
+        batch->lookups[batch->lookups_count].index = i;
+        batch->lookups_count++;
+    }
+
+    ogs_hash_destroy(seen);
+    if (keys) ogs_free(keys);
+
+    ogs_debug("Batch of %zu addresses needs %zu BSF lookups", count, batch->lookups_count);
+
+    _bsf_client_context_pcf_bindings_batches_add(&batch->node);
+    __batch_issue(batch);
+
+    return true;
+}
+
+/* The library is terminating, complete every batch still waiting for lookups. Addresses that were not
+ * answered get no binding.
+ */
+void _bsf_retrieve_pcf_bindings_abort_all(void)
+{
+    bsf_client_context_t *context = _bsf_client_self();
+    bsf_pcf_bindings_batch_t *batch;
+
+    if (!context) return;
+
+    /* a callback may start another batch, so take them from the front until none are left */
+    while ((batch = ogs_list_first(&context->pcf_bindings_batches)) != NULL) {
+        ogs_warn("Terminating with %i BSF lookups of a batch of %zu addresses unanswered",
+                 batch->in_flight + (int)(batch->lookups_count - batch->next_lookup), batch->count);
+        batch->next_lookup = batch->lookups_count;
+        batch->in_flight = 0;
+        __batch_complete(batch);
+    }
+}
+
+/*** Private functions ***/
+
+static bool __retrieve_pcf_binding(ogs_sockaddr_t *ue_address, bsf_retrieve_callback_f callback, bsf_retrieve_ref_callback_f ref_callback, void *user_data)
+{
+    bsf_pcf_binding_t *binding;
+    bsf_client_sess_t *sess;
+    bsf_ue_address_key_t key;
+    bool negative = false;
+
+    ogs_assert(ue_address);
+
+    if (!_ue_address_key_from_sockaddr(&key, ue_address)) {
+        ogs_error("Unsupported UE address family %i", ue_address->ogs_sa_family);
+        return false;
+    }
+
+    /* Check the cache */
+    binding = __cached_pcf_binding(ue_address, &key, &negative);
+    if (binding || negative) {
+        /* negative: the BSF recently told us there is no binding for this UE */
+        _bsf_client_retrieve_callback_deliver(callback, ref_callback, user_data, binding);
+        return true;
+    }
+
+    /* Join a request already in flight for this UE address */
+    sess = _bsf_client_context_pending_lookups_find(&key);
+    if (sess) {
+        ogs_debug("Joining pending BSF lookup %p", sess);
+        _bsf_client_sess_retrieve_callback_add(sess, callback, ref_callback, user_data);
         return true;
     }
 
     /* Send the request */
+    sess = __start_lookup(ue_address);
+    if (!sess) return false;
+
+    _bsf_client_sess_retrieve_callback_add(sess, callback, ref_callback, user_data);
+
+    return true;
+}
+
+/* Start a BSF lookup, the answer will be cached and given to any callbacks added to the session */
+static bsf_client_sess_t *__start_lookup(ogs_sockaddr_t *ue_address)
+{
+    bsf_client_sess_t *sess;
+
     sess = _bsf_client_sess_new();
-    ogs_assert(sess);
+    if (!sess) return NULL;
 
     _bsf_client_sess_ue_address_set(sess, ue_address);
     if (ue_address->ogs_sa_family == AF_INET) {
@@ -52,15 +268,104 @@ bool _bsf_retrieve_pcf_binding_for_pdu_session(ogs_sockaddr_t *ue_address, bsf_r
     } else {
         ogs_assert_if_reached();
     }
-    _bsf_client_sess_retrieve_callback_set(sess, callback, user_data);
+    _bsf_client_context_pending_lookups_add(sess);
+
+    _bsf_client_context_log_debug();
+
+    _bsf_client_local_discover_and_send(sess);
+
+    return sess;
+}
+
+static bsf_client_sess_t *__start_identity_lookup(const char *supi, const char *gpsi, const char *dnn, const OpenAPI_snssai_t *snssai)
+{
+    bsf_client_sess_t *sess;
+
+    sess = _bsf_client_sess_new();
+    if (!sess) return NULL;
+
+    if (!_bsf_client_sess_ue_identity_set(sess, supi, gpsi, dnn, snssai)) {
+        _bsf_client_sess_free(sess);
+        return NULL;
+    }
+    _bsf_client_context_pending_lookups_add(sess);
 
     _bsf_client_context_log_debug();
 
     _bsf_client_local_discover_and_send(sess);
 
+    return sess;
+}
+
+/* Look in the cache, starting a background refresh for a stale-while-revalidate answer */
+static bsf_pcf_binding_t *__cached_pcf_binding(ogs_sockaddr_t *ue_address, const bsf_ue_address_key_t *key, bool *negative)
+{
+    bsf_pcf_binding_t *binding;
+    bool stale = false;
+
+    binding = _bsf_client_pcf_bindings_from_cache(key, &stale, negative);
+
+    if (binding && stale && !_bsf_client_context_pending_lookups_find(key)) {
+        ogs_debug("Revalidating stale PCF binding");
+        __start_lookup(ue_address);
+    }
+
+    return binding;
+}
+
+static void __batch_issue(bsf_pcf_bindings_batch_t *batch)
+{
+    batch->issuing = true;
+    while (batch->in_flight < batch->max_in_flight && batch->next_lookup < batch->lookups_count) {
+        bsf_pcf_bindings_batch_lookup_t *lookup = &batch->lookups[batch->next_lookup++];
+
+        batch->in_flight++;
+        if (!__retrieve_pcf_binding(&batch->results[lookup->index].ue_address, NULL, __batch_lookup_answered, lookup)) {
+            batch->in_flight--;
+        }
+    }
+    batch->issuing = false;
+
+    if (batch->in_flight == 0 && batch->next_lookup == batch->lookups_count) __batch_complete(batch);
+}
+
+static bool __batch_lookup_answered(bsf_pcf_binding_t *binding, void *data)
+{
+    bsf_pcf_bindings_batch_lookup_t *lookup = (bsf_pcf_bindings_batch_lookup_t*)data;
+    bsf_pcf_bindings_batch_t *batch = lookup->batch;
+
+    /* keep the reference we were given */
+    batch->results[lookup->index].pcf_binding = binding;
+    batch->in_flight--;
+
+    if (!batch->issuing) __batch_issue(batch);
+
     return true;
 }
 
+static void __batch_complete(bsf_pcf_bindings_batch_t *batch)
+{
+    size_t i;
+
+    for (i = 0; i < batch->count; i++) {
+        if (batch->first_index[i] != i)
+            batch->results[i].pcf_binding = batch->results[batch->first_index[i]].pcf_binding;
+    }
+
+    _bsf_client_context_pcf_bindings_batches_remove(&batch->node);
+
+    batch->callback(batch->results, batch->count, batch->user_data);
+
+    for (i = 0; i < batch->count; i++) {
+        if (batch->first_index[i] == i) _bsf_pcf_binding_unref(batch->results[i].pcf_binding);
+    }
+
+    if (batch->results) ogs_free(batch->results);
+    if (batch->first_index) ogs_free(batch->first_index);
+    if (batch->lookups) ogs_free(batch->lookups);
+    ogs_free(batch);
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -17,6 +17,11 @@ extern "C" {
 #endif
 
 bool _bsf_retrieve_pcf_binding_for_pdu_session(ogs_sockaddr_t *ue_address, bsf_retrieve_callback_f callback, void *user_data);
+bool _bsf_retrieve_pcf_binding_ref_for_pdu_session(ogs_sockaddr_t *ue_address, bsf_retrieve_ref_callback_f callback, void *user_data);
+bool _bsf_retrieve_pcf_binding_ref_for_ue_identity(const char *supi, const char *gpsi, const char *dnn, const OpenAPI_snssai_t *snssai,
+                                                   bsf_retrieve_ref_callback_f callback, void *user_data);
+bool _bsf_retrieve_pcf_bindings(ogs_sockaddr_t * const *ue_addresses, size_t count, bsf_retrieve_batch_callback_f callback, void *user_data);
+void _bsf_retrieve_pcf_bindings_abort_all(void);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,75 @@
+/*
+License: 5G-MAG Public License (v1.0)
+Copyright: (C) 2023 British Broadcasting Corporation
+
+For full license terms please see the LICENSE file distributed with this
+program. If this file is missing then the license can be retrieved from
+https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
+*/
+
+#ifndef BSF_CLIENT_PCF_BINDING_REF_H
+#define BSF_CLIENT_PCF_BINDING_REF_H
+
+#include "ogs-core.h"
+#include "ogs-sbi.h"
+
+#include "bsf-service-consumer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Immutable, reference counted PCF binding shared between the cache and callbacks */
+struct bsf_pcf_binding_s {
+    size_t ref_count;
+    OpenAPI_pcf_binding_t *pcf_binding;
+};
+
+/* Library Internals */
+
+/* Takes ownership of pcf_binding, returned object has a reference count of 1 */
+static inline bsf_pcf_binding_t *_bsf_pcf_binding_new(OpenAPI_pcf_binding_t *pcf_binding)
+{
+    bsf_pcf_binding_t *binding;
+
+    if (!pcf_binding) return NULL;
+
+    binding = (bsf_pcf_binding_t*)ogs_calloc(1, sizeof(*binding));
+    ogs_assert(binding);
+    binding->ref_count = 1;
+    binding->pcf_binding = pcf_binding;
+
+    return binding;
+}
+
+static inline bsf_pcf_binding_t *_bsf_pcf_binding_ref(bsf_pcf_binding_t *binding)
+{
+    if (binding) binding->ref_count++;
+    return binding;
+}
+
+static inline void _bsf_pcf_binding_unref(bsf_pcf_binding_t *binding)
+{
+    if (binding) {
+        binding->ref_count--;
+        if (!binding->ref_count) {
+            OpenAPI_pcf_binding_free(binding->pcf_binding);
+            ogs_free(binding);
+        }
+    }
+}
+
+static inline const OpenAPI_pcf_binding_t *_bsf_pcf_binding_get(const bsf_pcf_binding_t *binding)
+{
+    if (!binding) return NULL;
+    return binding->pcf_binding;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+/* vim:ts=8:sts=4:sw=4:expandtab:
+ */
+
+#endif /* BSF_CLIENT_PCF_BINDING_REF_H */
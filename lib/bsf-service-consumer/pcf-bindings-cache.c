@@ -7,10 +7,12 @@
  * https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
  */
 
+#include "ogs-app.h"
 #include "ogs-core.h"
 #include "ogs-sbi.h"
 
 #include "log.h"
+#include "pcf-binding-ref.h"
 #include "utils.h"
 
 #include "pcf-bindings-cache.h"
@@ -19,106 +21,1002 @@
 extern "C" {
 #endif
 
+#define EXPIRY_HEAP_INITIAL_CAPACITY 64
+
+/* Snapshot file: the magic and version, then one record per entry, the bindings then the negative
+ * entries, each most recently used first:
+ *   bsf_ue_address_key_t key, uint8_t negative, int64_t expires, stale_until, stale_if_error_until,
+ *   uint8_t etag length, etag (length bytes), uint32_t binding length,
+ *   PcfBinding JSON (length bytes, none for a negative entry)
+ * Values are in host byte order, a snapshot is only meant to be reloaded on the same host.
+ */
+#define SNAPSHOT_MAGIC "BSFC"
+#define SNAPSHOT_VERSION 3
+#define SNAPSHOT_MAX_BINDING_LENGTH (1024*1024)
+
+static pcf_bindings_cache_entry_t *__entry_find(pcf_bindings_cache_t *cache, const bsf_ue_address_key_t *ue_address, bool if_error);
+static pcf_bindings_cache_entry_t *__identity_entry_find(pcf_bindings_cache_t *cache, const char *identity_key, bool if_error);
+static ogs_time_t __entry_usable_until(const pcf_bindings_cache_entry_t *entry, bool if_error);
+static void __entry_remove(pcf_bindings_cache_t *cache, pcf_bindings_cache_entry_t *entry);
+static void __entry_binding_added(pcf_bindings_cache_t *cache, pcf_bindings_cache_entry_t *entry);
+static void __entry_binding_removed(pcf_bindings_cache_t *cache, pcf_bindings_cache_entry_t *entry);
+static void __identity_index_add(pcf_bindings_cache_t *cache, pcf_bindings_cache_entry_t *entry, int idx);
+static void __identity_index_remove(pcf_bindings_cache_t *cache, pcf_bindings_cache_identity_ref_t *ref);
+static bool __entry_set(pcf_bindings_cache_t *cache, const bsf_ue_address_key_t *key, bsf_pcf_binding_t *binding, const bsf_cache_lifetime_t *lifetime);
+static ogs_list_t *__entry_lru(pcf_bindings_cache_t *cache, const pcf_bindings_cache_entry_t *entry);
+static int *__entry_lru_count(pcf_bindings_cache_t *cache, const pcf_bindings_cache_entry_t *entry);
+static void __lru_prepend(pcf_bindings_cache_t *cache, pcf_bindings_cache_entry_t *entry);
+static void __lru_remove(pcf_bindings_cache_t *cache, pcf_bindings_cache_entry_t *entry);
+static void __evict_lru(pcf_bindings_cache_t *cache, ogs_list_t *lru, const int *count, int max_entries);
+static int  __invalidate_longer_prefixes(pcf_bindings_cache_t *cache, ogs_list_t *lru, const bsf_ue_address_key_t *prefix);
+static void __expiry_heap_push(pcf_bindings_cache_t *cache, pcf_bindings_cache_entry_t *entry);
+static void __expiry_heap_remove(pcf_bindings_cache_t *cache, pcf_bindings_cache_entry_t *entry);
+static void __expiry_heap_update(pcf_bindings_cache_t *cache, pcf_bindings_cache_entry_t *entry);
+static void __expiry_heap_swap(pcf_bindings_cache_t *cache, int a, int b);
+static int  __expiry_heap_sift_up(pcf_bindings_cache_t *cache, int idx);
+static int  __expiry_heap_sift_down(pcf_bindings_cache_t *cache, int idx);
+static void __expiry_timer_rearm(pcf_bindings_cache_t *cache);
+static void __expiry_timer_expired(void *data);
+static bool __snapshot_write_list(FILE *fp, ogs_list_t *lru, int *count);
+static bool __snapshot_write_entry(FILE *fp, const pcf_bindings_cache_entry_t *entry);
+static bool __snapshot_read_entry(FILE *fp, bsf_ue_address_key_t *key, bool *negative, bsf_cache_lifetime_t *lifetime, char **binding_json);
+static bool __snapshot_list_full(pcf_bindings_cache_t *cache, bool negative);
+static void __snapshot_entry_loaded(pcf_bindings_cache_t *cache, const bsf_ue_address_key_t *key);
+
 /* Library Internals */
-void _pcf_bindings_cache_init(ogs_hash_t **cache)
+void _pcf_bindings_cache_init(pcf_bindings_cache_t **cache, int max_entries, int max_negative_entries)
 {
-    *cache = ogs_hash_make();
+    pcf_bindings_cache_t *new_cache;
+
+    new_cache = ogs_calloc(1, sizeof(*new_cache));
+    ogs_assert(new_cache);
+
+    new_cache->entries = ogs_hash_make();
+    ogs_assert(new_cache->entries);
+    new_cache->identities = ogs_hash_make();
+    ogs_assert(new_cache->identities);
+    ogs_list_init(&new_cache->lru);
+    new_cache->lru_count = 0;
+
+    new_cache->expiry_heap_capacity = EXPIRY_HEAP_INITIAL_CAPACITY;
+    new_cache->expiry_heap = ogs_calloc(new_cache->expiry_heap_capacity, sizeof(new_cache->expiry_heap[0]));
+    ogs_assert(new_cache->expiry_heap);
+    new_cache->expiry_heap_size = 0;
+
+    new_cache->max_entries = max_entries;
+    ogs_list_init(&new_cache->negative_lru);
+    new_cache->negative_lru_count = 0;
+    new_cache->max_negative_entries = max_negative_entries;
+
+    new_cache->expiry_timer = ogs_timer_add(ogs_app()->timer_mgr, __expiry_timer_expired, new_cache);
+    ogs_assert(new_cache->expiry_timer);
+
+    *cache = new_cache;
 }
 
-void _pcf_bindings_cache_clear(ogs_hash_t **cache)
+void _pcf_bindings_cache_clear(pcf_bindings_cache_t **cache)
 {
-    ogs_hash_index_t *idx;
+    pcf_bindings_cache_entry_t *entry, *next;
 
     if (!cache || !*cache) return;
 
-    for (idx = ogs_hash_first(*cache); idx ; idx = ogs_hash_next(idx)) {
-        const void *key;
-        int key_len;
-        pcf_bindings_cache_t *value;
-
-        ogs_hash_this(idx, &key, &key_len, (void**)&value);
-        ogs_hash_set(*cache, key, key_len, NULL);
-        OpenAPI_pcf_binding_free(value->pcf_binding);
-        ogs_free(value);
+    ogs_list_for_each_safe(&(*cache)->lru, next, entry) {
+        __entry_remove(*cache, entry);
+    }
+    ogs_list_for_each_safe(&(*cache)->negative_lru, next, entry) {
+        __entry_remove(*cache, entry);
     }
 
-    ogs_hash_destroy(*cache);
+    ogs_timer_delete((*cache)->expiry_timer);
+    ogs_free((*cache)->expiry_heap);
+    ogs_hash_destroy((*cache)->identities);
+    ogs_hash_destroy((*cache)->entries);
+    ogs_free(*cache);
     *cache = NULL;
 }
 
-void _pcf_bindings_cache_log_debug(ogs_hash_t *cache, int indent)
+void _pcf_bindings_cache_set_max_entries(pcf_bindings_cache_t *cache, int max_entries)
+{
+    if (!cache) return;
+
+    cache->max_entries = max_entries;
+    if (max_entries > 0) __evict_lru(cache, &cache->lru, &cache->lru_count, max_entries);
+}
+
+void _pcf_bindings_cache_set_max_negative_entries(pcf_bindings_cache_t *cache, int max_negative_entries)
+{
+    if (!cache) return;
+
+    cache->max_negative_entries = max_negative_entries;
+    if (max_negative_entries > 0) __evict_lru(cache, &cache->negative_lru, &cache->negative_lru_count, max_negative_entries);
+}
+
+void _pcf_bindings_cache_set_binding_listener(pcf_bindings_cache_t *cache, pcf_bindings_cache_binding_listener_f added,
+                                              pcf_bindings_cache_binding_listener_f removed, void *data)
+{
+    if (!cache) return;
+
+    cache->binding_added = added;
+    cache->binding_removed = removed;
+    cache->listener_data = data;
+}
+
+void _pcf_bindings_cache_log_debug(pcf_bindings_cache_t *cache, int indent)
 {
-    ogs_hash_index_t *idx;
+    pcf_bindings_cache_entry_t *entry;
 
-    ogs_debug("%*sBindings Cache:", indent, "");
-    for (idx = ogs_hash_first(cache); idx ; idx = ogs_hash_next(idx)) {
-        const ogs_sockaddr_t *key;
-        int key_len;
-        pcf_bindings_cache_t *value;
+    if (!cache) return;
+
+    ogs_debug("%*sBindings Cache (%i entries, max %i, %u identity keys):", indent, "", cache->lru_count, cache->max_entries,
+              ogs_hash_count(cache->identities));
+    ogs_list_for_each(&cache->lru, entry) {
         char *ue_addr;
         char *json_txt;
         cJSON *json;
         char *expires;
+        char *remove_at;
 
-        ogs_hash_this(idx, (const void**)&key, &key_len, (void**)&value);
-        ogs_assert(key_len == sizeof(ogs_sockaddr_t));
-        ue_addr = _sockaddr_string(key);
-        json = OpenAPI_pcf_binding_convertToJSON(value->pcf_binding);
+        ue_addr = _ue_address_key_string(&entry->key);
+        json = OpenAPI_pcf_binding_convertToJSON((OpenAPI_pcf_binding_t*)_bsf_pcf_binding_get(entry->pcf_binding));
         json_txt = cJSON_Print(json);
         cJSON_Delete(json);
-        expires = _time_string(value->expires);
+        expires = _time_string(entry->lifetime.expires);
+        remove_at = _time_string(entry->remove_at);
 
-        ogs_debug("%*s%s [%s] = %s", indent+2, "", ue_addr, expires, json_txt);
+        ogs_debug("%*s%s [%s, stale until %s] = %s", indent+2, "", ue_addr, expires, remove_at, json_txt);
 
         ogs_free(ue_addr);
         ogs_free(json_txt);
         ogs_free(expires);
+        ogs_free(remove_at);
+    }
+
+    ogs_debug("%*sNo binding entries (%i entries, max %i):", indent, "", cache->negative_lru_count, cache->max_negative_entries);
+    ogs_list_for_each(&cache->negative_lru, entry) {
+        char *ue_addr;
+        char *expires;
+
+        ue_addr = _ue_address_key_string(&entry->key);
+        expires = _time_string(entry->lifetime.expires);
+
+        ogs_debug("%*s%s [%s]", indent+2, "", ue_addr, expires);
+
+        ogs_free(ue_addr);
+        ogs_free(expires);
+    }
+}
+
+/* Returns a fresh binding, or a stale one that may still be used while it is revalidated in which
+ * case *stale is set to true. If the BSF recently said there is no binding then NULL is returned and
+ * *negative is set to true.
+ */
+bsf_pcf_binding_t *_pcf_bindings_cache_find(pcf_bindings_cache_t *cache, const bsf_ue_address_key_t *ue_address, bool *stale, bool *negative)
+{
+    pcf_bindings_cache_entry_t *entry;
+    ogs_list_t *lru;
+
+    if (stale) *stale = false;
+    if (negative) *negative = false;
+    if (!cache || !ue_address) return NULL;
+
+    entry = __entry_find(cache, ue_address, false);
+
+    /* not found */
+    if (!entry) return NULL;
+
+    /* found, mark as most recently used */
+    lru = __entry_lru(cache, entry);
+    ogs_list_remove(lru, entry);
+    ogs_list_prepend(lru, entry);
+
+    if (negative) *negative = (entry->pcf_binding == NULL);
+
+    if (stale) *stale = (entry->lifetime.expires < ogs_time_now());
+
+    return entry->pcf_binding;
+}
+
+/* Returns a binding that may be used because the BSF could not be asked for a fresh one */
+bsf_pcf_binding_t *_pcf_bindings_cache_find_stale_if_error(pcf_bindings_cache_t *cache, const bsf_ue_address_key_t *ue_address)
+{
+    pcf_bindings_cache_entry_t *entry;
+
+    if (!cache || !ue_address) return NULL;
+
+    entry = __entry_find(cache, ue_address, true);
+    if (!entry) return NULL;
+
+    return entry->pcf_binding;
+}
+
+/* As _pcf_bindings_cache_find() but for the latest binding cached for a UE identity key, no negative
+ * answers are kept for these.
+ */
+bsf_pcf_binding_t *_pcf_bindings_cache_find_by_identity(pcf_bindings_cache_t *cache, const char *identity_key, bool *stale)
+{
+    pcf_bindings_cache_entry_t *entry;
+
+    if (stale) *stale = false;
+    if (!cache || !identity_key) return NULL;
+
+    entry = __identity_entry_find(cache, identity_key, false);
+    if (!entry) return NULL;
+
+    ogs_list_remove(&cache->lru, entry);
+    ogs_list_prepend(&cache->lru, entry);
+
+    if (stale) *stale = (entry->lifetime.expires < ogs_time_now());
+
+    return entry->pcf_binding;
+}
+
+bsf_pcf_binding_t *_pcf_bindings_cache_find_by_identity_stale_if_error(pcf_bindings_cache_t *cache, const char *identity_key)
+{
+    pcf_bindings_cache_entry_t *entry;
+
+    if (!cache || !identity_key) return NULL;
+
+    entry = __identity_entry_find(cache, identity_key, true);
+    if (!entry) return NULL;
+
+    return entry->pcf_binding;
+}
+
+/* The validator of the binding that a lookup for ue_address would revalidate, NULL if there isn't one */
+const char *_pcf_bindings_cache_find_etag(pcf_bindings_cache_t *cache, const bsf_ue_address_key_t *ue_address)
+{
+    pcf_bindings_cache_entry_t *entry;
+
+    if (!cache || !ue_address) return NULL;
+
+    entry = __entry_find(cache, ue_address, true);
+    if (!entry || !entry->lifetime.etag[0]) return NULL;
+
+    return entry->lifetime.etag;
+}
+
+/* The BSF said our binding for ue_address is still current (304), give it the new lifetime */
+bsf_pcf_binding_t *_pcf_bindings_cache_revalidated(pcf_bindings_cache_t *cache, const bsf_ue_address_key_t *ue_address, const bsf_cache_lifetime_t *lifetime)
+{
+    pcf_bindings_cache_entry_t *entry;
+    bsf_cache_lifetime_t new_lifetime;
+    bsf_ue_address_key_t key;
+
+    if (!cache || !ue_address || !lifetime) return NULL;
+
+    entry = __entry_find(cache, ue_address, true);
+    if (!entry || !entry->pcf_binding) return NULL;
+
+    new_lifetime = *lifetime;
+    if (!new_lifetime.etag[0]) memcpy(new_lifetime.etag, entry->lifetime.etag, sizeof(new_lifetime.etag));
+
+    /* the entry goes if the new lifetime makes it uncacheable */
+    memcpy(&key, &entry->key, sizeof(key));
+    if (!__entry_set(cache, &key, entry->pcf_binding, &new_lifetime)) return NULL;
+
+    return entry->pcf_binding;
+}
+
+bool _pcf_bindings_cache_add(pcf_bindings_cache_t *cache, const bsf_ue_address_key_t *key, bsf_pcf_binding_t *binding, const bsf_cache_lifetime_t *lifetime)
+{
+    if (!cache || !key || !binding || !lifetime) return false;
+
+    return __entry_set(cache, key, binding, lifetime);
+}
+
+/* Also index the binding cached at key by the identity key it was looked up with, in case the BSF
+ * didn't echo that identity back in the binding.
+ */
+bool _pcf_bindings_cache_add_identity(pcf_bindings_cache_t *cache, const bsf_ue_address_key_t *key, const char *identity_key)
+{
+    pcf_bindings_cache_entry_t *entry;
+    int i;
+
+    if (!cache || !key || !identity_key) return false;
+
+    entry = ogs_hash_get(cache->entries, key, sizeof(*key));
+    if (!entry || !entry->pcf_binding) return false;
+
+    for (i = 0; i < entry->identity_keys_count; i++) {
+        if (!strcmp(entry->identity_keys[i], identity_key)) return true;
+    }
+    if (entry->identity_keys_count == OGS_ARRAY_SIZE(entry->identity_keys)) return false;
+
+    entry->identity_keys[entry->identity_keys_count] = ogs_strdup(identity_key);
+    ogs_assert(entry->identity_keys[entry->identity_keys_count]);
+    __identity_index_add(cache, entry, entry->identity_keys_count++);
+
+    return true;
+}
+
+/* Remember that the BSF has no binding for key until expires, negative entries are never served stale */
+bool _pcf_bindings_cache_add_negative(pcf_bindings_cache_t *cache, const bsf_ue_address_key_t *key, ogs_time_t expires)
+{
+    bsf_cache_lifetime_t lifetime;
+
+    if (!cache || !key) return false;
+
+    lifetime.expires = expires;
+    lifetime.stale_until = expires;
+    lifetime.stale_if_error_until = expires;
+    lifetime.etag[0] = '\0';
+
+    return __entry_set(cache, key, NULL, &lifetime);
+}
+
+/* Drop the entry for key, any entries for shorter IPv6 prefixes that contain it and any entries for
+ * longer IPv6 prefixes or addresses inside it, positive or negative, so that the next lookup for an
+ * address in key goes to the BSF.
+ */
+int _pcf_bindings_cache_invalidate(pcf_bindings_cache_t *cache, const bsf_ue_address_key_t *key)
+{
+    pcf_bindings_cache_entry_t *entry;
+    bsf_ue_address_key_t probe;
+    int prefix_len;
+    int count = 0;
+
+    if (!cache || !key) return 0;
+
+    memcpy(&probe, key, sizeof(probe));
+    for (prefix_len = key->prefix_len; prefix_len >= 0; prefix_len--) {
+        if (probe.family == AF_INET6) {
+            if (!cache->ipv6_prefix_entries[prefix_len]) continue;
+            _ue_address_key_set_prefix_len(&probe, prefix_len);
+        }
+        entry = ogs_hash_get(cache->entries, &probe, sizeof(probe));
+        if (entry) {
+            __entry_remove(cache, entry);
+            count++;
+        }
+        if (probe.family != AF_INET6) break;
+    }
+
+    /* longer prefixes can't be probed for, so walk the entries if there are any */
+    if (key->family == AF_INET6) {
+        for (prefix_len = key->prefix_len + 1; prefix_len <= 128; prefix_len++) {
+            if (cache->ipv6_prefix_entries[prefix_len]) break;
+        }
+        if (prefix_len <= 128) {
+            count += __invalidate_longer_prefixes(cache, &cache->lru, key);
+            count += __invalidate_longer_prefixes(cache, &cache->negative_lru, key);
+        }
+    }
+
+    if (count) {
+        ogs_debug("Invalidated %i PCF binding cache entries", count);
+        __expiry_timer_rearm(cache);
+    }
+
+    return count;
+}
+
+int _pcf_bindings_cache_expire(pcf_bindings_cache_t *cache, ogs_time_t now)
+{
+    int count = 0;
+
+    if (!cache) return 0;
+
+    while (cache->expiry_heap_size > 0 && cache->expiry_heap[0]->remove_at < now) {
+        __entry_remove(cache, cache->expiry_heap[0]);
+        count++;
+    }
+
+    if (count) ogs_debug("Expired %i PCF binding cache entries", count);
+
+    __expiry_timer_rearm(cache);
+
+    return count;
+}
+
+/* Write the cache contents to filename, via a temporary file so a reader never sees half a snapshot */
+bool _pcf_bindings_cache_snapshot_save(pcf_bindings_cache_t *cache, const char *filename)
+{
+    char *tmp_filename;
+    FILE *fp;
+    uint32_t version = SNAPSHOT_VERSION;
+    int count = 0;
+    bool ok;
+
+    if (!cache || !filename) return false;
+
+    tmp_filename = ogs_msprintf("%s.tmp", filename);
+    ogs_assert(tmp_filename);
+
+    fp = fopen(tmp_filename, "wb");
+    if (!fp) {
+        ogs_error("Unable to write PCF binding cache snapshot %s: %s", tmp_filename, strerror(errno));
+        ogs_free(tmp_filename);
+        return false;
+    }
+
+    ok = fwrite(SNAPSHOT_MAGIC, 4, 1, fp) == 1 && fwrite(&version, sizeof(version), 1, fp) == 1;
+    /* bindings first so that a truncated snapshot loses the negative entries, the least useful answers */
+    ok = ok && __snapshot_write_list(fp, &cache->lru, &count);
+    ok = ok && __snapshot_write_list(fp, &cache->negative_lru, &count);
+    if (fclose(fp) != 0) ok = false;
+    if (ok && rename(tmp_filename, filename) != 0) ok = false;
+
+    if (ok) {
+        ogs_debug("Saved %i PCF binding cache entries to %s", count, filename);
+    } else {
+        ogs_error("Failed to write PCF binding cache snapshot %s: %s", filename, strerror(errno));
+        remove(tmp_filename);
     }
+
+    ogs_free(tmp_filename);
+
+    return ok;
 }
 
-OpenAPI_pcf_binding_t *_pcf_bindings_cache_find(ogs_hash_t *cache, const ogs_sockaddr_t *ue_address)
+/* Reload a snapshot written by _pcf_bindings_cache_snapshot_save(), entries that are no longer fresh,
+ * or that don't fit in the cache, are dropped. Returns the number of entries loaded.
+ */
+int _pcf_bindings_cache_snapshot_load(pcf_bindings_cache_t *cache, const char *filename)
 {
-    pcf_bindings_cache_t *value;
+    FILE *fp;
+    char magic[4];
+    uint32_t version;
     ogs_time_t now;
+    int count = 0;
+    int discarded = 0;
+
+    if (!cache || !filename) return 0;
+
+    fp = fopen(filename, "rb");
+    if (!fp) {
+        if (errno == ENOENT) {
+            ogs_debug("No PCF binding cache snapshot at %s", filename);
+        } else {
+            ogs_warn("Unable to read PCF binding cache snapshot %s: %s", filename, strerror(errno));
+        }
+        return 0;
+    }
+
+    if (fread(magic, sizeof(magic), 1, fp) != 1 || memcmp(magic, SNAPSHOT_MAGIC, sizeof(magic)) ||
+            fread(&version, sizeof(version), 1, fp) != 1 || version != SNAPSHOT_VERSION) {
+        ogs_warn("Ignoring %s, not a PCF binding cache snapshot", filename);
+        fclose(fp);
+        return 0;
+    }
 
     now = ogs_time_now();
-    value = ogs_hash_get(cache, ue_address, sizeof(*ue_address));
+    for (;;) {
+        bsf_ue_address_key_t key;
+        bsf_cache_lifetime_t lifetime;
+        bool negative;
+        char *binding_json = NULL;
 
-    /* not found */
-    if (!value) return NULL;
+        if (!__snapshot_read_entry(fp, &key, &negative, &lifetime, &binding_json)) break;
 
-    /* found, but expired */
-    if (value->expires < now) {
-        OpenAPI_pcf_binding_free(value->pcf_binding);
-        ogs_hash_set(cache, ue_address, sizeof(*ue_address), NULL);
-        ogs_free(value);
-        return NULL;
+        if (lifetime.expires <= now || __snapshot_list_full(cache, negative)) {
+            /* a full list already holds more recently used entries */
+            discarded++;
+        } else if (negative) {
+            if (_pcf_bindings_cache_add_negative(cache, &key, lifetime.expires)) {
+                __snapshot_entry_loaded(cache, &key);
+                count++;
+            }
+        } else {
+            cJSON *json = cJSON_Parse(binding_json);
+            bsf_pcf_binding_t *binding = _bsf_pcf_binding_new(json ? OpenAPI_pcf_binding_parseFromJSON(json) : NULL);
+
+            if (json) cJSON_Delete(json);
+            if (binding) {
+                if (__entry_set(cache, &key, binding, &lifetime)) {
+                    __snapshot_entry_loaded(cache, &key);
+                    count++;
+                }
+                _bsf_pcf_binding_unref(binding);
+            } else {
+                discarded++;
+            }
+        }
+
+        if (binding_json) ogs_free(binding_json);
     }
 
-    /* found and not expired */
-    return value->pcf_binding;
+    fclose(fp);
+
+    ogs_info("Loaded %i PCF binding cache entries from %s (%i expired, unreadable or over the cache size)", count, filename, discarded);
+
+    return count;
 }
 
-bool _pcf_bindings_cache_add(ogs_hash_t *cache, const ogs_sockaddr_t *ue_address, const OpenAPI_pcf_binding_t *bindings, ogs_time_t expires)
+/*** Private functions ***/
+
+/* IPv4 addresses are an exact match on the /32 key. IPv6 addresses are
+ * matched against the longest cached prefix containing them by probing the
+ * hash once for each prefix length that currently has entries.
+ */
+static pcf_bindings_cache_entry_t *__entry_find(pcf_bindings_cache_t *cache, const bsf_ue_address_key_t *ue_address, bool if_error)
 {
-    pcf_bindings_cache_t *value;
+    pcf_bindings_cache_entry_t *entry;
+    bsf_ue_address_key_t key;
+    ogs_time_t now = ogs_time_now();
+    int prefix_len;
+    bool removed = false;
+
+    memcpy(&key, ue_address, sizeof(key));
+    for (prefix_len = ue_address->prefix_len; prefix_len >= 0; prefix_len--) {
+        if (key.family == AF_INET6) {
+            if (!cache->ipv6_prefix_entries[prefix_len]) continue;
+            _ue_address_key_set_prefix_len(&key, prefix_len);
+        }
+        entry = ogs_hash_get(cache->entries, &key, sizeof(key));
+        if (entry) {
+            if (__entry_usable_until(entry, if_error) >= now) {
+                if (removed) __expiry_timer_rearm(cache);
+                return entry;
+            }
+            if (entry->remove_at < now) {
+                /* past all its windows and not yet swept */
+                __entry_remove(cache, entry);
+                removed = true;
+            }
+        }
+        /* IPv4 keys are exact match only, IPv6 may match a shorter prefix */
+        if (key.family != AF_INET6) break;
+    }
+
+    if (removed) __expiry_timer_rearm(cache);
+
+    return NULL;
+}
+
+/* The newest usable entry holding a binding for the UE identity key */
+static pcf_bindings_cache_entry_t *__identity_entry_find(pcf_bindings_cache_t *cache, const char *identity_key, bool if_error)
+{
+    pcf_bindings_cache_identity_t *identity;
+    pcf_bindings_cache_identity_ref_t *ref, *next;
+    ogs_time_t now = ogs_time_now();
+    bool removed = false;
+
+    identity = ogs_hash_get(cache->identities, identity_key, OGS_HASH_KEY_STRING);
+    if (!identity) return NULL;
+
+    /* removing the last entry frees identity, but then next is already NULL */
+    for (ref = ogs_list_first(&identity->refs); ref; ref = next) {
+        pcf_bindings_cache_entry_t *entry = ref->entry;
+
+        next = ogs_list_next(ref);
+        if (__entry_usable_until(entry, if_error) >= now) {
+            if (removed) __expiry_timer_rearm(cache);
+            return entry;
+        }
+        if (entry->remove_at < now) {
+            /* past all its windows and not yet swept */
+            __entry_remove(cache, entry);
+            removed = true;
+        }
+    }
+
+    if (removed) __expiry_timer_rearm(cache);
+
+    return NULL;
+}
+
+static bool __entry_set(pcf_bindings_cache_t *cache, const bsf_ue_address_key_t *key, bsf_pcf_binding_t *binding, const bsf_cache_lifetime_t *lifetime)
+{
+    pcf_bindings_cache_entry_t *entry;
+    ogs_time_t remove_at;
+    ogs_list_t *lru;
+    int *count;
+    int max_entries;
+
+    remove_at = lifetime->stale_until;
+    if (lifetime->stale_if_error_until > remove_at) remove_at = lifetime->stale_if_error_until;
 
     /* check for existing entry and modify, or create */
-    value = ogs_hash_get(cache, ue_address, sizeof(*ue_address));
-    if (value) {
-        value->pcf_binding = OpenAPI_pcf_binding_copy(value->pcf_binding, (OpenAPI_pcf_binding_t*)bindings);
-        value->expires = expires;
+    entry = ogs_hash_get(cache->entries, key, sizeof(*key));
+
+    /* not cacheable (e.g. no-store), drop any older answer too */
+    if (remove_at <= ogs_time_now()) {
+        if (entry) {
+            __entry_remove(cache, entry);
+            __expiry_timer_rearm(cache);
+        }
+        return false;
+    }
+
+    if (binding) {
+        lru = &cache->lru;
+        count = &cache->lru_count;
+        max_entries = cache->max_entries;
+    } else {
+        lru = &cache->negative_lru;
+        count = &cache->negative_lru_count;
+        max_entries = cache->max_negative_entries;
+    }
+
+    if (entry) {
+        /* may move between the positive and negative lists */
+        __lru_remove(cache, entry);
+        if (entry->pcf_binding != binding) {
+            __entry_binding_removed(cache, entry);
+            _bsf_pcf_binding_unref(entry->pcf_binding);
+            entry->pcf_binding = _bsf_pcf_binding_ref(binding);
+            __entry_binding_added(cache, entry);
+        }
+        entry->lifetime = *lifetime;
+        entry->remove_at = remove_at;
+        __expiry_heap_update(cache, entry);
+        __lru_prepend(cache, entry);
+        if (max_entries > 0) __evict_lru(cache, lru, count, max_entries);
     } else {
-        value = ogs_calloc(1, sizeof(*value));
-        ogs_assert(value);
-        value->pcf_binding = OpenAPI_pcf_binding_copy(NULL, (OpenAPI_pcf_binding_t*)bindings);
-        value->expires = expires;
-        ogs_hash_set(cache, ue_address, sizeof(*ue_address), value);
+        /* make room for the new entry */
+        if (max_entries > 0) __evict_lru(cache, lru, count, max_entries - 1);
+
+        entry = ogs_calloc(1, sizeof(*entry));
+        ogs_assert(entry);
+        memcpy(&entry->key, key, sizeof(entry->key));
+        entry->pcf_binding = _bsf_pcf_binding_ref(binding);
+        entry->lifetime = *lifetime;
+        entry->remove_at = remove_at;
+        ogs_hash_set(cache->entries, &entry->key, sizeof(entry->key), entry);
+        if (entry->key.family == AF_INET6) cache->ipv6_prefix_entries[entry->key.prefix_len]++;
+        __lru_prepend(cache, entry);
+        __expiry_heap_push(cache, entry);
+        __entry_binding_added(cache, entry);
     }
 
+    __expiry_timer_rearm(cache);
+
     return true;
 }
 
+static ogs_list_t *__entry_lru(pcf_bindings_cache_t *cache, const pcf_bindings_cache_entry_t *entry)
+{
+    return entry->pcf_binding ? &cache->lru : &cache->negative_lru;
+}
+
+static int *__entry_lru_count(pcf_bindings_cache_t *cache, const pcf_bindings_cache_entry_t *entry)
+{
+    return entry->pcf_binding ? &cache->lru_count : &cache->negative_lru_count;
+}
+
+/* Add entry to the front of its LRU list, keeping the list's entry count */
+static void __lru_prepend(pcf_bindings_cache_t *cache, pcf_bindings_cache_entry_t *entry)
+{
+    ogs_list_prepend(__entry_lru(cache, entry), entry);
+    (*__entry_lru_count(cache, entry))++;
+}
+
+static void __lru_remove(pcf_bindings_cache_t *cache, pcf_bindings_cache_entry_t *entry)
+{
+    ogs_list_remove(__entry_lru(cache, entry), entry);
+    (*__entry_lru_count(cache, entry))--;
+}
+
+static ogs_time_t __entry_usable_until(const pcf_bindings_cache_entry_t *entry, bool if_error)
+{
+    /* a "no binding" answer is no use as a fallback binding */
+    if (if_error && !entry->pcf_binding) return 0;
+    if (if_error) return entry->remove_at;
+    return entry->lifetime.stale_until;
+}
+
+static void __entry_remove(pcf_bindings_cache_t *cache, pcf_bindings_cache_entry_t *entry)
+{
+    ogs_hash_set(cache->entries, &entry->key, sizeof(entry->key), NULL);
+    if (entry->key.family == AF_INET6) cache->ipv6_prefix_entries[entry->key.prefix_len]--;
+    __lru_remove(cache, entry);
+    __expiry_heap_remove(cache, entry);
+    __entry_binding_removed(cache, entry);
+    _bsf_pcf_binding_unref(entry->pcf_binding);
+    ogs_free(entry);
+}
+
+static void __entry_binding_added(pcf_bindings_cache_t *cache, pcf_bindings_cache_entry_t *entry)
+{
+    int i;
+
+    if (!entry->pcf_binding) return;
+
+    /* the newest binding for a UE identity is the one lookups by that identity get first */
+    entry->identity_keys_count = _ue_identity_keys_from_pcf_binding(_bsf_pcf_binding_get(entry->pcf_binding), entry->identity_keys);
+    for (i = 0; i < entry->identity_keys_count; i++) __identity_index_add(cache, entry, i);
+
+    if (cache->binding_added)
+        cache->binding_added(entry->pcf_binding, cache->listener_data);
+}
+
+static void __entry_binding_removed(pcf_bindings_cache_t *cache, pcf_bindings_cache_entry_t *entry)
+{
+    int i;
+
+    if (!entry->pcf_binding) return;
+
+    /* lookups by these identities fall back to any older entries still holding them */
+    for (i = 0; i < entry->identity_keys_count; i++) {
+        __identity_index_remove(cache, entry->identity_refs[i]);
+        entry->identity_refs[i] = NULL;
+        ogs_free(entry->identity_keys[i]);
+        entry->identity_keys[i] = NULL;
+    }
+    entry->identity_keys_count = 0;
+
+    if (cache->binding_removed)
+        cache->binding_removed(entry->pcf_binding, cache->listener_data);
+}
+
+/* Index entry as the newest holder of its identity key idx */
+static void __identity_index_add(pcf_bindings_cache_t *cache, pcf_bindings_cache_entry_t *entry, int idx)
+{
+    pcf_bindings_cache_identity_t *identity;
+    pcf_bindings_cache_identity_ref_t *ref;
+
+    identity = ogs_hash_get(cache->identities, entry->identity_keys[idx], OGS_HASH_KEY_STRING);
+    if (!identity) {
+        identity = ogs_calloc(1, sizeof(*identity));
+        ogs_assert(identity);
+        identity->identity_key = ogs_strdup(entry->identity_keys[idx]);
+        ogs_assert(identity->identity_key);
+        ogs_list_init(&identity->refs);
+        ogs_hash_set(cache->identities, identity->identity_key, OGS_HASH_KEY_STRING, identity);
+    }
+
+    ref = ogs_calloc(1, sizeof(*ref));
+    ogs_assert(ref);
+    ref->identity = identity;
+    ref->entry = entry;
+    ogs_list_prepend(&identity->refs, ref);
+    entry->identity_refs[idx] = ref;
+}
+
+static void __identity_index_remove(pcf_bindings_cache_t *cache, pcf_bindings_cache_identity_ref_t *ref)
+{
+    pcf_bindings_cache_identity_t *identity = ref->identity;
+
+    ogs_list_remove(&identity->refs, ref);
+    ogs_free(ref);
+
+    if (!ogs_list_first(&identity->refs)) {
+        ogs_hash_set(cache->identities, identity->identity_key, OGS_HASH_KEY_STRING, NULL);
+        ogs_free(identity->identity_key);
+        ogs_free(identity);
+    }
+}
+
+/* count is the entry count kept for lru, so checking it doesn't walk the list */
+static void __evict_lru(pcf_bindings_cache_t *cache, ogs_list_t *lru, const int *count, int max_entries)
+{
+    while (*count > max_entries) {
+        pcf_bindings_cache_entry_t *entry = ogs_list_last(lru);
+        ogs_debug("PCF binding cache full, evicting least recently used entry");
+        __entry_remove(cache, entry);
+    }
+}
+
+/* Remove the entries in lru for IPv6 prefixes or addresses inside, and longer than, prefix */
+static int __invalidate_longer_prefixes(pcf_bindings_cache_t *cache, ogs_list_t *lru, const bsf_ue_address_key_t *prefix)
+{
+    pcf_bindings_cache_entry_t *entry, *next;
+    int count = 0;
+
+    ogs_list_for_each_safe(lru, next, entry) {
+        if (entry->key.prefix_len > prefix->prefix_len && _ue_address_key_contains(prefix, &entry->key)) {
+            __entry_remove(cache, entry);
+            count++;
+        }
+    }
+
+    return count;
+}
+
+static void __expiry_heap_push(pcf_bindings_cache_t *cache, pcf_bindings_cache_entry_t *entry)
+{
+    if (cache->expiry_heap_size == cache->expiry_heap_capacity) {
+        cache->expiry_heap_capacity *= 2;
+        cache->expiry_heap = ogs_realloc(cache->expiry_heap, cache->expiry_heap_capacity * sizeof(cache->expiry_heap[0]));
+        ogs_assert(cache->expiry_heap);
+    }
+
+    entry->expiry_heap_index = cache->expiry_heap_size;
+    cache->expiry_heap[cache->expiry_heap_size++] = entry;
+    __expiry_heap_sift_up(cache, entry->expiry_heap_index);
+}
+
+static void __expiry_heap_remove(pcf_bindings_cache_t *cache, pcf_bindings_cache_entry_t *entry)
+{
+    int idx = entry->expiry_heap_index;
+    int last = cache->expiry_heap_size - 1;
+
+    ogs_assert(idx >= 0 && idx <= last && cache->expiry_heap[idx] == entry);
+
+    if (idx != last) {
+        __expiry_heap_swap(cache, idx, last);
+        cache->expiry_heap_size--;
+        __expiry_heap_update(cache, cache->expiry_heap[idx]);
+    } else {
+        cache->expiry_heap_size--;
+    }
+
+    entry->expiry_heap_index = -1;
+}
+
+static void __expiry_heap_update(pcf_bindings_cache_t *cache, pcf_bindings_cache_entry_t *entry)
+{
+    if (__expiry_heap_sift_up(cache, entry->expiry_heap_index) == entry->expiry_heap_index)
+        __expiry_heap_sift_down(cache, entry->expiry_heap_index);
+}
+
+static void __expiry_heap_swap(pcf_bindings_cache_t *cache, int a, int b)
+{
+    pcf_bindings_cache_entry_t *tmp = cache->expiry_heap[a];
+
+    cache->expiry_heap[a] = cache->expiry_heap[b];
+    cache->expiry_heap[b] = tmp;
+    cache->expiry_heap[a]->expiry_heap_index = a;
+    cache->expiry_heap[b]->expiry_heap_index = b;
+}
+
+static int __expiry_heap_sift_up(pcf_bindings_cache_t *cache, int idx)
+{
+    while (idx > 0) {
+        int parent = (idx - 1) / 2;
+        if (cache->expiry_heap[parent]->remove_at <= cache->expiry_heap[idx]->remove_at) break;
+        __expiry_heap_swap(cache, parent, idx);
+        idx = parent;
+    }
+    return idx;
+}
+
+static int __expiry_heap_sift_down(pcf_bindings_cache_t *cache, int idx)
+{
+    for (;;) {
+        int left = idx * 2 + 1;
+        int right = left + 1;
+        int smallest = idx;
+
+        if (left < cache->expiry_heap_size &&
+                cache->expiry_heap[left]->remove_at < cache->expiry_heap[smallest]->remove_at)
+            smallest = left;
+        if (right < cache->expiry_heap_size &&
+                cache->expiry_heap[right]->remove_at < cache->expiry_heap[smallest]->remove_at)
+            smallest = right;
+        if (smallest == idx) break;
+
+        __expiry_heap_swap(cache, idx, smallest);
+        idx = smallest;
+    }
+    return idx;
+}
+
+static void __expiry_timer_rearm(pcf_bindings_cache_t *cache)
+{
+    ogs_time_t delay;
+
+    if (cache->expiry_heap_size == 0) {
+        ogs_timer_stop(cache->expiry_timer);
+        return;
+    }
+
+    /* wake up just after the earliest entry is past all of its windows */
+    delay = cache->expiry_heap[0]->remove_at - ogs_time_now() + 1;
+    if (delay < 0) delay = 0;
+    ogs_timer_start(cache->expiry_timer, delay);
+}
+
+static void __expiry_timer_expired(void *data)
+{
+    pcf_bindings_cache_t *cache = (pcf_bindings_cache_t*)data;
+
+    _pcf_bindings_cache_expire(cache, ogs_time_now());
+}
+
+static bool __snapshot_write_list(FILE *fp, ogs_list_t *lru, int *count)
+{
+    pcf_bindings_cache_entry_t *entry;
+
+    /* most recently used first, so that a truncated snapshot keeps the most useful entries */
+    ogs_list_for_each(lru, entry) {
+        if (!__snapshot_write_entry(fp, entry)) return false;
+        (*count)++;
+    }
+
+    return true;
+}
+
+static bool __snapshot_write_entry(FILE *fp, const pcf_bindings_cache_entry_t *entry)
+{
+    uint8_t negative = entry->pcf_binding ? 0 : 1;
+    int64_t times[3];
+    uint8_t etag_length = strlen(entry->lifetime.etag);
+    uint32_t length = 0;
+    char *binding_json = NULL;
+    bool ok;
+
+    times[0] = entry->lifetime.expires;
+    times[1] = entry->lifetime.stale_until;
+    times[2] = entry->lifetime.stale_if_error_until;
+
+    if (entry->pcf_binding) {
+        cJSON *json = OpenAPI_pcf_binding_convertToJSON((OpenAPI_pcf_binding_t*)_bsf_pcf_binding_get(entry->pcf_binding));
+
+        if (json) {
+            binding_json = cJSON_PrintUnformatted(json);
+            cJSON_Delete(json);
+        }
+        if (!binding_json) return false;
+        length = strlen(binding_json);
+    }
+
+    ok = fwrite(&entry->key, sizeof(entry->key), 1, fp) == 1 &&
+         fwrite(&negative, sizeof(negative), 1, fp) == 1 &&
+         fwrite(times, sizeof(times), 1, fp) == 1 &&
+         fwrite(&etag_length, sizeof(etag_length), 1, fp) == 1 &&
+         (etag_length == 0 || fwrite(entry->lifetime.etag, etag_length, 1, fp) == 1) &&
+         fwrite(&length, sizeof(length), 1, fp) == 1 &&
+         (length == 0 || fwrite(binding_json, length, 1, fp) == 1);
+
+    if (binding_json) cJSON_free(binding_json);
+
+    return ok;
+}
+
+/* Returns false at the end of the snapshot, or at the first record that can't be read */
+static bool __snapshot_read_entry(FILE *fp, bsf_ue_address_key_t *key, bool *negative, bsf_cache_lifetime_t *lifetime, char **binding_json)
+{
+    uint8_t negative_flag;
+    int64_t times[3];
+    uint8_t etag_length;
+    uint32_t length;
+
+    if (fread(key, sizeof(*key), 1, fp) != 1) return false;
+
+    if (fread(&negative_flag, sizeof(negative_flag), 1, fp) != 1 ||
+            fread(times, sizeof(times), 1, fp) != 1 ||
+            fread(&etag_length, sizeof(etag_length), 1, fp) != 1 ||
+            etag_length > CACHE_POLICY_ETAG_MAX_LENGTH ||
+            (etag_length && fread(lifetime->etag, etag_length, 1, fp) != 1) ||
+            fread(&length, sizeof(length), 1, fp) != 1 ||
+            (key->family == AF_INET ? key->prefix_len != 32 : (key->family != AF_INET6 || key->prefix_len > 128)) ||
+            (negative_flag ? length != 0 : (length == 0 || length > SNAPSHOT_MAX_BINDING_LENGTH))) {
+        ogs_warn("PCF binding cache snapshot is truncated or corrupt");
+        return false;
+    }
+
+    *negative = (negative_flag != 0);
+    lifetime->expires = times[0];
+    lifetime->stale_until = times[1];
+    lifetime->stale_if_error_until = times[2];
+    lifetime->etag[etag_length] = '\0';
+
+    if (length) {
+        *binding_json = ogs_malloc(length + 1);
+        ogs_assert(*binding_json);
+        if (fread(*binding_json, length, 1, fp) != 1) {
+            ogs_warn("PCF binding cache snapshot is truncated");
+            ogs_free(*binding_json);
+            *binding_json = NULL;
+            return false;
+        }
+        (*binding_json)[length] = '\0';
+    }
+
+    return true;
+}
+
+static bool __snapshot_list_full(pcf_bindings_cache_t *cache, bool negative)
+{
+    if (negative) return cache->max_negative_entries > 0 && cache->negative_lru_count >= cache->max_negative_entries;
+    return cache->max_entries > 0 && cache->lru_count >= cache->max_entries;
+}
+
+/* Snapshot entries arrive most recently used first, so each one loaded goes to the back of its LRU list */
+static void __snapshot_entry_loaded(pcf_bindings_cache_t *cache, const bsf_ue_address_key_t *key)
+{
+    pcf_bindings_cache_entry_t *entry;
+    ogs_list_t *lru;
+
+    entry = ogs_hash_get(cache->entries, key, sizeof(*key));
+    if (!entry) return;
+
+    lru = __entry_lru(cache, entry);
+    ogs_list_remove(lru, entry);
+    ogs_list_add(lru, entry);
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -13,21 +13,82 @@
 #include "ogs-core.h"
 #include "ogs-sbi.h"
 
+#include "bsf-service-consumer.h"
+#include "ue-address-key.h"
+#include "ue-identity-key.h"
+#include "utils.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/* Called when a cache entry starts, or stops, holding a reference to binding */
+typedef void (*pcf_bindings_cache_binding_listener_f)(const bsf_pcf_binding_t *binding, void *data);
+
+/* The cache entries holding bindings for one UE identity key */
+typedef struct pcf_bindings_cache_identity_s {
+    char *identity_key;                 /* hash key, owned by this index */
+    ogs_list_t refs;                    /* Nodes of this list are pcf_bindings_cache_identity_ref_t, newest binding first */
+} pcf_bindings_cache_identity_t;
+
+typedef struct pcf_bindings_cache_identity_ref_s {
+    ogs_lnode_t node;                   /* identity refs list node, must be first */
+    pcf_bindings_cache_identity_t *identity;
+    struct pcf_bindings_cache_entry_s *entry;
+} pcf_bindings_cache_identity_ref_t;
+
+typedef struct pcf_bindings_cache_entry_s {
+    ogs_lnode_t node;                   /* LRU (or negative LRU) list node, must be first */
+    bsf_ue_address_key_t key;           /* hash key (IPv4 address or IPv6 prefix), owned by this entry */
+    bsf_pcf_binding_t *pcf_binding;     /* counted reference to the shared binding, NULL for a negative entry */
+    bsf_cache_lifetime_t lifetime;      /* fresh and stale usage windows */
+    ogs_time_t remove_at;               /* end of the last usable window, the expiry heap key */
+    int expiry_heap_index;              /* position of this entry in the expiry heap */
+    char *identity_keys[BSF_UE_IDENTITY_KEYS_MAX + 1]; /* UE identity keys for the binding, plus the one it was looked up by */
+    pcf_bindings_cache_identity_ref_t *identity_refs[BSF_UE_IDENTITY_KEYS_MAX + 1]; /* this entry in the index of each identity key */
+    int identity_keys_count;
+} pcf_bindings_cache_entry_t;
+
 typedef struct pcf_bindings_cache_s {
-    OpenAPI_pcf_binding_t *pcf_binding;
-    ogs_time_t expires;
+    ogs_hash_t *entries;                /* bsf_ue_address_key_t => pcf_bindings_cache_entry_t */
+    ogs_hash_t *identities;             /* UE identity key => pcf_bindings_cache_identity_t */
+    int ipv6_prefix_entries[129];       /* number of IPv6 entries held for each prefix length */
+    ogs_list_t lru;                     /* Nodes of this list are pcf_bindings_cache_entry_t, most recently used first */
+    int lru_count;                      /* entries in lru */
+    pcf_bindings_cache_entry_t **expiry_heap; /* min-heap of entries ordered by remove_at */
+    int expiry_heap_size;
+    int expiry_heap_capacity;
+    int max_entries;                    /* 0 = unbounded */
+    ogs_list_t negative_lru;            /* "no binding" entries, most recently used first */
+    int negative_lru_count;             /* entries in negative_lru */
+    int max_negative_entries;           /* 0 = unbounded */
+    ogs_timer_t *expiry_timer;          /* fires when the earliest entry is due for removal */
+    pcf_bindings_cache_binding_listener_f binding_added;
+    pcf_bindings_cache_binding_listener_f binding_removed;
+    void *listener_data;
 } pcf_bindings_cache_t;
 
 /* Library Internals */
-void _pcf_bindings_cache_init(ogs_hash_t **cache);
-void _pcf_bindings_cache_clear(ogs_hash_t **cache);
-void _pcf_bindings_cache_log_debug(ogs_hash_t *cache, int indent);
-OpenAPI_pcf_binding_t *_pcf_bindings_cache_find(ogs_hash_t *cache, const ogs_sockaddr_t *ue_address);
-bool _pcf_bindings_cache_add(ogs_hash_t *cache, const ogs_sockaddr_t *ue_address, const OpenAPI_pcf_binding_t *bindings, ogs_time_t expires);
+void _pcf_bindings_cache_init(pcf_bindings_cache_t **cache, int max_entries, int max_negative_entries);
+void _pcf_bindings_cache_clear(pcf_bindings_cache_t **cache);
+void _pcf_bindings_cache_set_max_entries(pcf_bindings_cache_t *cache, int max_entries);
+void _pcf_bindings_cache_set_max_negative_entries(pcf_bindings_cache_t *cache, int max_negative_entries);
+void _pcf_bindings_cache_set_binding_listener(pcf_bindings_cache_t *cache, pcf_bindings_cache_binding_listener_f added,
+                                              pcf_bindings_cache_binding_listener_f removed, void *data);
+void _pcf_bindings_cache_log_debug(pcf_bindings_cache_t *cache, int indent);
+bsf_pcf_binding_t *_pcf_bindings_cache_find(pcf_bindings_cache_t *cache, const bsf_ue_address_key_t *ue_address, bool *stale, bool *negative);
+bsf_pcf_binding_t *_pcf_bindings_cache_find_stale_if_error(pcf_bindings_cache_t *cache, const bsf_ue_address_key_t *ue_address);
+bsf_pcf_binding_t *_pcf_bindings_cache_find_by_identity(pcf_bindings_cache_t *cache, const char *identity_key, bool *stale);
+bsf_pcf_binding_t *_pcf_bindings_cache_find_by_identity_stale_if_error(pcf_bindings_cache_t *cache, const char *identity_key);
+const char *_pcf_bindings_cache_find_etag(pcf_bindings_cache_t *cache, const bsf_ue_address_key_t *ue_address);
+bsf_pcf_binding_t *_pcf_bindings_cache_revalidated(pcf_bindings_cache_t *cache, const bsf_ue_address_key_t *ue_address, const bsf_cache_lifetime_t *lifetime);
+bool _pcf_bindings_cache_add(pcf_bindings_cache_t *cache, const bsf_ue_address_key_t *key, bsf_pcf_binding_t *binding, const bsf_cache_lifetime_t *lifetime);
+bool _pcf_bindings_cache_add_identity(pcf_bindings_cache_t *cache, const bsf_ue_address_key_t *key, const char *identity_key);
+bool _pcf_bindings_cache_add_negative(pcf_bindings_cache_t *cache, const bsf_ue_address_key_t *key, ogs_time_t expires);
+int _pcf_bindings_cache_invalidate(pcf_bindings_cache_t *cache, const bsf_ue_address_key_t *key);
+int _pcf_bindings_cache_expire(pcf_bindings_cache_t *cache, ogs_time_t now);
+bool _pcf_bindings_cache_snapshot_save(pcf_bindings_cache_t *cache, const char *filename);
+int _pcf_bindings_cache_snapshot_load(pcf_bindings_cache_t *cache, const char *filename);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,143 @@
+/*
+ * License: 5G-MAG Public License (v1.0)
+ * Copyright: (C) 2023 British Broadcasting Corporation
+ *
+ * For full license terms please see the LICENSE file distributed with this
+ * program. If this file is missing then the license can be retrieved from
+ * https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
+ */
+
+#include "ogs-core.h"
+
+#include "ue-address-key.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Library Internals */
+bool _ue_address_key_from_sockaddr(bsf_ue_address_key_t *key, const ogs_sockaddr_t *addr)
+{
+    if (!key || !addr) return false;
+
+    memset(key, 0, sizeof(*key));
+
+    if (addr->ogs_sa_family == AF_INET) {
+        key->family = AF_INET;
+        key->prefix_len = 32;
+        memcpy(key->addr, &addr->sin.sin_addr, 4);
+    } else if (addr->ogs_sa_family == AF_INET6) {
+        key->family = AF_INET6;
+        key->prefix_len = 128;
+        memcpy(key->addr, &addr->sin6.sin6_addr, 16);
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+bool _ue_address_key_from_ipv4_string(bsf_ue_address_key_t *key, const char *ipv4addr)
+{
+    if (!key || !ipv4addr) return false;
+
+    memset(key, 0, sizeof(*key));
+    if (inet_pton(AF_INET, ipv4addr, key->addr) != 1) return false;
+    key->family = AF_INET;
+    key->prefix_len = 32;
+
+    return true;
+}
+
+bool _ue_address_key_from_ipv6_prefix_string(bsf_ue_address_key_t *key, const char *ipv6prefix)
+{
+    char addr[OGS_ADDRSTRLEN];
+    const char *slash;
+    int prefix_len = 128;
+    size_t addr_len;
+
+    if (!key || !ipv6prefix) return false;
+
+    memset(key, 0, sizeof(*key));
+
+    slash = strchr(ipv6prefix, '/');
+    addr_len = slash ? (size_t)(slash - ipv6prefix) : strlen(ipv6prefix);
+    if (addr_len >= sizeof(addr)) return false;
+    memcpy(addr, ipv6prefix, addr_len);
+    addr[addr_len] = '\0';
+
+    if (slash) {
+        char *end = NULL;
+        prefix_len = strtol(slash+1, &end, 10);
+        if (end == slash+1 || *end != '\0' || prefix_len < 0 || prefix_len > 128) return false;
+    }
+
+    if (inet_pton(AF_INET6, addr, key->addr) != 1) return false;
+    key->family = AF_INET6;
+    _ue_address_key_set_prefix_len(key, prefix_len);
+
+    return true;
+}
+
+void _ue_address_key_set_prefix_len(bsf_ue_address_key_t *key, uint8_t prefix_len)
+{
+    int i;
+    int addr_len;
+
+    if (!key) return;
+
+    addr_len = (key->family == AF_INET) ? 4 : 16;
+    if (prefix_len > addr_len * 8) prefix_len = addr_len * 8;
+    key->prefix_len = prefix_len;
+
+    /* clear host bits */
+    for (i = 0; i < addr_len; i++) {
+        int bits = prefix_len - i * 8;
+        if (bits >= 8) continue;
+        if (bits <= 0) {
+            key->addr[i] = 0;
+        } else {
+            key->addr[i] &= (uint8_t)(0xff << (8 - bits));
+        }
+    }
+}
+
+bool _ue_address_key_contains(const bsf_ue_address_key_t *prefix, const bsf_ue_address_key_t *key)
+{
+    bsf_ue_address_key_t masked;
+
+    if (!prefix || !key) return false;
+    if (prefix->family != key->family) return false;
+    if (prefix->prefix_len > key->prefix_len) return false;
+
+    memcpy(&masked, key, sizeof(masked));
+    _ue_address_key_set_prefix_len(&masked, prefix->prefix_len);
+
+    return memcmp(masked.addr, prefix->addr, sizeof(masked.addr)) == 0;
+}
+
+char *_ue_address_key_string(const bsf_ue_address_key_t *key)
+{
+    char buf[OGS_ADDRSTRLEN];
+
+    if (!key) return NULL;
+
+    if (key->family == AF_INET) {
+        if (!OGS_INET_NTOP(key->addr, buf)) return NULL;
+        return ogs_strdup(buf);
+    }
+
+    if (key->family == AF_INET6) {
+        if (!OGS_INET6_NTOP(key->addr, buf)) return NULL;
+        return ogs_msprintf("%s/%u", buf, key->prefix_len);
+    }
+
+    return NULL;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+/* vim:ts=8:sts=4:sw=4:expandtab:
+ */
@@ -0,0 +1,44 @@
+/*
+ * License: 5G-MAG Public License (v1.0)
+ * Copyright: (C) 2023 British Broadcasting Corporation
+ *
+ * For full license terms please see the LICENSE file distributed with this
+ * program. If this file is missing then the license can be retrieved from
+ * https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
+ */
+
+#ifndef BSF_CLIENT_UE_ADDRESS_KEY_H
+#define BSF_CLIENT_UE_ADDRESS_KEY_H
+
+#include "ogs-core.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Normalised UE address or prefix, safe to use directly as a hash key.
+ * IPv4 keys are always /32, IPv6 keys carry a prefix length and all address
+ * bits beyond the prefix, and all unused bytes, are zero.
+ */
+typedef struct bsf_ue_address_key_s {
+    uint8_t family;     /* AF_INET or AF_INET6 */
+    uint8_t prefix_len; /* 32 for IPv4, 0..128 for IPv6 */
+    uint8_t addr[16];   /* network byte order */
+} bsf_ue_address_key_t;
+
+/* Library Internals */
+bool _ue_address_key_from_sockaddr(bsf_ue_address_key_t *key, const ogs_sockaddr_t *addr);
+bool _ue_address_key_from_ipv4_string(bsf_ue_address_key_t *key, const char *ipv4addr);
+bool _ue_address_key_from_ipv6_prefix_string(bsf_ue_address_key_t *key, const char *ipv6prefix);
+void _ue_address_key_set_prefix_len(bsf_ue_address_key_t *key, uint8_t prefix_len);
+bool _ue_address_key_contains(const bsf_ue_address_key_t *prefix, const bsf_ue_address_key_t *key);
+char *_ue_address_key_string(const bsf_ue_address_key_t *key);
+
+#ifdef __cplusplus
+}
+#endif
+
+/* vim:ts=8:sts=4:sw=4:expandtab:
+ */
+
+#endif /* BSF_CLIENT_UE_ADDRESS_KEY_H */
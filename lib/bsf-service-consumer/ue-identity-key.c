@@ -0,0 +1,87 @@
+/*
+ * License: 5G-MAG Public License (v1.0)
+ * Copyright: (C) 2023 British Broadcasting Corporation
+ *
+ * For full license terms please see the LICENSE file distributed with this
+ * program. If this file is missing then the license can be retrieved from
+ * https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
+ */
+
+#include <ctype.h>
+
+#include "ogs-core.h"
+#include "ogs-sbi.h"
+
+#include "ue-identity-key.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+static void __lower_case(char *str);
+
+/* Library Internals */
+
+/* type is "supi" or "gpsi". An S-NSSAI is only used with a DNN, returns NULL for an S-NSSAI without one */
+char *_ue_identity_key_new(const char *type, const char *identity, const char *dnn, const OpenAPI_snssai_t *snssai)
+{
+    char *key;
+
+    if (!type || !identity) return NULL;
+
+    if (snssai) {
+        if (!dnn) return NULL;
+        key = ogs_msprintf("%s:%s;dnn:%s;snssai:%i-%s", type, identity, dnn, snssai->sst, snssai->sd ? snssai->sd : "ffffff");
+        ogs_assert(key);
+        __lower_case(strstr(key, ";dnn:"));
+    } else if (dnn) {
+        key = ogs_msprintf("%s:%s;dnn:%s", type, identity, dnn);
+        ogs_assert(key);
+        __lower_case(strstr(key, ";dnn:"));
+    } else {
+        key = ogs_msprintf("%s:%s", type, identity);
+        ogs_assert(key);
+    }
+
+    return key;
+}
+
+/* Fill keys with every identity key pcf_binding answers, returns the number of keys, each one to be ogs_free()d */
+int _ue_identity_keys_from_pcf_binding(const OpenAPI_pcf_binding_t *pcf_binding, char *keys[BSF_UE_IDENTITY_KEYS_MAX])
+{
+    const char *types[2] = { "supi", "gpsi" };
+    const char *identities[2];
+    int count = 0;
+    int i;
+
+    if (!pcf_binding) return 0;
+
+    identities[0] = pcf_binding->supi;
+    identities[1] = pcf_binding->gpsi;
+
+    for (i = 0; i < 2; i++) {
+        if (!identities[i]) continue;
+        keys[count++] = _ue_identity_key_new(types[i], identities[i], NULL, NULL);
+        if (pcf_binding->dnn) {
+            keys[count++] = _ue_identity_key_new(types[i], identities[i], pcf_binding->dnn, NULL);
+            if (pcf_binding->snssai)
+                keys[count++] = _ue_identity_key_new(types[i], identities[i], pcf_binding->dnn, pcf_binding->snssai);
+        }
+    }
+
+    return count;
+}
+
+/*** Private functions ***/
+
+static void __lower_case(char *str)
+{
+    for (; str && *str; str++) *str = tolower((unsigned char)*str);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+/* vim:ts=8:sts=4:sw=4:expandtab:
+ */
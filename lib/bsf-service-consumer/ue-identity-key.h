@@ -0,0 +1,40 @@
+/*
+ * License: 5G-MAG Public License (v1.0)
+ * Copyright: (C) 2023 British Broadcasting Corporation
+ *
+ * For full license terms please see the LICENSE file distributed with this
+ * program. If this file is missing then the license can be retrieved from
+ * https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
+ */
+
+#ifndef BSF_CLIENT_UE_IDENTITY_KEY_H
+#define BSF_CLIENT_UE_IDENTITY_KEY_H
+
+#include "ogs-core.h"
+#include "ogs-sbi.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Most keys one PcfBinding is indexed under: SUPI and GPSI, each on its own, with the DNN and with
+ * the DNN and S-NSSAI.
+ */
+#define BSF_UE_IDENTITY_KEYS_MAX 6
+
+/* Normalised UE identity used as a string hash key, e.g. "supi:imsi-001010000000001" or
+ * "gpsi:msisdn-447700900123;dnn:internet;snssai:1-000001". The DNN and SD are lower cased.
+ */
+
+/* Library Internals */
+char *_ue_identity_key_new(const char *type, const char *identity, const char *dnn, const OpenAPI_snssai_t *snssai);
+int _ue_identity_keys_from_pcf_binding(const OpenAPI_pcf_binding_t *pcf_binding, char *keys[BSF_UE_IDENTITY_KEYS_MAX]);
+
+#ifdef __cplusplus
+}
+#endif
+
+/* vim:ts=8:sts=4:sw=4:expandtab:
+ */
+
+#endif /* BSF_CLIENT_UE_IDENTITY_KEY_H */
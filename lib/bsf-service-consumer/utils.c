@@ -33,56 +33,32 @@ char *_time_string(ogs_time_t t)
     return ogs_strdup(timestamp);
 }
 
-ogs_time_t _response_to_expiry_time(ogs_sbi_response_t *response)
+/* Work out how long a response may be cached for (RFC 9111) and how long it may be served stale
+ * afterwards (RFC 5861). The stale windows default to the values given when the response does not
+ * carry the corresponding Cache-Control directives. All durations are in seconds.
+ */
+void _response_to_cache_lifetime(ogs_sbi_response_t *response, ogs_time_t default_stale_while_revalidate,
+                                 ogs_time_t default_stale_if_error, bsf_cache_lifetime_t *lifetime)
 {
-    ogs_hash_index_t *hi;
-    ogs_time_t base_time;
-    ogs_time_t max_age = 5; /* default 5 seconds from now */
-    ogs_time_t current_age = 0;
+    cache_policy_t policy;
+    ogs_time_t stale_while_revalidate = default_stale_while_revalidate;
+    ogs_time_t stale_if_error = default_stale_if_error;
 
-    base_time = ogs_time_now();
+    _cache_policy_from_headers(response->http.headers, ogs_time_now(), 5 /* default 5 seconds */, &policy);
 
-    for (hi = ogs_hash_first(response->http.headers); hi; hi = ogs_hash_next(hi)) {
-        if (!ogs_strcasecmp(ogs_hash_this_key(hi), "Age")) {
-            /* remember the age in seconds of the response object */
-            current_age = atoi(ogs_hash_this_val(hi));
-        } else if (!ogs_strcasecmp(ogs_hash_this_key(hi), "Cache-Control")) {
-            /* parse Cache-Control header for cache rules */
-            const char *cache_control = ogs_hash_this_val(hi);
-            max_age = _cache_control_to_cache_age(cache_control);
-        } else if (!ogs_strcasecmp(ogs_hash_this_key(hi), "Date")) {
-            /* Use server date-time as base for expiry time */
-            struct tm tm;
-            ogs_strptime(ogs_hash_this_val(hi), "%a, %d %b %Y %H:%M:%S GMT", &tm);
-            ogs_time_from_gmt(&base_time, &tm, 0);
-        }
+    if (policy.stale_while_revalidate >= 0) stale_while_revalidate = policy.stale_while_revalidate;
+    if (policy.stale_if_error >= 0) stale_if_error = policy.stale_if_error;
+    if (policy.no_store || policy.must_revalidate) {
+        stale_while_revalidate = 0;
+        stale_if_error = 0;
     }
+    if (stale_while_revalidate < 0) stale_while_revalidate = 0;
+    if (stale_if_error < 0) stale_if_error = 0;
 
-    max_age -= current_age;
-    if (max_age < 0) max_age = 0;
-    return base_time + max_age;
-}
-
-ogs_time_t _cache_control_to_cache_age(const char *cache_control)
-{
-    char *saveptr = NULL;
-    char *value;
-    char *ptr;
-    ogs_time_t ret = 0;
-
-    value = ogs_strdup(cache_control);
-    for (ptr = ogs_strtok_r(value, ",", &saveptr); ptr; ptr = ogs_strtok_r(NULL, ",", &saveptr)) {
-        char *op;
-        op = ogs_trimwhitespace(ptr);
-        if (!ogs_strcasecmp(op, "no-cache") || !ogs_strcasecmp(op, "no-store")) {
-            ret = 0;
-            break;
-        } else if (!ogs_strncasecmp(op, "max-age=", 8)) {
-            ret = atoi(op+8);
-        }
-    }
-    ogs_free(value);
-    return ret;
+    lifetime->expires = policy.fresh_until;
+    lifetime->stale_until = lifetime->expires + ogs_time_from_sec(stale_while_revalidate);
+    lifetime->stale_if_error_until = lifetime->expires + ogs_time_from_sec(stale_if_error);
+    memcpy(lifetime->etag, policy.etag, sizeof(lifetime->etag));
 }
 
 #ifdef __cplusplus
@@ -13,15 +13,24 @@
 #include "ogs-core.h"
 #include "ogs-sbi.h"
 
+#include "cache-policy.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+typedef struct bsf_cache_lifetime_s {
+    ogs_time_t expires;              /* fresh until this time */
+    ogs_time_t stale_until;          /* may be served stale, while being revalidated, until this time */
+    ogs_time_t stale_if_error_until; /* may be served stale, when revalidation fails, until this time */
+    char etag[CACHE_POLICY_ETAG_MAX_LENGTH + 1]; /* validator for revalidating with If-None-Match, empty if none */
+} bsf_cache_lifetime_t;
+
 /* Library Internals */
 char *_sockaddr_string(const ogs_sockaddr_t *addr);
 char *_time_string(ogs_time_t t);
-ogs_time_t _response_to_expiry_time(ogs_sbi_response_t *message);
-ogs_time_t _cache_control_to_cache_age(const char *cache_control);
+void _response_to_cache_lifetime(ogs_sbi_response_t *message, ogs_time_t default_stale_while_revalidate,
+                                 ogs_time_t default_stale_if_error, bsf_cache_lifetime_t *lifetime);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,279 @@
+/*
+ * License: 5G-MAG Public License (v1.0)
+ * Copyright: (C) 2023 British Broadcasting Corporation
+ *
+ * For full license terms please see the LICENSE file distributed with this
+ * program. If this file is missing then the license can be retrieved from
+ * https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
+ */
+
+#include "ogs-core.h"
+
+#include "cache-policy.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* longest delta-seconds value we keep, RFC 9111 section 1.2.2 */
+#define DELTA_SECONDS_MAX 2147483647
+
+#define NAME_IS(name, len, literal) ((len) == sizeof(literal) - 1 && !ogs_strncasecmp((name), (literal), (len)))
+
+typedef struct cache_control_s {
+    long long max_age;                /* -1 if absent */
+    long long s_maxage;               /* -1 if absent */
+    long long stale_while_revalidate; /* -1 if absent */
+    long long stale_if_error;         /* -1 if absent */
+    bool no_store;
+    bool no_cache;
+    bool must_revalidate;
+} cache_control_t;
+
+static void __cache_control_parse(const char *value, cache_control_t *cc);
+static void __cache_control_directive(cache_control_t *cc, const char *name, size_t name_len, const char *arg, size_t arg_len);
+static long long __delta_seconds(const char *arg, size_t arg_len);
+static void __etag_copy(char *dest, const char *value);
+static long long __days_from_civil(int year, int month, int day);
+
+/* Library Internals */
+
+/* Work out the freshness lifetime (RFC 9111 section 4.2) and validator of a response in one pass over
+ * its headers, without allocating. response_time is when the response was received, default_max_age
+ * is the freshness lifetime in seconds to use when the response gives none.
+ */
+void _cache_policy_from_headers(ogs_hash_t *headers, ogs_time_t response_time, int default_max_age, cache_policy_t *policy)
+{
+    ogs_hash_index_t *hi;
+    cache_control_t cc;
+    long long age = 0;
+    bool have_date = false, have_expires = false, expires_valid = false;
+    ogs_time_t date = 0, expires = 0;
+    ogs_time_t lifetime, current_age;
+
+    memset(policy, 0, sizeof(*policy));
+    cc.max_age = cc.s_maxage = cc.stale_while_revalidate = cc.stale_if_error = -1;
+    cc.no_store = cc.no_cache = cc.must_revalidate = false;
+
+    for (hi = ogs_hash_first(headers); hi; hi = ogs_hash_next(hi)) {
+        const char *name = ogs_hash_this_key(hi);
+        const char *value = ogs_hash_this_val(hi);
+        int len = ogs_hash_this_key_len(hi);
+
+        if (!name || !value) continue;
+        if (len < 0) len = strlen(name);
+
+        /* only compare names of the right length */
+        switch (len) {
+        case 3:
+            if (NAME_IS(name, len, "Age")) {
+                age = __delta_seconds(value, strlen(value));
+                if (age < 0) age = 0;
+            }
+            break;
+        case 4:
+            if (NAME_IS(name, len, "Date")) {
+                have_date = _cache_policy_parse_http_date(value, &date);
+            } else if (NAME_IS(name, len, "ETag")) {
+                __etag_copy(policy->etag, value);
+            }
+            break;
+        case 7:
+            if (NAME_IS(name, len, "Expires")) {
+                have_expires = true;
+                expires_valid = _cache_policy_parse_http_date(value, &expires);
+            }
+            break;
+        case 13:
+            if (NAME_IS(name, len, "Cache-Control")) __cache_control_parse(value, &cc);
+            break;
+        default:
+            break;
+        }
+    }
+
+    policy->no_store = cc.no_store || cc.no_cache;
+    policy->must_revalidate = cc.must_revalidate;
+    policy->stale_while_revalidate = (int)cc.stale_while_revalidate;
+    policy->stale_if_error = (int)cc.stale_if_error;
+
+    /* freshness lifetime: s-maxage, then max-age, then Expires, then the default */
+    if (policy->no_store) {
+        lifetime = 0;
+    } else if (cc.s_maxage >= 0) {
+        lifetime = ogs_time_from_sec(cc.s_maxage);
+    } else if (cc.max_age >= 0) {
+        lifetime = ogs_time_from_sec(cc.max_age);
+    } else if (have_expires) {
+        /* an invalid Expires means already expired */
+        lifetime = expires_valid ? expires - (have_date ? date : response_time) : 0;
+    } else {
+        lifetime = ogs_time_from_sec(default_max_age);
+    }
+
+    /* current age: the larger of the apparent age and the Age header */
+    current_age = ogs_time_from_sec(age);
+    if (have_date && response_time - date > current_age) current_age = response_time - date;
+
+    lifetime -= current_age;
+    if (lifetime < 0) lifetime = 0;
+    policy->fresh_until = response_time + lifetime;
+}
+
+/* Parse an IMF-fixdate, e.g. "Sun, 06 Nov 1994 08:49:37 GMT", the only form senders may generate */
+bool _cache_policy_parse_http_date(const char *value, ogs_time_t *t)
+{
+    static const char months[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+    const char *s = value;
+    int i, day, month, year, hour, minute, second;
+
+    if (!s) return false;
+    while (*s == ' ' || *s == '\t') s++;
+
+    for (i = 0; i < 29; i++) {
+        if (!s[i]) return false;
+    }
+    if (s[3] != ',' || s[4] != ' ' || s[7] != ' ' || s[11] != ' ' || s[16] != ' ' || s[19] != ':' ||
+            s[22] != ':' || s[25] != ' ' || strncmp(s + 26, "GMT", 3)) return false;
+
+#define DIGIT(c) ((c) >= '0' && (c) <= '9')
+    if (!DIGIT(s[5]) || !DIGIT(s[6]) || !DIGIT(s[12]) || !DIGIT(s[13]) || !DIGIT(s[14]) || !DIGIT(s[15]) ||
+            !DIGIT(s[17]) || !DIGIT(s[18]) || !DIGIT(s[20]) || !DIGIT(s[21]) || !DIGIT(s[23]) || !DIGIT(s[24]))
+        return false;
+#undef DIGIT
+
+    for (month = 0; month < 12; month++) {
+        if (!strncmp(s + 8, months + month * 3, 3)) break;
+    }
+    if (month == 12) return false;
+
+    day = (s[5] - '0') * 10 + (s[6] - '0');
+    year = (s[12] - '0') * 1000 + (s[13] - '0') * 100 + (s[14] - '0') * 10 + (s[15] - '0');
+    hour = (s[17] - '0') * 10 + (s[18] - '0');
+    minute = (s[20] - '0') * 10 + (s[21] - '0');
+    second = (s[23] - '0') * 10 + (s[24] - '0');
+    if (day < 1 || day > 31 || hour > 23 || minute > 59 || second > 60) return false;
+
+    *t = ogs_time_from_sec(__days_from_civil(year, month + 1, day) * 86400 + hour * 3600 + minute * 60 + second);
+
+    return true;
+}
+
+/*** Private functions ***/
+
+/* Scan the Cache-Control list in place, quoted arguments are allowed */
+static void __cache_control_parse(const char *value, cache_control_t *cc)
+{
+    const char *p = value;
+
+    while (*p) {
+        const char *name, *arg = NULL;
+        size_t name_len, arg_len = 0;
+
+        while (*p == ' ' || *p == '\t' || *p == ',') p++;
+        if (!*p) break;
+
+        name = p;
+        while (*p && *p != '=' && *p != ',' && *p != ' ' && *p != '\t') p++;
+        name_len = p - name;
+
+        while (*p == ' ' || *p == '\t') p++;
+        if (*p == '=') {
+            p++;
+            while (*p == ' ' || *p == '\t') p++;
+            if (*p == '"') {
+                arg = ++p;
+                while (*p && *p != '"') p++;
+                arg_len = p - arg;
+                if (*p) p++;
+            } else {
+                arg = p;
+                while (*p && *p != ',' && *p != ' ' && *p != '\t') p++;
+                arg_len = p - arg;
+            }
+        }
+
+        /* skip anything unexpected up to the next directive */
+        while (*p && *p != ',') p++;
+
+        __cache_control_directive(cc, name, name_len, arg, arg_len);
+    }
+}
+
+static void __cache_control_directive(cache_control_t *cc, const char *name, size_t name_len, const char *arg, size_t arg_len)
+{
+    if (NAME_IS(name, name_len, "max-age")) {
+        /* an invalid value means stale */
+        cc->max_age = __delta_seconds(arg, arg_len);
+        if (cc->max_age < 0) cc->max_age = 0;
+    } else if (NAME_IS(name, name_len, "s-maxage")) {
+        cc->s_maxage = __delta_seconds(arg, arg_len);
+        if (cc->s_maxage < 0) cc->s_maxage = 0;
+    } else if (NAME_IS(name, name_len, "no-store")) {
+        cc->no_store = true;
+    } else if (NAME_IS(name, name_len, "no-cache")) {
+        cc->no_cache = true;
+    } else if (NAME_IS(name, name_len, "must-revalidate") || NAME_IS(name, name_len, "proxy-revalidate")) {
+        cc->must_revalidate = true;
+    } else if (NAME_IS(name, name_len, "stale-while-revalidate")) {
+        cc->stale_while_revalidate = __delta_seconds(arg, arg_len);
+    } else if (NAME_IS(name, name_len, "stale-if-error")) {
+        cc->stale_if_error = __delta_seconds(arg, arg_len);
+    }
+}
+
+/* Returns -1 if arg isn't a delta-seconds value */
+static long long __delta_seconds(const char *arg, size_t arg_len)
+{
+    long long val = 0;
+    size_t i;
+
+    if (!arg || !arg_len) return -1;
+
+    for (i = 0; i < arg_len; i++) {
+        if (arg[i] < '0' || arg[i] > '9') return -1;
+        if (val < DELTA_SECONDS_MAX) val = val * 10 + (arg[i] - '0');
+    }
+
+    return val > DELTA_SECONDS_MAX ? DELTA_SECONDS_MAX : val;
+}
+
+/* Keep the entity-tag, including any W/ prefix and quotes, if it fits */
+static void __etag_copy(char *dest, const char *value)
+{
+    size_t len;
+
+    while (*value == ' ' || *value == '\t') value++;
+    len = strlen(value);
+    while (len && (value[len - 1] == ' ' || value[len - 1] == '\t')) len--;
+
+    if (!len || len > CACHE_POLICY_ETAG_MAX_LENGTH) {
+        dest[0] = '\0';
+        return;
+    }
+
+    memcpy(dest, value, len);
+    dest[len] = '\0';
+}
+
+/* Days since 1970-01-01 in the proleptic Gregorian calendar */
+static long long __days_from_civil(int year, int month, int day)
+{
+    long long era;
+    int yoe, doy, doe;
+
+    year -= month <= 2;
+    era = (year >= 0 ? year : year - 399) / 400;
+    yoe = (int)(year - era * 400);
+    doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+
+    return era * 146097 + doe - 719468;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+/* vim:ts=8:sts=4:sw=4:expandtab:
+ */
@@ -0,0 +1,46 @@
+/*
+ * License: 5G-MAG Public License (v1.0)
+ * Copyright: (C) 2023 British Broadcasting Corporation
+ *
+ * For full license terms please see the LICENSE file distributed with this
+ * program. If this file is missing then the license can be retrieved from
+ * https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
+ */
+
+#ifndef SC_COMMON_CACHE_POLICY_H
+#define SC_COMMON_CACHE_POLICY_H
+
+#include "ogs-core.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CACHE_POLICY_ETAG_MAX_LENGTH 80
+
+/* How a response may be cached (RFC 9111) and served stale (RFC 5861).
+ *
+ * The service consumer caches are shared by every caller of a library, so s-maxage and
+ * proxy-revalidate apply to them.
+ */
+typedef struct cache_policy_s {
+    bool no_store;              /* must not be stored: no-store, or no-cache which needs revalidating on every use */
+    bool must_revalidate;       /* must not be served stale: must-revalidate or proxy-revalidate */
+    ogs_time_t fresh_until;     /* local time at which the response stops being fresh */
+    int stale_while_revalidate; /* seconds, -1 if the response doesn't say */
+    int stale_if_error;         /* seconds, -1 if the response doesn't say */
+    char etag[CACHE_POLICY_ETAG_MAX_LENGTH + 1]; /* entity-tag to revalidate with (If-None-Match), empty if none */
+} cache_policy_t;
+
+/* Library Internals */
+void _cache_policy_from_headers(ogs_hash_t *headers, ogs_time_t response_time, int default_max_age, cache_policy_t *policy);
+bool _cache_policy_parse_http_date(const char *value, ogs_time_t *t);
+
+#ifdef __cplusplus
+}
+#endif
+
+/* vim:ts=8:sts=4:sw=4:expandtab:
+ */
+
+#endif /* SC_COMMON_CACHE_POLICY_H */
@@ -0,0 +1,108 @@
+/*
+ * License: 5G-MAG Public License (v1.0)
+ * Copyright: (C) 2023 British Broadcasting Corporation
+ *
+ * For full license terms please see the LICENSE file distributed with this
+ * program. If this file is missing then the license can be retrieved from
+ * https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
+ */
+
+#include "ogs-core.h"
+#include "ogs-sbi.h"
+
+#include "json-merge-patch.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Library Internals */
+
+/* Find the smallest merge patch that takes base to target, where target only holds the members being set and a
+ * null member removes it. Members of target equal to base are left out, objects are compared member by member
+ * and anything else is replaced whole.
+ *
+ * Sets *patch to NULL and returns true if nothing changes, returns false if target isn't an object.
+ */
+bool _json_merge_patch_diff(const cJSON *base, const cJSON *target, cJSON **patch)
+{
+    const cJSON *member;
+    cJSON *result = NULL;
+
+    *patch = NULL;
+
+    if (!cJSON_IsObject(target)) return false;
+    if (base && !cJSON_IsObject(base)) base = NULL;
+
+    cJSON_ArrayForEach(member, target) {
+        const cJSON *old = base ? cJSON_GetObjectItemCaseSensitive(base, member->string) : NULL;
+        cJSON *change = NULL;
+
+        if (cJSON_IsNull(member)) {
+            if (old) change = cJSON_CreateNull();
+        } else if (cJSON_IsObject(member) && cJSON_IsObject(old)) {
+            _json_merge_patch_diff(old, member, &change);
+        } else if (!old || !cJSON_Compare(old, member, 1)) {
+            change = cJSON_Duplicate(member, 1);
+        }
+
+        if (!change) continue;
+        if (!result) {
+            result = cJSON_CreateObject();
+            ogs_assert(result);
+        }
+        cJSON_AddItemToObject(result, member->string, change);
+    }
+
+    *patch = result;
+
+    return true;
+}
+
+/* Apply patch to *target as RFC 7396 describes, *target is replaced if either isn't an object */
+void _json_merge_patch_apply(cJSON **target, const cJSON *patch)
+{
+    const cJSON *member;
+
+    if (!cJSON_IsObject(patch)) {
+        if (*target) cJSON_Delete(*target);
+        *target = cJSON_Duplicate(patch, 1);
+        return;
+    }
+
+    if (!cJSON_IsObject(*target)) {
+        if (*target) cJSON_Delete(*target);
+        *target = cJSON_CreateObject();
+        ogs_assert(*target);
+    }
+
+    cJSON_ArrayForEach(member, patch) {
+        cJSON *old = cJSON_GetObjectItemCaseSensitive(*target, member->string);
+
+        if (cJSON_IsNull(member)) {
+            if (old) cJSON_DeleteItemFromObjectCaseSensitive(*target, member->string);
+        } else if (cJSON_IsObject(member)) {
+            /* a new member starts as an empty object, so the nulls in it are dropped too (RFC 7396) */
+            cJSON *merged = old ? cJSON_Duplicate(old, 1) : cJSON_CreateObject();
+
+            ogs_assert(merged);
+            _json_merge_patch_apply(&merged, member);
+            if (old) {
+                cJSON_ReplaceItemInObjectCaseSensitive(*target, member->string, merged);
+            } else {
+                cJSON_AddItemToObject(*target, member->string, merged);
+            }
+        } else if (old) {
+            cJSON_ReplaceItemInObjectCaseSensitive(*target, member->string, cJSON_Duplicate(member, 1));
+        } else {
+            cJSON_AddItemToObject(*target, member->string, cJSON_Duplicate(member, 1));
+        }
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+/* vim:ts=8:sts=4:sw=4:expandtab:
+ */
@@ -0,0 +1,33 @@
+/*
+ * License: 5G-MAG Public License (v1.0)
+ * Copyright: (C) 2023 British Broadcasting Corporation
+ *
+ * For full license terms please see the LICENSE file distributed with this
+ * program. If this file is missing then the license can be retrieved from
+ * https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
+ */
+
+#ifndef SC_COMMON_JSON_MERGE_PATCH_H
+#define SC_COMMON_JSON_MERGE_PATCH_H
+
+#include "ogs-core.h"
+#include "ogs-sbi.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* JSON merge patches (RFC 7396) */
+
+/* Library Internals */
+bool _json_merge_patch_diff(const cJSON *base, const cJSON *target, cJSON **patch);
+void _json_merge_patch_apply(cJSON **target, const cJSON *patch);
+
+#ifdef __cplusplus
+}
+#endif
+
+/* vim:ts=8:sts=4:sw=4:expandtab:
+ */
+
+#endif /* SC_COMMON_JSON_MERGE_PATCH_H */
@@ -39,56 +39,14 @@ char *_time_string(ogs_time_t t)
 #endif
 }
 
+/* Local time at which the response stops being fresh, 5 seconds from now if the response doesn't say */
 ogs_time_t _response_to_expiry_time(ogs_sbi_response_t *response)
 {
-    ogs_hash_index_t *hi;
-    ogs_time_t base_time;
-    ogs_time_t max_age = 5; /* default 5 seconds from now */
-    ogs_time_t current_age = 0;
-
-    base_time = ogs_time_now();
-
-    for (hi = ogs_hash_first(response->http.headers); hi; hi = ogs_hash_next(hi)) {
-        if (!ogs_strcasecmp(ogs_hash_this_key(hi), "Age")) {
-            /* remember the age in seconds of the response object */
-            current_age = atoi(ogs_hash_this_val(hi));
-        } else if (!ogs_strcasecmp(ogs_hash_this_key(hi), "Cache-Control")) {
-            /* parse Cache-Control header for cache rules */
-            const char *cache_control = ogs_hash_this_val(hi);
-            max_age = _cache_control_to_cache_age(cache_control);
-        } else if (!ogs_strcasecmp(ogs_hash_this_key(hi), "Date")) {
-            /* Use server date-time as base for expiry time */
-            struct tm tm;
-            ogs_strptime(ogs_hash_this_val(hi), "%a, %d %b %Y %H:%M:%S GMT", &tm);
-            ogs_time_from_gmt(&base_time, &tm, 0);
-        }
-    }
+    cache_policy_t policy;
 
-    max_age -= current_age;
-    if (max_age < 0) max_age = 0;
-    return base_time + max_age;
-}
+    _cache_policy_from_headers(response->http.headers, ogs_time_now(), 5, &policy);
 
-ogs_time_t _cache_control_to_cache_age(const char *cache_control)
-{
-    char *saveptr = NULL;
-    char *value;
-    char *ptr;
-    ogs_time_t ret = 0;
-
-    value = ogs_strdup(cache_control);
-    for (ptr = ogs_strtok_r(value, ",", &saveptr); ptr; ptr = ogs_strtok_r(NULL, ",", &saveptr)) {
-        char *op;
-        op = ogs_trimwhitespace(ptr);
-        if (!ogs_strcasecmp(op, "no-cache") || !ogs_strcasecmp(op, "no-store")) {
-            ret = 0;
-            break;
-        } else if (!ogs_strncasecmp(op, "max-age=", 8)) {
-            ret = atoi(op+8);
-        }
-    }
-    ogs_free(value);
-    return ret;
+    return policy.fresh_until;
 }
 
 char *_uint32_to_hex_str(uint32_t val, int min_digits, int max_digits)
@@ -14,6 +14,8 @@
 #include "ogs-core.h"
 #include "ogs-sbi.h"
 
+#include "cache-policy.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -22,7 +24,6 @@ extern "C" {
 char *_sockaddr_string(const ogs_sockaddr_t *addr);
 char *_time_string(ogs_time_t t);
 ogs_time_t _response_to_expiry_time(ogs_sbi_response_t *message);
-ogs_time_t _cache_control_to_cache_age(const char *cache_control);
 char *_uint32_to_hex_str(uint32_t val, int min_digits, int max_digits);
 char *_uint64_to_hex_str(uint64_t val, int min_digits, int max_digits);
 char *_bitrate_to_str(double bitrate);
@@ -10,6 +10,7 @@ https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
 #include "ogs-core.h"
 
 #include "context.h"
+#include "pcf-request.h"
 #include "pcf-client.h"
 #include "pcf-client-sess.h"
 
@@ -21,6 +22,13 @@ static int pcf_context_prepare(void);
 static void pcf_notification_listener_add(const char *notification_listener_addr, const int port);
 static void pcf_notification_listener_remove_all(void);
 static void pcf_notification_listener_remove(pcf_notification_listener_t *pcf_notification_listen);
+static char *__connection_key(const ogs_sockaddr_t *pcf_address);
+static void __connection_free(pcf_connection_t *connection);
+static void __connections_remove_all(void);
+static char *__app_session_context_template_key(const char *af_app_id, const char *media_profile);
+static void __app_session_context_template_free(pcf_app_session_context_template_t *template);
+static void __app_session_context_templates_remove_expired(ogs_time_t now);
+static void __app_session_context_templates_remove_all(void);
 
 void pcf_context_init(void)
 {
@@ -34,6 +42,16 @@ void pcf_context_init(void)
     }
     ogs_list_init(&self->config.pcf_notification_listener_list);
     ogs_list_init(&self->pcf_sessions);
+    self->app_sessions_by_id = ogs_hash_make();
+    ogs_assert(self->app_sessions_by_id);
+    self->notification_servers = ogs_hash_make();
+    ogs_assert(self->notification_servers);
+    self->connections = ogs_hash_make();
+    ogs_assert(self->connections);
+    self->app_session_context_templates = ogs_hash_make();
+    ogs_assert(self->app_session_context_templates);
+    self->requests = ogs_hash_make();
+    ogs_assert(self->requests);
 }
 
 void pcf_context_final(void)
@@ -41,6 +59,14 @@ void pcf_context_final(void)
     ogs_assert(self);
     pcf_notification_listener_remove_all();
     pcf_session_remove_all();
+    ogs_hash_destroy(self->requests);
+    __connections_remove_all();
+    ogs_hash_destroy(self->connections);
+    __app_session_context_templates_remove_all();
+    ogs_hash_destroy(self->app_session_context_templates);
+    ogs_hash_destroy(self->notification_servers);
+    ogs_hash_destroy(self->app_sessions_by_id);
+    if (self->app_session_handles.slots) ogs_free(self->app_session_handles.slots);
     ogs_free(self);
     self = NULL;
 }
@@ -267,30 +293,261 @@ bool pcf_parse_config(const char *local)
     return OGS_OK;
 }
 
-pcf_app_session_t *_pcf_client_context_active_sessions_exists(pcf_app_session_t *app_sess) {
-    pcf_session_t *session;
-    pcf_app_session_t *sess, *next = NULL;
+/* Returns app_sess if it is still live and has been created on the PCF */
+pcf_app_session_t *_pcf_client_context_active_sessions_exists(pcf_app_session_t *app_sess)
+{
+    if (!app_sess || !app_sess->pcf_app_session_id) return NULL;
 
-    if(app_sess->pcf_session) {
-        session = app_sess->pcf_session;
-        ogs_assert(session);
-    }
+    if (_pcf_client_context_app_session_find_by_id(app_sess->pcf_app_session_id) != app_sess) return NULL;
+
+    return app_sess;
+}
 
-    ogs_list_for_each_safe(&session->pcf_app_sessions, next, sess){
-        if(!strcmp(app_sess->pcf_app_session_id, sess->pcf_app_session_id)){
-            break;
+/* Give app_sess a handle, reusing a free slot before growing the table */
+void _pcf_client_context_app_session_add(pcf_app_session_t *app_sess)
+{
+    pcf_app_session_slot_t *slot;
+    size_t index;
+
+    if (self->app_session_handles.free) {
+        index = self->app_session_handles.free - 1;
+        slot = &self->app_session_handles.slots[index];
+        self->app_session_handles.free = slot->next_free;
+    } else {
+        if (self->app_session_handles.used == self->app_session_handles.size) {
+            size_t size = self->app_session_handles.size ? self->app_session_handles.size * 2 : 64;
+
+            ogs_assert(size <= PCF_APP_SESSION_HANDLE_INDEX_MASK);
+            self->app_session_handles.slots = ogs_realloc(self->app_session_handles.slots, size * sizeof(pcf_app_session_slot_t));
+            ogs_assert(self->app_session_handles.slots);
+            memset(&self->app_session_handles.slots[self->app_session_handles.size], 0,
+                    (size - self->app_session_handles.size) * sizeof(pcf_app_session_slot_t));
+            self->app_session_handles.size = size;
         }
+        index = self->app_session_handles.used++;
+        slot = &self->app_session_handles.slots[index];
+        slot->generation = 1;
+    }
+
+    slot->app_sess = app_sess;
+    slot->next_free = 0;
+    app_sess->handle = (slot->generation << PCF_APP_SESSION_HANDLE_INDEX_BITS) | (uintptr_t)(index + 1);
+}
+
+void _pcf_client_context_app_session_remove(pcf_app_session_t *app_sess)
+{
+    pcf_app_session_slot_t *slot;
+    size_t index;
+
+    _pcf_client_context_app_session_id_set(app_sess, NULL);
+
+    if (_pcf_client_context_app_session_find_by_handle(app_sess->handle) != app_sess) return;
+
+    index = (app_sess->handle & PCF_APP_SESSION_HANDLE_INDEX_MASK) - 1;
+    slot = &self->app_session_handles.slots[index];
+    slot->app_sess = NULL;
+    /* generation 0 is never handed out, so wrap from the largest one to 1 */
+    slot->generation = (slot->generation + 1) & (UINTPTR_MAX >> PCF_APP_SESSION_HANDLE_INDEX_BITS);
+    if (!slot->generation) slot->generation = 1;
+    slot->next_free = self->app_session_handles.free;
+    self->app_session_handles.free = index + 1;
+    app_sess->handle = 0;
+}
+
+pcf_app_session_t *_pcf_client_context_app_session_find_by_handle(uintptr_t handle)
+{
+    uintptr_t index = handle & PCF_APP_SESSION_HANDLE_INDEX_MASK;
+    pcf_app_session_slot_t *slot;
+
+    if (!self || !index || index > self->app_session_handles.used) return NULL;
 
+    slot = &self->app_session_handles.slots[index - 1];
+    if (!slot->app_sess || slot->generation != handle >> PCF_APP_SESSION_HANDLE_INDEX_BITS) return NULL;
+
+    return slot->app_sess;
+}
+
+pcf_app_session_t *_pcf_client_context_app_session_find_by_id(const char *pcf_app_session_id)
+{
+    if (!self || !pcf_app_session_id) return NULL;
+
+    return (pcf_app_session_t*)ogs_hash_get(self->app_sessions_by_id, pcf_app_session_id, OGS_HASH_KEY_STRING);
+}
+
+/* Set (or clear with NULL) the AppSession id the PCF gave app_sess, keeping the id index up to date */
+bool _pcf_client_context_app_session_id_set(pcf_app_session_t *app_sess, const char *pcf_app_session_id)
+{
+    if (!app_sess) return false;
+
+    if (app_sess->pcf_app_session_id) {
+        if (ogs_hash_get(pcf_self()->app_sessions_by_id, app_sess->pcf_app_session_id, OGS_HASH_KEY_STRING) == app_sess)
+            ogs_hash_set(pcf_self()->app_sessions_by_id, app_sess->pcf_app_session_id, OGS_HASH_KEY_STRING, NULL);
+        ogs_free(app_sess->pcf_app_session_id);
+        app_sess->pcf_app_session_id = NULL;
+    }
+
+    if (pcf_app_session_id) {
+        app_sess->pcf_app_session_id = ogs_strdup(pcf_app_session_id);
+        ogs_assert(app_sess->pcf_app_session_id);
+        /* the hash keeps the first key pointer it was given, so drop any old mapping to key on our copy */
+        if (ogs_hash_get(pcf_self()->app_sessions_by_id, app_sess->pcf_app_session_id, OGS_HASH_KEY_STRING))
+            ogs_hash_set(pcf_self()->app_sessions_by_id, app_sess->pcf_app_session_id, OGS_HASH_KEY_STRING, NULL);
+        ogs_hash_set(pcf_self()->app_sessions_by_id, app_sess->pcf_app_session_id, OGS_HASH_KEY_STRING, app_sess);
     }
 
-   if(sess)
-   {
-       return sess;
-   }
-    return NULL;
+    return true;
+}
+
+/* Index pcf_session by its notification server, the key is stored in pcf_session->notif_server */
+void _pcf_client_context_notification_server_add(pcf_session_t *pcf_session)
+{
+    ogs_hash_set(self->notification_servers, &pcf_session->notif_server, sizeof(pcf_session->notif_server), pcf_session);
+}
+
+void _pcf_client_context_notification_server_remove(pcf_session_t *pcf_session)
+{
+    if (!self || !pcf_session->notif_server) return;
+
+    if (_pcf_client_context_notification_server_find(pcf_session->notif_server) == pcf_session)
+        ogs_hash_set(self->notification_servers, &pcf_session->notif_server, sizeof(pcf_session->notif_server), NULL);
+}
+
+/* Returns NULL if server isn't one of our notification servers */
+pcf_session_t *_pcf_client_context_notification_server_find(ogs_sbi_server_t *server)
+{
+    if (!self || !server) return NULL;
+
+    return (pcf_session_t*)ogs_hash_get(self->notification_servers, &server, sizeof(server));
+}
 
+/* Give request the next id and index it, the key is stored in request->id */
+void _pcf_client_context_request_add(pcf_request_t *request)
+{
+    request->id = ++self->next_request_id;
+    ogs_hash_set(self->requests, &request->id, sizeof(request->id), request);
 }
 
+void _pcf_client_context_request_remove(pcf_request_t *request)
+{
+    if (!self || !request->id) return;
+
+    ogs_hash_set(self->requests, &request->id, sizeof(request->id), NULL);
+    request->id = 0;
+}
+
+/* Returns NULL if id isn't a request of ours still queued or awaiting a response */
+pcf_request_t *_pcf_client_context_request_find(uintptr_t id)
+{
+    if (!self || !id) return NULL;
+
+    return (pcf_request_t*)ogs_hash_get(self->requests, &id, sizeof(id));
+}
+
+/* Find or create the shared connection to the PCF at pcf_address, returns NULL if a client can't be created */
+pcf_connection_t *_pcf_client_context_connection_ref(const ogs_sockaddr_t *pcf_address)
+{
+    pcf_connection_t *connection;
+    char *key;
+
+    if (!self || !pcf_address) return NULL;
+
+    key = __connection_key(pcf_address);
+    connection = ogs_hash_get(self->connections, key, OGS_HASH_KEY_STRING);
+    if (connection) {
+        ogs_free(key);
+        connection->ref_count++;
+        return connection;
+    }
+
+    connection = ogs_calloc(1, sizeof(*connection));
+    ogs_assert(connection);
+    connection->key = key;
+    ogs_copyaddrinfo(&connection->pcf_addr, pcf_address);
+    connection->client = ogs_sbi_client_add(OpenAPI_uri_scheme_http, NULL, 0,
+                                            (connection->pcf_addr->ogs_sa_family == AF_INET)?connection->pcf_addr:NULL,
+                                            (connection->pcf_addr->ogs_sa_family == AF_INET6)?connection->pcf_addr:NULL);
+    if (!connection->client) {
+        __connection_free(connection);
+        return NULL;
+    }
+    connection->ref_count = 1;
+
+    ogs_hash_set(self->connections, connection->key, OGS_HASH_KEY_STRING, connection);
+
+    return connection;
+}
+
+/* Drop a reference to a shared PCF connection, the client is removed when the last reference goes */
+void _pcf_client_context_connection_unref(pcf_connection_t *connection)
+{
+    if (!connection) return;
+
+    if (--connection->ref_count) return;
+
+    if (self) ogs_hash_set(self->connections, connection->key, OGS_HASH_KEY_STRING, NULL);
+    __connection_free(connection);
+}
+
+/* Cache the serialised AscReqData members shared by every UE with this AF application and media profile, along
+ * with the medComponents map they contain. Returns NULL if the cache is full.
+ */
+const pcf_app_session_context_template_t *_pcf_app_session_context_add(const char *af_app_id, const char *media_profile,
+                                                                        const char *asc_req_data_members,
+                                                                        const cJSON *med_components, ogs_time_t expires)
+{
+    pcf_app_session_context_template_t *template;
+    char *key;
+
+    if (!self || !media_profile || !asc_req_data_members || !med_components) return NULL;
+
+    key = __app_session_context_template_key(af_app_id, media_profile);
+
+    template = ogs_hash_get(self->app_session_context_templates, key, OGS_HASH_KEY_STRING);
+    if (template) {
+        ogs_hash_set(self->app_session_context_templates, template->key, OGS_HASH_KEY_STRING, NULL);
+        __app_session_context_template_free(template);
+    } else if (ogs_hash_count(self->app_session_context_templates) >= PCF_APP_SESSION_CONTEXT_TEMPLATES_MAX) {
+        __app_session_context_templates_remove_expired(ogs_time_now());
+        if (ogs_hash_count(self->app_session_context_templates) >= PCF_APP_SESSION_CONTEXT_TEMPLATES_MAX) {
+            ogs_free(key);
+            return NULL;
+        }
+    }
+
+    template = ogs_calloc(1, sizeof(*template));
+    ogs_assert(template);
+    template->key = key;
+    template->asc_req_data_members = ogs_strdup(asc_req_data_members);
+    ogs_assert(template->asc_req_data_members);
+    template->med_components = cJSON_Duplicate(med_components, 1);
+    ogs_assert(template->med_components);
+    template->expires = expires;
+
+    ogs_hash_set(self->app_session_context_templates, template->key, OGS_HASH_KEY_STRING, template);
+
+    return template;
+}
+
+/* Returns NULL if there is no template for this AF application and media profile or it has expired */
+const pcf_app_session_context_template_t *_pcf_app_session_context_from_cache(const char *af_app_id, const char *media_profile)
+{
+    pcf_app_session_context_template_t *template;
+    char *key;
+
+    if (!self || !media_profile) return NULL;
+
+    key = __app_session_context_template_key(af_app_id, media_profile);
+    template = ogs_hash_get(self->app_session_context_templates, key, OGS_HASH_KEY_STRING);
+    ogs_free(key);
+
+    if (template && template->expires <= ogs_time_now()) {
+        ogs_hash_set(self->app_session_context_templates, template->key, OGS_HASH_KEY_STRING, NULL);
+        __app_session_context_template_free(template);
+        template = NULL;
+    }
+
+    return template;
+}
 
 static void pcf_notification_listener_add(const char *notification_listener_addr, const int port) {
     pcf_notification_listener_t *pcf_notification_listen;
@@ -318,3 +575,77 @@ static void pcf_notification_listener_remove(pcf_notification_listener_t *pcf_no
     ogs_free(pcf_notification_listen);
 }
 
+static char *__app_session_context_template_key(const char *af_app_id, const char *media_profile)
+{
+    char *key = ogs_msprintf("%s\n%s", af_app_id ? af_app_id : "", media_profile);
+    ogs_assert(key);
+    return key;
+}
+
+static void __app_session_context_template_free(pcf_app_session_context_template_t *template)
+{
+    ogs_free(template->key);
+    ogs_free(template->asc_req_data_members);
+    cJSON_Delete(template->med_components);
+    ogs_free(template);
+}
+
+static void __app_session_context_templates_remove_expired(ogs_time_t now)
+{
+    ogs_hash_index_t *hi, *next;
+
+    for (hi = ogs_hash_first(self->app_session_context_templates); hi; hi = next) {
+        pcf_app_session_context_template_t *template = ogs_hash_this_val(hi);
+
+        next = ogs_hash_next(hi);
+        if (template->expires > now) continue;
+        ogs_hash_set(self->app_session_context_templates, template->key, OGS_HASH_KEY_STRING, NULL);
+        __app_session_context_template_free(template);
+    }
+}
+
+static void __app_session_context_templates_remove_all(void)
+{
+    ogs_hash_index_t *hi, *next;
+
+    for (hi = ogs_hash_first(self->app_session_context_templates); hi; hi = next) {
+        pcf_app_session_context_template_t *template = ogs_hash_this_val(hi);
+
+        next = ogs_hash_next(hi);
+        ogs_hash_set(self->app_session_context_templates, template->key, OGS_HASH_KEY_STRING, NULL);
+        __app_session_context_template_free(template);
+    }
+}
+
+static char *__connection_key(const ogs_sockaddr_t *pcf_address)
+{
+    char addr[OGS_ADDRSTRLEN];
+    char *key;
+
+    OGS_ADDR((ogs_sockaddr_t*)pcf_address, addr);
+    key = ogs_msprintf("%s|%i", addr, OGS_PORT(pcf_address));
+    ogs_assert(key);
+
+    return key;
+}
+
+static void __connection_free(pcf_connection_t *connection)
+{
+    if (connection->client) ogs_sbi_client_remove(connection->client);
+    if (connection->pcf_addr) ogs_freeaddrinfo(connection->pcf_addr);
+    ogs_free(connection->key);
+    ogs_free(connection);
+}
+
+static void __connections_remove_all(void)
+{
+    ogs_hash_index_t *hi, *next;
+
+    for (hi = ogs_hash_first(self->connections); hi; hi = next) {
+        pcf_connection_t *connection = ogs_hash_this_val(hi);
+
+        next = ogs_hash_next(hi);
+        ogs_hash_set(self->connections, connection->key, OGS_HASH_KEY_STRING, NULL);
+        __connection_free(connection);
+    }
+}
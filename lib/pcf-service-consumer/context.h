@@ -25,6 +25,7 @@ extern int __pcf_log_domain;
 typedef struct ue_network_identifier_s ue_network_identifier_t;
 typedef struct pcf_session_s pcf_session_t;
 typedef struct pcf_app_session_s pcf_app_session_t;
+typedef struct pcf_request_s pcf_request_t;
 
 typedef struct pcf_notification_listener_s {
     ogs_lnode_t   node;	
@@ -38,18 +39,80 @@ typedef struct pcf_configuration_s {
 } pcf_configuration_t;
 
 
+/* An AppSession handle is a slot index + 1 in the low half and the slot generation in the high half, so
+ * a handle for a freed AppSession never resolves, even once its slot or address is reused.
+ */
+#define PCF_APP_SESSION_HANDLE_INDEX_BITS (sizeof(uintptr_t) * 4)
+#define PCF_APP_SESSION_HANDLE_INDEX_MASK (((uintptr_t)1 << PCF_APP_SESSION_HANDLE_INDEX_BITS) - 1)
+
+typedef struct pcf_app_session_slot_s {
+    pcf_app_session_t *app_sess;  // NULL while the slot is free
+    uintptr_t          generation; // never 0, bumped each time the slot is freed
+    size_t             next_free;  // index + 1 of the next free slot, 0 at the end of the free list
+} pcf_app_session_slot_t;
+
+/* One SBI client (and so one HTTP/2 connection) per PCF address, shared by every pcf_session_t for that PCF */
+typedef struct pcf_connection_s {
+    char             *key;       // PCF address and port
+    size_t            ref_count; // pcf_session_t objects using this connection
+    ogs_sockaddr_t   *pcf_addr;
+    ogs_sbi_client_t *client;
+} pcf_connection_t;
+
+/* How long an AppSessionContext template is kept and the most templates kept at once */
+#define PCF_APP_SESSION_CONTEXT_TEMPLATE_TTL 300
+#define PCF_APP_SESSION_CONTEXT_TEMPLATES_MAX 1024
+
+/* The parts of an AppSessionContext request shared by every UE with the same AF application and media
+ * profile, already validated and serialised. The media profile is the identifier the library user gives
+ * for a set of media components.
+ */
+typedef struct pcf_app_session_context_template_s {
+    char       *key;                  // af_app_id and media profile
+    char       *asc_req_data_members; // JSON members of the AscReqData object, without the enclosing braces
+    cJSON      *med_components;       // the medComponents map in asc_req_data_members, an empty object if none
+    ogs_time_t  expires;
+} pcf_app_session_context_template_t;
+
 typedef struct pcf_context_s {
     pcf_configuration_t config;
     ogs_list_t          pcf_sessions; // Nodes of this list are of type pcf_session_t *
+    struct {
+        pcf_app_session_slot_t *slots; // every live AppSession, by handle
+        size_t                  size;  // slots allocated
+        size_t                  used;  // slots handed out so far
+        size_t                  free;  // index + 1 of the first free slot, 0 if none
+    } app_session_handles;
+    ogs_hash_t         *app_sessions_by_id; // pcf_app_session_id => pcf_app_session_t *, AppSessions the PCF has created
+    ogs_hash_t         *notification_servers; // ogs_sbi_server_t * => pcf_session_t *, the session owning each notification server
+    ogs_hash_t         *connections; // pcf_connection_t.key => pcf_connection_t *
+    ogs_hash_t         *app_session_context_templates; // pcf_app_session_context_template_t.key => pcf_app_session_context_template_t *
+    ogs_hash_t         *requests; // pcf_request_t.id => pcf_request_t *, every request queued or awaiting a response
+    uintptr_t           next_request_id; // ids are never reused, so a response to a forgotten request is recognised
 } pcf_context_t;
 
 extern void pcf_context_init(void);
 extern void pcf_context_final(void);
 extern pcf_context_t *pcf_self(void);
 extern bool pcf_parse_config(const char *local);
-extern bool _pcf_app_session_context_add(const char *af_app_id, const OpenAPI_app_session_context_t *app_session_context, ogs_time_t expires);
-OpenAPI_app_session_context_t *_pcf_app_session_context_from_cache(const char *af_app_id);
+extern const pcf_app_session_context_template_t *_pcf_app_session_context_add(const char *af_app_id, const char *media_profile,
+                                                                              const char *asc_req_data_members,
+                                                                              const cJSON *med_components, ogs_time_t expires);
+const pcf_app_session_context_template_t *_pcf_app_session_context_from_cache(const char *af_app_id, const char *media_profile);
 pcf_app_session_t *_pcf_client_context_active_sessions_exists(pcf_app_session_t *app_sess);
+void _pcf_client_context_app_session_add(pcf_app_session_t *app_sess);
+void _pcf_client_context_app_session_remove(pcf_app_session_t *app_sess);
+pcf_app_session_t *_pcf_client_context_app_session_find_by_handle(uintptr_t handle);
+pcf_app_session_t *_pcf_client_context_app_session_find_by_id(const char *pcf_app_session_id);
+bool _pcf_client_context_app_session_id_set(pcf_app_session_t *app_sess, const char *pcf_app_session_id);
+pcf_connection_t *_pcf_client_context_connection_ref(const ogs_sockaddr_t *pcf_address);
+void _pcf_client_context_connection_unref(pcf_connection_t *connection);
+void _pcf_client_context_notification_server_add(pcf_session_t *pcf_session);
+void _pcf_client_context_notification_server_remove(pcf_session_t *pcf_session);
+pcf_session_t *_pcf_client_context_notification_server_find(ogs_sbi_server_t *server);
+void _pcf_client_context_request_add(pcf_request_t *request);
+void _pcf_client_context_request_remove(pcf_request_t *request);
+pcf_request_t *_pcf_client_context_request_find(uintptr_t id);
 
 
 
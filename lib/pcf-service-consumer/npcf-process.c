@@ -17,12 +17,16 @@ https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
 
 #include "npcf-process.h"
 #include "pcf-handler.h"
+#include "pcf-bulk-create.h"
+#include "pcf-request.h"
+#include "pcf-build.h"
 
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+static void __retries_exhausted(pcf_app_session_t *sess, pcf_request_operation_t operation);
 static const char *_event_get_name(ogs_event_t *e);
 
 bool _pcf_process_event(ogs_event_t *e)
@@ -41,7 +45,6 @@ bool _pcf_process_event(ogs_event_t *e)
                 ogs_sbi_message_t message;
                 ogs_sbi_stream_t *stream = e->sbi.data;
                 ogs_sbi_server_t *server;
-                pcf_session_t *pcf_session;
 
                 ogs_assert(request);
                 ogs_assert(stream);
@@ -50,14 +53,7 @@ bool _pcf_process_event(ogs_event_t *e)
                 ogs_assert(server);
 
                 /* Check this event is from one of our notification servers */
-                rv = 0;
-                ogs_list_for_each(&pcf_self()->pcf_sessions, pcf_session) {
-                    if (_pcf_session_has_notification_server(pcf_session, server)) {
-                        rv = 1;
-                        break;
-                    }
-                }
-                if (!rv) {
+                if (!_pcf_session_find_by_notification_server(server)) {
                     /* This didn't come in on one of our notification servers so ignore it */
                     return false;
                 }
@@ -78,18 +74,35 @@ bool _pcf_process_event(ogs_event_t *e)
                             CASE("app-session-instance")
                                 if (message.h.resource.component[1]) {
                                     char *endptr = NULL;
-                                    uintptr_t instance_id;
+                                    uintptr_t handle;
 
-                                    instance_id = (uintptr_t)strtoull(message.h.resource.component[1], &endptr, 0);
-                                    if (endptr && *endptr == '\0') {
-                                        pcf_app_session_t *app_session = (pcf_app_session_t*)instance_id;
-                                        /* check if app_session is a valid pcf_app_session_t pointer by checking registered ones */
-                                        if (_pcf_app_session_exists(app_session)) {
+                                    handle = (uintptr_t)strtoull(message.h.resource.component[1], &endptr, 16);
+                                    if (endptr && endptr != message.h.resource.component[1] && *endptr == '\0') {
+                                        /* a stale handle won't resolve, even if its slot has been reused */
+                                        pcf_app_session_t *app_session = _pcf_app_session_find_by_handle(handle);
+                                        if (app_session) {
                                             if (message.h.resource.component[2] &&
                                                 !strcmp(message.h.resource.component[2], "notify")) {
                                                 /* process notifications */
                                                 OpenAPI_events_notification_t *notifications;
                                                 cJSON *json;
+                                                int events_mask;
+
+                                                /* most notifications are for events no callback wants, acknowledge
+                                                 * those without building the cJSON and OpenAPI trees */
+                                                if (request->http.content &&
+                                                    _events_notification_prescan(request->http.content,
+                                                                                 request->http.content_length,
+                                                                                 &events_mask) &&
+                                                    !(events_mask & _pcf_app_session_notification_events_mask(app_session))) {
+                                                    ogs_sbi_response_t *response;
+
+                                                    ogs_debug("No callback wants PCF notification events 0x%x", events_mask);
+                                                    response = ogs_sbi_build_response(&message, OGS_SBI_HTTP_STATUS_NO_CONTENT);
+                                                    ogs_assert(response);
+                                                    ogs_assert(true == ogs_sbi_server_send_response(stream, response));
+                                                    break;
+                                                }
 
                                                 json = cJSON_Parse(request->http.content);
                                                 if (!json) {
@@ -133,7 +146,7 @@ bool _pcf_process_event(ogs_event_t *e)
                                                 ogs_free(err);
                                             }
                                         } else {
-                                            char *err = ogs_msprintf("Session instance %p does not exist", app_session);
+                                            char *err = ogs_msprintf("Session instance %s does not exist", message.h.resource.component[1]);
                                             ogs_warn("%s", err);
                                             ogs_assert(true == ogs_sbi_server_send_error(stream, OGS_SBI_HTTP_STATUS_NOT_FOUND,
                                                        &message, "Not found", err, NULL));
@@ -193,15 +206,41 @@ bool _pcf_process_event(ogs_event_t *e)
         case OGS_EVENT_SBI_CLIENT:
         {
             int rv;
-            pcf_app_session_t *sess = e->sbi.data;
+            pcf_request_t *pcf_request = _pcf_request_find((uintptr_t)e->sbi.data);
+            pcf_request_operation_t operation;
+            pcf_request_result_t result;
+            uintptr_t request_id;
+            pcf_app_session_t *sess;
             ogs_sbi_response_t *response = e->sbi.response;
             ogs_sbi_message_t message;
 
-            if (!_pcf_app_session_exists(sess)) {
+            if (!pcf_request) {
                 /* not one of our client messages, ignore */
                 return false;
             }
 
+            operation = pcf_request->operation;
+            request_id = pcf_request->id;
+            result = _pcf_request_check_response(pcf_request, e->sbi.state, response);
+            if (result == PCF_REQUEST_RESULT_RETRYING) {
+                if (response) ogs_sbi_response_free(response);
+                return true;
+            }
+
+            /* free the request's slot before handling, the handlers may send more */
+            sess = _pcf_app_session_find_by_handle(_pcf_request_finished(pcf_request));
+            if (!sess) {
+                /* the AppSession has gone since the request was sent */
+                if (response) ogs_sbi_response_free(response);
+                return true;
+            }
+
+            if (result == PCF_REQUEST_RESULT_GAVE_UP) {
+                __retries_exhausted(sess, operation);
+                if (response) ogs_sbi_response_free(response);
+                return true;
+            }
+
             switch (e->sbi.state) {
             case OGS_OK:
                 /* normal operation - deal with the client response */
@@ -221,8 +260,6 @@ bool _pcf_process_event(ogs_event_t *e)
                     CASE(OGS_SBI_RESOURCE_NAME_APP_SESSIONS)
                         if (message.h.resource.component[1]) {
                             /* URL: .../app-session/<id>... */
-                            sess = e->sbi.data;
-                            ogs_assert(sess);
                             if (message.h.resource.component[2]) {
                                 /* URL: .../app-session/<id>/<subresource> */
                                 SWITCH(message.h.resource.component[2])
@@ -241,9 +278,13 @@ bool _pcf_process_event(ogs_event_t *e)
                                 /* URL: .../app-session/<id> */
                                 SWITCH(message.h.method)
                                 CASE(OGS_SBI_HTTP_METHOD_PATCH)
-                                    if (message.res_status == OGS_SBI_HTTP_STATUS_OK) {
-                                        pcf_policyauthorization_update(sess, &message);
+                                    if (message.res_status == OGS_SBI_HTTP_STATUS_OK ||
+                                        message.res_status == OGS_SBI_HTTP_STATUS_NO_CONTENT) {
+                                        if (sess) _pcf_app_session_media_components_answered(sess, request_id, true);
+                                        /* only a 200 carries the updated context, a 204 just acknowledges */
+                                        if (sess && response->http.content) pcf_policyauthorization_update(sess, &message);
 				    } else {
+                                        if (sess) _pcf_app_session_media_components_answered(sess, request_id, false);
                                         ogs_error("HTTP response error [%d]", message.res_status);
                                     }
                                     break;
@@ -258,6 +299,10 @@ bool _pcf_process_event(ogs_event_t *e)
                                 if (message.res_status == OGS_SBI_HTTP_STATUS_CREATED) {
                                     ogs_debug("message.res_status == OGS_SBI_HTTP_STATUS_CREATED");
                                     pcf_policyauthorization_create(sess, &message, response);
+                                    /* a batch create is still waiting if the response couldn't be used */
+                                    _pcf_bulk_create_item_finished(sess, false);
+                                    /* no AppSessionId, so nothing can reach this AppSession at the PCF */
+                                    if (sess && !sess->pcf_app_session_id) pcf_app_sess_remove(sess);
                                     ogs_debug("taking event for OGS_EVENT_SBI_CLIENT");
                                 } else if (message.res_status == OGS_SBI_HTTP_STATUS_NOT_FOUND) {
                                     ogs_error("UE address not known by the PCF");
@@ -291,10 +336,6 @@ bool _pcf_process_event(ogs_event_t *e)
                 ogs_debug("App shutting down client request aborted - destroying app session");
                 if (sess) pcf_app_sess_remove(sess);
                 break;
-            case OGS_TIMEUP:
-                /* Client request took too long - leave state */
-                ogs_warn("Timeout connecting to the client - app session unchanged");
-                break;
             default:
                 /* Some other error happened - client request failed */
                 ogs_debug("OGS_EVENT_SBI_CLIENT: SBI client response state = %i", e->sbi.state);
@@ -317,6 +358,23 @@ bool _pcf_process_event(ogs_event_t *e)
     return false;    
 }
 
+/* A request to the PCF kept failing, the AppSession can no longer be trusted so report it as failed and remove it */
+static void __retries_exhausted(pcf_app_session_t *sess, pcf_request_operation_t operation)
+{
+    ogs_error("Giving up on %s request for AppSessionContext [%s]", _pcf_request_operation_name(operation),
+              sess->pcf_app_session_id ? sess->pcf_app_session_id : "not created");
+
+    if ((operation == PCF_REQUEST_OPERATION_UPDATE || operation == PCF_REQUEST_OPERATION_SUBSCRIBE) &&
+            sess->pcf_app_session_id) {
+        /* the PCF may still hold the AppSessionContext, ask for it to be released */
+        if (!_pcf_session_send_request(sess->pcf_session, pcf_policyauthorization_request_delete(sess), sess->handle,
+                                       PCF_REQUEST_OPERATION_DELETE))
+            ogs_error("Failed to release AppSessionContext [%s]", sess->pcf_app_session_id);
+    }
+
+    pcf_app_sess_remove(sess);
+}
+
 static const char *_event_get_name(ogs_event_t *e)
 {
     if (e->id < OGS_MAX_NUM_OF_PROTO_EVENT)
@@ -14,13 +14,15 @@
 #include "pcf-build.h"
 #include "pcf-evsubsc.h"
 
-static void media_components_free(OpenAPI_list_t *MediaComponentList);
 static void events_free(OpenAPI_list_t *EventList);
+static const char *__media_components_af_app_id(OpenAPI_list_t *media_component);
+static char *__media_components_text(const cJSON *med_components);
+static char *__asc_req_data_shared_members(const OpenAPI_app_session_context_req_data_t *asc_req_data, const char *med_components_text);
+static char *__asc_req_data_text(OpenAPI_app_session_context_req_data_t *asc_req_data, const char *shared_members);
 
 ogs_sbi_request_t *pcf_policyauthorization_request_create(
-        pcf_app_session_t *sess, OpenAPI_list_t *media_component, int events)
+        pcf_app_session_t *sess, const char *media_profile, OpenAPI_list_t *media_component, int events)
 {
-    ogs_sbi_message_t message;
     ogs_sbi_request_t *request = NULL;
     char pcf_ipv4addr[OGS_ADDRSTRLEN];
     int pcf_port;
@@ -31,29 +33,16 @@ ogs_sbi_request_t *pcf_policyauthorization_request_create(
 
     OpenAPI_app_session_context_t AppSessionContext;
     OpenAPI_app_session_context_req_data_t AscReqData;
-    cJSON *app_sess_context;
-    cJSON *asc_req_data;
-    char *app_sess_context_text;
-    char *asc_req_data_text;
+    const pcf_app_session_context_template_t *template;
+    const char *af_app_id;
+    cJSON *med_components;
+    char *asc_req_data_text = NULL;
 
     ogs_assert(sess);
 
     OGS_ADDR(sess->pcf_session->pcf_addr, pcf_ipv4addr);
     pcf_port = OGS_PORT(sess->pcf_session->pcf_addr);
 
-    memset(&message, 0, sizeof(message));
-    message.h.method = (char *)OGS_SBI_HTTP_METHOD_POST;
-    message.h.service.name =
-        (char *)OGS_SBI_SERVICE_NAME_NPCF_POLICYAUTHORIZATION;
-    message.h.api.version = (char *)OGS_SBI_API_V1;
-    message.h.resource.component[0] =
-        (char *)OGS_SBI_RESOURCE_NAME_APP_SESSIONS;
-
-    message.param.ipv4addr = pcf_ipv4addr;
-    
-    message.h.uri = ogs_msprintf("http://%s:%i/npcf-policyauthorization/v1/app-sessions", pcf_ipv4addr, pcf_port);
-    message.AppSessionContext = &AppSessionContext;
-
     memset(&AppSessionContext, 0, sizeof(AppSessionContext));
     AppSessionContext.asc_req_data = &AscReqData;
 
@@ -62,8 +51,6 @@ ogs_sbi_request_t *pcf_policyauthorization_request_create(
     AscReqData.notif_uri = ogs_strdup(_pcf_app_session_get_notif_url(sess));
     ogs_assert(AscReqData.notif_uri);
 
-    ogs_debug("\n PCF policy authorization create (Request header): \n Method: [%s] \n URI: [%s] \n Service Name: [%s] \n Resource Component: [%s]\n", message.h.method, message.h.uri, message.h.service.name, message.h.resource.component[0]); 
-
     AscReqData.supp_feat =
         ogs_uint64_to_string(sess->policyauthorization_features);
     ogs_assert(AscReqData.supp_feat);
@@ -93,29 +80,68 @@ ogs_sbi_request_t *pcf_policyauthorization_request_create(
 
     AscReqData.res_prio = OpenAPI_reserv_priority_PRIO_16;
 
-    AscReqData.med_components = media_component;
-
+    /* the media components are kept as JSON for the AppSession below, so they are left out of this copy */
     if(!_pcf_client_requested_app_sess_context_set(sess, &AppSessionContext))
         ogs_error("Failed to store the requested app session context");
-    
-    app_sess_context = OpenAPI_app_session_context_convertToJSON(sess->pcf_app_session_context_requested);
-    
-    app_sess_context_text = cJSON_Print(app_sess_context);
-    ogs_debug("app_sess_context_text: %s", app_sess_context_text);
-    cJSON_Delete(app_sess_context);
-    cJSON_free(app_sess_context_text);
-    
-    asc_req_data = OpenAPI_app_session_context_req_data_convertToJSON(&AscReqData);
-    asc_req_data_text = cJSON_Print(asc_req_data);
-    ogs_debug("asc_req_data_text: %s", asc_req_data_text);
-    cJSON_Delete(asc_req_data);
-    cJSON_free(asc_req_data_text);
 
-    request = ogs_sbi_build_request(&message);
-    ogs_expect(request);
-    
-    ogs_free(message.h.uri);
- 
+    /* The media components, sponsoring status and reservation priority are the same for every UE using this
+     * AF application with the caller's media profile. A cached template holds them serialised and the medComponents
+     * map as JSON, so on a hit the media components aren't converted at all. They are only converted when there is
+     * no media profile or no template yet. */
+    af_app_id = __media_components_af_app_id(media_component);
+    template = media_profile ? _pcf_app_session_context_from_cache(af_app_id, media_profile) : NULL;
+    if (template) {
+        med_components = cJSON_Duplicate(template->med_components, 1);
+        ogs_assert(med_components);
+        asc_req_data_text = __asc_req_data_text(&AscReqData, template->asc_req_data_members);
+    } else {
+        char *med_components_text;
+        char *members;
+
+        med_components = _pcf_media_components_to_json(media_component);
+        if (!med_components) {
+            ogs_error("Invalid MediaComponent in AppSessionContext request");
+            goto end;
+        }
+        med_components_text = __media_components_text(med_components);
+        members = __asc_req_data_shared_members(&AscReqData, med_components_text);
+        ogs_free(med_components_text);
+
+        if (media_profile)
+            template = _pcf_app_session_context_add(af_app_id, media_profile, members, med_components,
+                                                    ogs_time_now() + ogs_time_from_sec(PCF_APP_SESSION_CONTEXT_TEMPLATE_TTL));
+        /* with no media profile, or the cache full, the members are used just this once */
+        asc_req_data_text = __asc_req_data_text(&AscReqData, template ? template->asc_req_data_members : members);
+        ogs_free(members);
+    }
+
+    /* the baseline for updates if the PCF doesn't say which media components it has */
+    _pcf_app_session_media_components_requested(sess, med_components);
+
+    if (!asc_req_data_text) {
+        ogs_error("Failed to build AscReqData for AppSessionContext request");
+        goto end;
+    }
+
+    request = ogs_sbi_request_new();
+    ogs_assert(request);
+    request->h.method = ogs_strdup(OGS_SBI_HTTP_METHOD_POST);
+    request->h.service.name = ogs_strdup(OGS_SBI_SERVICE_NAME_NPCF_POLICYAUTHORIZATION);
+    request->h.api.version = ogs_strdup(OGS_SBI_API_V1);
+    request->h.resource.component[0] = ogs_strdup(OGS_SBI_RESOURCE_NAME_APP_SESSIONS);
+    request->h.uri = ogs_msprintf("http://%s:%i/npcf-policyauthorization/v1/app-sessions", pcf_ipv4addr, pcf_port);
+    ogs_sbi_header_set(request->http.params, OGS_SBI_PARAM_IPV4ADDR, pcf_ipv4addr);
+
+    request->http.content = ogs_msprintf("{\"ascReqData\":%s}", asc_req_data_text);
+    ogs_assert(request->http.content);
+    request->http.content_length = strlen(request->http.content);
+    ogs_sbi_header_set(request->http.headers, "Content-Type", "application/json");
+
+    ogs_debug("\n PCF policy authorization create:\n Method: [%s]\n URI: [%s]\n JSON: %s\n", request->h.method, request->h.uri, request->http.content);
+
+    ogs_free(asc_req_data_text);
+
+end:
     if (AscReqData.notif_uri)
         ogs_free(AscReqData.notif_uri);
 
@@ -130,91 +156,47 @@ ogs_sbi_request_t *pcf_policyauthorization_request_create(
     if (sNssai.sd)
         ogs_free(sNssai.sd);
 
-    if(AscReqData.med_components)    
-        media_components_free(media_component);    
+    if(media_component)
+        _pcf_media_components_free(media_component);    
 
     return request;
 }
 
-ogs_sbi_request_t *pcf_policyauthorization_request_update(pcf_app_session_t *sess, OpenAPI_list_t *media_component)
+/* PATCH the AppSessionContext with a merge patch of the medComponents map */
+ogs_sbi_request_t *pcf_policyauthorization_request_update(pcf_app_session_t *sess, const cJSON *med_components_patch)
 {
-    ogs_sbi_message_t message;
-    ogs_sbi_request_t *request = NULL;
-    ogs_sbi_server_t *server = NULL;
-    ogs_sbi_header_t header;
+    ogs_sbi_request_t *request;
     char pcf_addr[OGS_ADDRSTRLEN];
     int pcf_port;
-
-    OpenAPI_app_session_context_update_data_patch_t AppSessionContextUpdateDataPatch;
-    OpenAPI_app_session_context_update_data_t AscUpdateData;
-
-    cJSON *app_sess_context;
-    cJSON *asc_update_data;
-    char *app_sess_context_text;
-    char *asc_update_data_text;
+    char *patch_text;
 
     if(!sess) return NULL;
-    if(!media_component) return NULL;
+    if(!sess->pcf_app_session_id) return NULL;
+    if(!med_components_patch) return NULL;
+
+    patch_text = cJSON_PrintUnformatted(med_components_patch);
+    if (!patch_text) return NULL;
 
     OGS_ADDR(sess->pcf_session->pcf_addr, pcf_addr);
     pcf_port = OGS_PORT(sess->pcf_session->pcf_addr);
 
-    memset(&message, 0, sizeof(message));
-    message.h.method = (char *)OGS_SBI_HTTP_METHOD_PATCH;
-    message.h.service.name = (char *)OGS_SBI_SERVICE_NAME_NPCF_POLICYAUTHORIZATION;
-    message.h.api.version = (char *)OGS_SBI_API_V1;
-    message.h.resource.component[0] = (char *)OGS_SBI_RESOURCE_NAME_APP_SESSIONS;
-    message.h.resource.component[1] = sess->pcf_app_session_id;
-
-    message.param.ipv4addr = pcf_addr;
-
-    message.h.uri = ogs_msprintf("http://%s:%i/npcf-policyauthorization/v1/app-sessions/%s", pcf_addr, pcf_port, sess->pcf_app_session_id);
-
-    message.AppSessionContextUpdateDataPatch = &AppSessionContextUpdateDataPatch;
-    memset(&AppSessionContextUpdateDataPatch, 0, sizeof(AppSessionContextUpdateDataPatch));
-
-    AppSessionContextUpdateDataPatch.asc_req_data = &AscUpdateData;
-    memset(&AscUpdateData, 0, sizeof(AscUpdateData));
-
-    server = ogs_list_first(&ogs_sbi_self()->server_list);
-    ogs_assert(server);
-
-    memset(&header, 0, sizeof(header));
-    header.service.name = (char *)OGS_SBI_SERVICE_NAME_NPCF_POLICYAUTHORIZATION;
-    header.api.version = (char *)OGS_SBI_API_V1;
-    header.resource.component[0] = (char *)OGS_SBI_RESOURCE_NAME_APP_SESSIONS;
-
-    ogs_debug("\n PCF policy authorization update (Request header): \n Method: [%s] \n URI: [%s] \n Service Name: [%s] \n Resource Component: [%s]\n", message.h.method, message.h.uri, header.service.name, message.h.resource.component[0]);
-
-    AscUpdateData.spon_status = OpenAPI_sponsoring_status_SPONSOR_DISABLED;
-
-    AscUpdateData.res_prio = OpenAPI_reserv_priority_PRIO_16;
-
-    AscUpdateData.med_components = media_component;
-
-    if(!_pcf_client_app_sess_context_updates_set(sess, &AppSessionContextUpdateDataPatch))
-        ogs_error("Failed to store the app session updates context");
-
-    app_sess_context = OpenAPI_app_session_context_update_data_patch_convertToJSON(sess->pcf_app_session_context_updates);
-
-    app_sess_context_text = cJSON_Print(app_sess_context);
-    ogs_debug("app_sess_context_text: %s", app_sess_context_text);
-    cJSON_Delete(app_sess_context);
-    cJSON_free(app_sess_context_text);
-
-    asc_update_data = OpenAPI_app_session_context_update_data_convertToJSON(&AscUpdateData);
-    asc_update_data_text = cJSON_Print(asc_update_data);
-    ogs_debug("asc_update_data_text: %s", asc_update_data_text);
-    cJSON_Delete(asc_update_data);
-    cJSON_free(asc_update_data_text);
-
-    request = ogs_sbi_build_request(&message);
-    ogs_expect(request);
-
-    ogs_free(message.h.uri);
-
-    if(AscUpdateData.med_components)
-        media_components_free(media_component);
+    request = ogs_sbi_request_new();
+    ogs_assert(request);
+    request->h.method = ogs_strdup(OGS_SBI_HTTP_METHOD_PATCH);
+    request->h.service.name = ogs_strdup(OGS_SBI_SERVICE_NAME_NPCF_POLICYAUTHORIZATION);
+    request->h.api.version = ogs_strdup(OGS_SBI_API_V1);
+    request->h.resource.component[0] = ogs_strdup(OGS_SBI_RESOURCE_NAME_APP_SESSIONS);
+    request->h.resource.component[1] = ogs_strdup(sess->pcf_app_session_id);
+    request->h.uri = ogs_msprintf("http://%s:%i/npcf-policyauthorization/v1/app-sessions/%s", pcf_addr, pcf_port, sess->pcf_app_session_id);
+    ogs_sbi_header_set(request->http.params, OGS_SBI_PARAM_IPV4ADDR, pcf_addr);
+
+    request->http.content = ogs_msprintf("{\"ascReqData\":{\"medComponents\":%s}}", patch_text);
+    ogs_assert(request->http.content);
+    request->http.content_length = strlen(request->http.content);
+    ogs_sbi_header_set(request->http.headers, "Content-Type", "application/merge-patch+json");
+    cJSON_free(patch_text);
+
+    ogs_debug("\n PCF policy authorization update:\n Method: [%s]\n URI: [%s]\n JSON: %s\n", request->h.method, request->h.uri, request->http.content);
 
     return request;
 }
@@ -423,7 +405,7 @@ static void events_free(OpenAPI_list_t *EventList){
 
 }
 
-static void media_components_free(OpenAPI_list_t *MediaComponentList){
+void _pcf_media_components_free(OpenAPI_list_t *MediaComponentList){
 
     OpenAPI_map_t *MediaComponentMap = NULL;
     OpenAPI_media_component_t *MediaComponent = NULL;
@@ -495,6 +477,65 @@ static void media_components_free(OpenAPI_list_t *MediaComponentList){
 
 }
 
+/* The medComponents map as a JSON object, NULL if a MediaComponent is invalid */
+cJSON *_pcf_media_components_to_json(OpenAPI_list_t *media_component)
+{
+    OpenAPI_lnode_t *node;
+    cJSON *json;
+
+    json = cJSON_CreateObject();
+    ogs_assert(json);
+    if (!media_component) return json;
+
+    OpenAPI_list_for_each(media_component, node) {
+        OpenAPI_map_t *map = node->data;
+        cJSON *item;
+
+        if (!map || !map->key || !map->value) {
+            cJSON_Delete(json);
+            return NULL;
+        }
+        item = OpenAPI_media_component_convertToJSON(map->value);
+        if (!item) {
+            cJSON_Delete(json);
+            return NULL;
+        }
+        cJSON_AddItemToObject(json, map->key, item);
+    }
+
+    return json;
+}
+
+/* The medComponents map of MediaComponentRm entries as a JSON object, a null entry removes that media component.
+ * NULL if a MediaComponentRm is invalid */
+cJSON *_pcf_media_components_rm_to_json(OpenAPI_list_t *media_component_rm)
+{
+    OpenAPI_lnode_t *node;
+    cJSON *json;
+
+    json = cJSON_CreateObject();
+    ogs_assert(json);
+    if (!media_component_rm) return json;
+
+    OpenAPI_list_for_each(media_component_rm, node) {
+        OpenAPI_map_t *map = node->data;
+        cJSON *item;
+
+        if (!map || !map->key) {
+            cJSON_Delete(json);
+            return NULL;
+        }
+        item = map->value ? OpenAPI_media_component_rm_convertToJSON(map->value) : cJSON_CreateNull();
+        if (!item) {
+            cJSON_Delete(json);
+            return NULL;
+        }
+        cJSON_AddItemToObject(json, map->key, item);
+    }
+
+    return json;
+}
+
 ogs_sbi_request_t *pcf_policyauthorization_request_delete(pcf_app_session_t *sess)
 {
     ogs_sbi_message_t message;
@@ -533,3 +574,82 @@ ogs_sbi_request_t *pcf_policyauthorization_request_delete(pcf_app_session_t *ses
     return request;
 }
 
+/* The AF application of the first MediaComponent, NULL if there is none */
+static const char *__media_components_af_app_id(OpenAPI_list_t *media_component)
+{
+    OpenAPI_map_t *map;
+
+    if (!media_component || !media_component->first) return NULL;
+
+    map = media_component->first->data;
+    if (!map || !map->value) return NULL;
+
+    return ((OpenAPI_media_component_t*)map->value)->af_app_id;
+}
+
+/* Serialise the medComponents map as it appears in the request, "" for no media components */
+static char *__media_components_text(const cJSON *med_components)
+{
+    char *text;
+    char *med_components_text;
+
+    if (!med_components->child) return ogs_strdup("");
+
+    text = cJSON_PrintUnformatted(med_components);
+    ogs_assert(text);
+
+    med_components_text = ogs_strdup(text);
+    ogs_assert(med_components_text);
+    cJSON_free(text);
+
+    return med_components_text;
+}
+
+/* The AscReqData members shared by every UE with these media components */
+static char *__asc_req_data_shared_members(const OpenAPI_app_session_context_req_data_t *asc_req_data, const char *med_components_text)
+{
+    char *members;
+
+    members = ogs_msprintf("%s%s%s\"sponStatus\":\"%s\",\"resPrio\":\"%s\"",
+                           *med_components_text ? "\"medComponents\":" : "", med_components_text, *med_components_text ? "," : "",
+                           OpenAPI_sponsoring_status_ToString(asc_req_data->spon_status),
+                           OpenAPI_reserv_priority_ToString(asc_req_data->res_prio));
+    ogs_assert(members);
+
+    return members;
+}
+
+/* Serialise the per UE members of asc_req_data and append the already serialised shared members */
+static char *__asc_req_data_text(OpenAPI_app_session_context_req_data_t *asc_req_data, const char *shared_members)
+{
+    OpenAPI_sponsoring_status_e spon_status = asc_req_data->spon_status;
+    OpenAPI_reserv_priority_e res_prio = asc_req_data->res_prio;
+    cJSON *json;
+    char *per_ue;
+    char *text;
+    size_t len;
+
+    asc_req_data->spon_status = OpenAPI_sponsoring_status_NULL;
+    asc_req_data->res_prio = OpenAPI_reserv_priority_NULL;
+    json = OpenAPI_app_session_context_req_data_convertToJSON(asc_req_data);
+    asc_req_data->spon_status = spon_status;
+    asc_req_data->res_prio = res_prio;
+    if (!json) return NULL;
+
+    per_ue = cJSON_PrintUnformatted(json);
+    cJSON_Delete(json);
+    if (!per_ue) return NULL;
+
+    /* per_ue is never "{}" as notifUri and suppFeat are mandatory */
+    len = strlen(per_ue);
+    if (len < 3 || per_ue[len - 1] != '}') {
+        cJSON_free(per_ue);
+        return NULL;
+    }
+
+    text = ogs_msprintf("%.*s,%s}", (int)(len - 1), per_ue, shared_members);
+    ogs_assert(text);
+    cJSON_free(per_ue);
+
+    return text;
+}
@@ -17,9 +17,10 @@
 extern "C" {
 #endif
 
-extern ogs_sbi_request_t *pcf_policyauthorization_request_create(pcf_app_session_t *sess, OpenAPI_list_t *media_component, int events);
+extern ogs_sbi_request_t *pcf_policyauthorization_request_create(pcf_app_session_t *sess, const char *media_profile,
+                                                                  OpenAPI_list_t *media_component, int events);
 
-extern ogs_sbi_request_t *pcf_policyauthorization_request_update(pcf_app_session_t *sess, OpenAPI_list_t *media_component);
+extern ogs_sbi_request_t *pcf_policyauthorization_request_update(pcf_app_session_t *sess, const cJSON *med_components_patch);
 
 extern ogs_sbi_request_t *pcf_policyauthorization_request_delete(pcf_app_session_t *sess);
 
@@ -31,6 +32,10 @@ extern ogs_sbi_request_t *pcf_policyauthorization_subscribe_request_event(pcf_ap
 
 extern ogs_sbi_request_t *pcf_policyauthorization_req_unsubscribe_event(pcf_app_session_t *sess);
 
+extern void _pcf_media_components_free(OpenAPI_list_t *MediaComponentList);
+extern cJSON *_pcf_media_components_to_json(OpenAPI_list_t *media_component);
+extern cJSON *_pcf_media_components_rm_to_json(OpenAPI_list_t *media_component_rm);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,212 @@
+/*
+ * License: 5G-MAG Public License (v1.0)
+ * Copyright: (C) 2023 British Broadcasting Corporation
+ *
+ * For full license terms please see the LICENSE file distributed with this
+ * program. If this file is missing then the license can be retrieved from
+ * https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
+ */
+
+#include "ogs-core.h"
+#include "ogs-sbi.h"
+
+#include "context.h"
+#include "pcf-build.h"
+#include "pcf-client.h"
+#include "pcf-client-sess.h"
+
+#include "pcf-bulk-create.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+static void __send_items(pcf_bulk_create_t *bulk);
+static void __item_result(pcf_bulk_create_t *bulk, size_t item, pcf_app_session_t *app_session);
+static void __item_clear(pcf_bulk_create_item_t *item);
+static void __items_media_components_free(const pcf_app_session_create_item_t *items, size_t num_items);
+static void __check_done(pcf_bulk_create_t *bulk);
+
+/* Library Internals */
+
+/* Copy the items and send the first window of create requests, the items' media components are freed if this fails */
+bool _pcf_bulk_create_start(pcf_session_t *pcf_session, const pcf_app_session_create_item_t *items, size_t num_items,
+                            int events, size_t max_in_flight,
+                            pcf_app_session_notification_callback notify_callback, void *notify_user_data,
+                            pcf_app_session_change_callback change_callback, void *change_user_data,
+                            pcf_app_sessions_create_result_callback result_callback,
+                            pcf_app_sessions_create_done_callback done_callback, void *result_user_data)
+{
+    pcf_bulk_create_t *bulk;
+    size_t i;
+
+    if (!items || !num_items) return false;
+
+    if (!pcf_session) {
+        __items_media_components_free(items, num_items);
+        return false;
+    }
+
+    for (i = 0; i < num_items; i++) {
+        if (!items[i].ue_connection) {
+            ogs_error("pcf_session_create_app_sessions: item %zu has no UE connection", i);
+            __items_media_components_free(items, num_items);
+            return false;
+        }
+    }
+
+    bulk = ogs_calloc(1, sizeof(*bulk));
+    ogs_assert(bulk);
+    bulk->items = ogs_calloc(num_items, sizeof(*bulk->items));
+    ogs_assert(bulk->items);
+
+    for (i = 0; i < num_items; i++) {
+        bulk->items[i].ue_connection = _pcf_ue_network_identifier_clone(items[i].ue_connection);
+        ogs_assert(bulk->items[i].ue_connection);
+        bulk->items[i].media_component = items[i].media_component;
+        if (items[i].media_profile) {
+            bulk->items[i].media_profile = ogs_strdup(items[i].media_profile);
+            ogs_assert(bulk->items[i].media_profile);
+        }
+    }
+
+    bulk->pcf_session = pcf_session;
+    bulk->num_items = num_items;
+    bulk->max_in_flight = max_in_flight ? max_in_flight : PCF_BULK_CREATE_DEFAULT_MAX_IN_FLIGHT;
+    bulk->events = events;
+    bulk->notify_callback = notify_callback;
+    bulk->notify_user_data = notify_user_data;
+    bulk->change_callback = change_callback;
+    bulk->change_user_data = change_user_data;
+    bulk->result_callback = result_callback;
+    bulk->done_callback = done_callback;
+    bulk->result_user_data = result_user_data;
+
+    ogs_list_add(&pcf_session->bulk_creates, bulk);
+
+    __send_items(bulk);
+    __check_done(bulk);
+
+    return true;
+}
+
+/* Called when the create for app_session has been answered, or app_session is going away, does nothing if
+ * app_session isn't waiting on a batch create */
+void _pcf_bulk_create_item_finished(pcf_app_session_t *app_session, bool created)
+{
+    pcf_bulk_create_t *bulk;
+
+    if (!app_session || !app_session->bulk_create) return;
+
+    bulk = app_session->bulk_create;
+    app_session->bulk_create = NULL;
+    bulk->in_flight--;
+
+    __item_result(bulk, app_session->bulk_create_item, created ? app_session : NULL);
+
+    __send_items(bulk);
+    __check_done(bulk);
+}
+
+/* Stop sending for every batch on pcf_session, the items still in flight finish as their AppSessions are freed */
+void _pcf_bulk_create_cancel_all(pcf_session_t *pcf_session)
+{
+    pcf_bulk_create_t *bulk, *next;
+
+    ogs_list_for_each_safe(&pcf_session->bulk_creates, next, bulk) {
+        bulk->cancelled = true;
+        __check_done(bulk);
+    }
+}
+
+/*** Private functions ***/
+
+static void __send_items(pcf_bulk_create_t *bulk)
+{
+    while (!bulk->cancelled && bulk->in_flight < bulk->max_in_flight && bulk->next_item < bulk->num_items) {
+        size_t index = bulk->next_item++;
+        pcf_bulk_create_item_t *item = &bulk->items[index];
+        pcf_app_session_t *app_session;
+
+        /* the media components are freed when the request is built */
+        app_session = _pcf_session_create_app_session(bulk->pcf_session, item->ue_connection, bulk->events, item->media_profile,
+                                                      item->media_component, bulk->notify_callback, bulk->notify_user_data,
+                                                      bulk->change_callback, bulk->change_user_data);
+        item->media_component = NULL;
+        __item_clear(item);
+
+        if (!app_session) {
+            __item_result(bulk, index, NULL);
+            continue;
+        }
+
+        app_session->bulk_create = bulk;
+        app_session->bulk_create_item = index;
+        bulk->in_flight++;
+    }
+}
+
+static void __item_result(pcf_bulk_create_t *bulk, size_t item, pcf_app_session_t *app_session)
+{
+    if (app_session) {
+        bulk->created++;
+    } else {
+        bulk->failed++;
+    }
+
+    if (bulk->result_callback) bulk->result_callback(item, app_session, bulk->result_user_data);
+}
+
+static void __item_clear(pcf_bulk_create_item_t *item)
+{
+    if (item->ue_connection) {
+        _pcf_ue_network_identifier_free(item->ue_connection);
+        item->ue_connection = NULL;
+    }
+    if (item->media_component) {
+        _pcf_media_components_free(item->media_component);
+        item->media_component = NULL;
+    }
+    if (item->media_profile) {
+        ogs_free(item->media_profile);
+        item->media_profile = NULL;
+    }
+}
+
+/* The caller's items aren't going to be sent, free the media components they handed over */
+static void __items_media_components_free(const pcf_app_session_create_item_t *items, size_t num_items)
+{
+    size_t i;
+
+    for (i = 0; i < num_items; i++) {
+        if (items[i].media_component) _pcf_media_components_free(items[i].media_component);
+    }
+}
+
+/* Report the aggregate result and free the batch once nothing is in flight and nothing more will be sent */
+static void __check_done(pcf_bulk_create_t *bulk)
+{
+    if (bulk->in_flight) return;
+    if (!bulk->cancelled && bulk->next_item < bulk->num_items) return;
+
+    /* items never sent because the PCF session is going away */
+    while (bulk->next_item < bulk->num_items) {
+        size_t index = bulk->next_item++;
+
+        __item_clear(&bulk->items[index]);
+        __item_result(bulk, index, NULL);
+    }
+
+    if (bulk->done_callback) bulk->done_callback(bulk->created, bulk->failed, bulk->result_user_data);
+
+    ogs_list_remove(&bulk->pcf_session->bulk_creates, bulk);
+    ogs_free(bulk->items);
+    ogs_free(bulk);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+/* vim:ts=8:sts=4:sw=4:expandtab:
+ */
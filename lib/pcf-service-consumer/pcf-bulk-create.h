@@ -0,0 +1,73 @@
+/*
+ * License: 5G-MAG Public License (v1.0)
+ * Copyright: (C) 2023 British Broadcasting Corporation
+ *
+ * For full license terms please see the LICENSE file distributed with this
+ * program. If this file is missing then the license can be retrieved from
+ * https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
+ */
+
+#ifndef PCF_BULK_CREATE_H
+#define PCF_BULK_CREATE_H
+
+#include "ogs-core.h"
+#include "ogs-sbi.h"
+
+#include "pcf-service-consumer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Default for the most create requests one batch has outstanding at once */
+#define PCF_BULK_CREATE_DEFAULT_MAX_IN_FLIGHT 64
+
+typedef struct pcf_bulk_create_item_s {
+    ue_network_identifier_t *ue_connection; /* copied from the caller's item, freed once sent */
+    OpenAPI_list_t *media_component;        /* owned until the create request is built */
+    char *media_profile;                    /* copied from the caller's item, NULL if none */
+} pcf_bulk_create_item_t;
+
+/* A batch of AppSessionContext creates from pcf_session_create_app_sessions() */
+typedef struct pcf_bulk_create_s {
+    ogs_lnode_t node; /* in pcf_session_t.bulk_creates */
+    pcf_session_t *pcf_session;
+
+    pcf_bulk_create_item_t *items;
+    size_t num_items;
+    size_t next_item;     /* index of the next item to send */
+    size_t in_flight;     /* create requests awaiting a response */
+    size_t max_in_flight;
+    size_t created;
+    size_t failed;
+    bool cancelled;       /* PCF session going away, send no more items */
+
+    int events;
+    pcf_app_session_notification_callback notify_callback;
+    void *notify_user_data;
+    pcf_app_session_change_callback change_callback;
+    void *change_user_data;
+
+    pcf_app_sessions_create_result_callback result_callback;
+    pcf_app_sessions_create_done_callback done_callback;
+    void *result_user_data;
+} pcf_bulk_create_t;
+
+/* Library Internals */
+bool _pcf_bulk_create_start(pcf_session_t *pcf_session, const pcf_app_session_create_item_t *items, size_t num_items,
+                            int events, size_t max_in_flight,
+                            pcf_app_session_notification_callback notify_callback, void *notify_user_data,
+                            pcf_app_session_change_callback change_callback, void *change_user_data,
+                            pcf_app_sessions_create_result_callback result_callback,
+                            pcf_app_sessions_create_done_callback done_callback, void *result_user_data);
+void _pcf_bulk_create_item_finished(pcf_app_session_t *app_session, bool created);
+void _pcf_bulk_create_cancel_all(pcf_session_t *pcf_session);
+
+#ifdef __cplusplus
+}
+#endif
+
+/* vim:ts=8:sts=4:sw=4:expandtab:
+ */
+
+#endif /* PCF_BULK_CREATE_H */
@@ -115,6 +115,19 @@ int merge_event_subsc_to_app_session_context(pcf_app_session_t *app_session, Ope
     return merged_events;	
 }
 
+/* Drop the events merge_event_subsc_to_app_session_context() appended after the first num_events */
+void unmerge_event_subsc_from_app_session_context(pcf_app_session_t *app_session, long num_events)
+{
+    OpenAPI_list_t *events = app_session->pcf_app_session_context_requested->asc_req_data->ev_subsc->events;
+
+    while (events->count > num_events) {
+        OpenAPI_af_event_subscription_t *Event = events->last->data;
+
+        OpenAPI_list_remove(events, Event);
+        OpenAPI_af_event_subscription_free(Event);
+    }
+}
+
 void merge_evt_subsc_to_app_session_context(pcf_app_session_t *app_session,
                 OpenAPI_events_subsc_req_data_t *evt_subsc_req)
 {
@@ -196,22 +209,6 @@ bool _pcf_client_received_app_sess_context_set(pcf_app_session_t *sess, OpenAPI_
     return true;
 }
 
-bool _pcf_client_app_sess_context_updates_set(pcf_app_session_t *sess, OpenAPI_app_session_context_update_data_patch_t *AppSessionContext)
-{
-    if (!sess) return false;
-    if(!AppSessionContext) {
-        if(sess->pcf_app_session_context_updates){
-            OpenAPI_app_session_context_update_data_patch_free(sess->pcf_app_session_context_updates);
-            sess->pcf_app_session_context_updates = NULL;
-            return true;
-        }
-        return false;
-    }
-    sess->pcf_app_session_context_updates = OpenAPI_app_session_context_update_data_patch_copy(sess->pcf_app_session_context_updates, AppSessionContext);
-    if(!sess->pcf_app_session_context_updates) return false;
-    return true;
-}
-
 bool _pcf_client_app_sess_context_received_updates_set(pcf_app_session_t *sess, OpenAPI_app_session_context_update_data_patch_t *AppSessionContext)
 {
     if (!sess) return false;
@@ -230,15 +227,14 @@ bool _pcf_client_app_sess_context_received_updates_set(pcf_app_session_t *sess,
 }
 
 
+bool pcf_sess_set_pcf_app_session_id(pcf_app_session_t *sess, char *pcf_app_session_id)
+{
+    return _pcf_client_context_app_session_id_set(sess, pcf_app_session_id);
+}
+
 pcf_app_session_t *pcf_session_find_by_pcf_app_session_id(char *pcf_app_session_id)
 {
-    pcf_session_t *session;
-    pcf_app_session_t *app_session;
-    ogs_list_for_each(&pcf_self()->pcf_sessions, session)
-        ogs_list_for_each(&session->pcf_app_sessions, app_session)
-            if(!strcmp(app_session->pcf_app_session_id, pcf_app_session_id))
-                return app_session;
-    return NULL;
+    return _pcf_client_context_app_session_find_by_id(pcf_app_session_id);
 }
 
 void pcf_session_remove_all(void)
@@ -303,6 +299,7 @@ ogs_sbi_server_t *_pcf_session_get_notifications_server(pcf_session_t *pcf_sessi
         pcf_session->notif_server = ogs_sbi_server_add(NULL /*interface*/, OpenAPI_uri_scheme_http, &sock->local_addr, NULL);
 
         ogs_sbi_server_actions.start(pcf_session->notif_server, ogs_sbi_server_handler);
+        _pcf_client_context_notification_server_add(pcf_session);
 
         /* discover ephemeral port for server */
         sockaddr_size = sizeof(sock->local_addr.ss);
@@ -321,5 +318,10 @@ bool _pcf_session_has_notification_server(pcf_session_t *pcf_session, ogs_sbi_se
     return pcf_session->notif_server == server;
 }
 
+pcf_session_t *_pcf_session_find_by_notification_server(ogs_sbi_server_t *server)
+{
+    return _pcf_client_context_notification_server_find(server);
+}
+
 /* vim:ts=8:sts=4:sw=4:expandtab:
  */
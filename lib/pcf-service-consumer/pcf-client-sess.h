@@ -20,12 +20,25 @@ typedef struct ue_network_identifier_s ue_network_identifier_t;
 
 typedef struct pcf_app_session_s pcf_app_session_t;
 
+typedef struct pcf_connection_s pcf_connection_t;
+
 typedef struct pcf_session_s {
     ogs_lnode_t   node;
-    ogs_sockaddr_t *pcf_addr;
-    ogs_sbi_client_t *client;
+    pcf_connection_t *connection; // shared with other sessions for the same PCF
+    ogs_sockaddr_t *pcf_addr;     // connection->pcf_addr
+    ogs_sbi_client_t *client;     // connection->client
     ogs_list_t pcf_app_sessions; // Nodes of this list are of type pcf_app_session_t *
     ogs_sbi_server_t *notif_server;
+    ogs_list_t bulk_creates; // Nodes of this list are of type pcf_bulk_create_t *
+    struct {
+        ogs_list_t queued;     // pcf_request_t waiting for a free slot, oldest first
+        size_t num_queued;
+        ogs_list_t sent;       // pcf_request_t awaiting a response
+        size_t num_sent;
+        size_t max_in_flight;  // most requests sent at once, 0 for no limit
+        bool reject_when_full; // refuse new requests instead of queueing them once max_in_flight are sent
+        pcf_retry_policy_t retry_policies[PCF_REQUEST_OPERATION_MAX];
+    } requests;
 } pcf_session_t;
 
 extern void pcf_app_sess_remove(pcf_app_session_t *sess);
@@ -46,7 +59,6 @@ void _pcf_client_sess_notification_callback_init(pcf_app_session_t *sess);
 bool _pcf_client_sess_notification_callback_set(pcf_app_session_t *sess, pcf_app_session_notification_callback cb, int events, OpenAPI_events_subsc_req_data_t *evt_subsc_req, void *user_data);
 void _pcf_app_sess_event_notifications_remove(pcf_app_session_t *sess);
 
-bool _pcf_client_app_sess_context_updates_set(pcf_app_session_t *sess, OpenAPI_app_session_context_update_data_patch_t *AppSessionContext);
 bool _pcf_client_app_sess_context_received_updates_set(pcf_app_session_t *sess, OpenAPI_app_session_context_update_data_patch_t *AppSessionContext);
 
 
@@ -62,10 +74,18 @@ bool _pcf_client_received_app_sess_context_set(pcf_app_session_t *sess, OpenAPI_
 
 int merge_event_subsc_to_app_session_context(pcf_app_session_t *app_session, OpenAPI_events_subsc_req_data_t *evt_subsc_req);
 
+void unmerge_event_subsc_from_app_session_context(pcf_app_session_t *app_session, long num_events);
+
 void merge_evt_subsc_to_app_session_context(pcf_app_session_t *app_session, OpenAPI_events_subsc_req_data_t *evt_subsc_req);
 
 extern ogs_sbi_server_t *_pcf_session_get_notifications_server(pcf_session_t *pcf_session);
 extern bool _pcf_session_has_notification_server(pcf_session_t *pcf_session, ogs_sbi_server_t *server);
+extern pcf_session_t *_pcf_session_find_by_notification_server(ogs_sbi_server_t *server);
+extern pcf_app_session_t *_pcf_session_create_app_session(pcf_session_t *session,
+                const ue_network_identifier_t *ue_connection, int events,
+                const char *media_profile, OpenAPI_list_t *media_component,
+                pcf_app_session_notification_callback notify_callback, void *notify_user_data,
+                pcf_app_session_change_callback change_callback, void *change_user_data);
 
 #ifdef __cplusplus
 }
@@ -15,11 +15,14 @@
 #include "pcf-client-sess.h"
 #include "pcf-service-consumer.h"
 #include "utils.h"
+#include "pcf-bulk-create.h"
+#include "pcf-build.h"
+#include "json-merge-patch.h"
 
 #include "pcf-client.h"
 
-static ue_network_identifier_t *__ue_network_identifier_clone(const ue_network_identifier_t *to_clone);
-static void __ue_network_identifier_free(ue_network_identifier_t *ue_net);
+static void __media_components_update_free(pcf_app_session_t *app_session, pcf_media_components_update_t *update);
+static void __media_components_updates_clear(pcf_app_session_t *app_session);
 
 /******************* Library functions *********************/
 
@@ -33,9 +36,10 @@ pcf_app_session_t *_pcf_app_session_new(pcf_session_t *pcf_session, const ue_net
     if (!sess) return NULL;
 
     sess->pcf_session = pcf_session;
-    sess->ue_network_identifier = __ue_network_identifier_clone(ue_connection);
+    sess->ue_network_identifier = _pcf_ue_network_identifier_clone(ue_connection);
 
     ogs_list_init(&sess->pcf_event_notifications);
+    ogs_list_init(&sess->med_components.updates);
 
     _pcf_app_session_add_event_notification(sess, events, notify_callback, notify_user_data);
 
@@ -43,6 +47,7 @@ pcf_app_session_t *_pcf_app_session_new(pcf_session_t *pcf_session, const ue_net
     sess->change.user_data = change_user_data;
 
     ogs_list_add(&sess->pcf_session->pcf_app_sessions, sess);
+    _pcf_client_context_app_session_add(sess);
 
     return sess;
 }
@@ -53,8 +58,12 @@ void _pcf_app_session_free(pcf_app_session_t *app_session)
 
     if (!app_session) return;
 
-    /* remove app session from pcf session */
+    /* a batch create still waiting on this AppSession has failed */
+    _pcf_bulk_create_item_finished(app_session, false);
+
+    /* remove app session from pcf session and the registry */
     ogs_list_remove(&app_session->pcf_session->pcf_app_sessions, app_session);
+    _pcf_client_context_app_session_remove(app_session);
 
     /* remove notification callbacks */
     ogs_list_for_each_safe(&app_session->pcf_event_notifications, next, node) {
@@ -63,8 +72,7 @@ void _pcf_app_session_free(pcf_app_session_t *app_session)
     }
 
     if (app_session->notif_url) ogs_free(app_session->notif_url);
-    if (app_session->ue_network_identifier) __ue_network_identifier_free(app_session->ue_network_identifier);
-    if (app_session->pcf_app_session_id) ogs_free(app_session->pcf_app_session_id);
+    if (app_session->ue_network_identifier) _pcf_ue_network_identifier_free(app_session->ue_network_identifier);
     if (app_session->ipv4addr) ogs_free(app_session->ipv4addr);
     if (app_session->ipv6addr) ogs_free(app_session->ipv6addr);
     if (app_session->ipv6prefix) ogs_free(app_session->ipv6prefix);
@@ -76,11 +84,13 @@ void _pcf_app_session_free(pcf_app_session_t *app_session)
         OpenAPI_app_session_context_free(app_session->pcf_app_session_context_requested);
     if (app_session->pcf_app_session_context_received)
         OpenAPI_app_session_context_free(app_session->pcf_app_session_context_received);
-    if (app_session->pcf_app_session_context_updates)
-        OpenAPI_app_session_context_update_data_patch_free(app_session->pcf_app_session_context_updates);
     if (app_session->pcf_app_session_context_updates_received)
         OpenAPI_app_session_context_update_data_patch_free(app_session->pcf_app_session_context_updates_received);
 
+    __media_components_updates_clear(app_session);
+    if (app_session->med_components.acknowledged) cJSON_Delete(app_session->med_components.acknowledged);
+    if (app_session->med_components.requested) cJSON_Delete(app_session->med_components.requested);
+
     ogs_free(app_session);
 }
 
@@ -99,7 +109,7 @@ const char *_pcf_app_session_get_notif_url(pcf_app_session_t *app_session)
         header->service.name = (char *)OGS_SBI_SERVICE_NAME_NPCF_POLICYAUTHORIZATION;
         header->api.version = (char *)OGS_SBI_API_V1;
         header->resource.component[0] = (char*)"app-session-instance";
-        header->resource.component[1] = ogs_msprintf("%p", app_session);
+        header->resource.component[1] = ogs_msprintf("%llx", (unsigned long long)app_session->handle);
 
         app_session->notif_url = ogs_sbi_server_uri(server, header);
 
@@ -183,23 +193,25 @@ bool _pcf_app_session_notifications_callback_call(pcf_app_session_t *app_session
     return result;
 }
 
-bool _pcf_app_session_exists(pcf_app_session_t *app_session)
+/* Every event any notification callback of app_session wants */
+int _pcf_app_session_notification_events_mask(const pcf_app_session_t *app_session)
 {
-    pcf_session_t *pcf_session;
+    pcf_event_notification_t *pcf_event_notification;
+    int events_mask = 0;
 
-    ogs_list_for_each(&pcf_self()->pcf_sessions, pcf_session) {
-        pcf_app_session_t *app_node;
-        ogs_list_for_each(&pcf_session->pcf_app_sessions, app_node) {
-            if (app_node == app_session) return true;
-        }
+    ogs_list_for_each(&app_session->pcf_event_notifications, pcf_event_notification) {
+        events_mask |= pcf_event_notification->events;
     }
 
-    return false;
+    return events_mask;
 }
 
-/****************** Private functions *********************/
+pcf_app_session_t *_pcf_app_session_find_by_handle(uintptr_t handle)
+{
+    return _pcf_client_context_app_session_find_by_handle(handle);
+}
 
-static ue_network_identifier_t *__ue_network_identifier_clone(const ue_network_identifier_t *to_clone)
+ue_network_identifier_t *_pcf_ue_network_identifier_clone(const ue_network_identifier_t *to_clone)
 {
     ue_network_identifier_t *ret;
 
@@ -214,7 +226,7 @@ static ue_network_identifier_t *__ue_network_identifier_clone(const ue_network_i
     return ret;
 }
 
-static void __ue_network_identifier_free(ue_network_identifier_t *ue_net)
+void _pcf_ue_network_identifier_free(ue_network_identifier_t *ue_net)
 {
     if (!ue_net) return;
     if (ue_net->address) ogs_freeaddrinfo(ue_net->address);
@@ -225,5 +237,124 @@ static void __ue_network_identifier_free(ue_network_identifier_t *ue_net)
     ogs_free(ue_net);
 }
 
+/* The create request carries the medComponents map med_components, takes ownership of med_components */
+void _pcf_app_session_media_components_requested(pcf_app_session_t *app_session, cJSON *med_components)
+{
+    __media_components_updates_clear(app_session);
+    if (app_session->med_components.requested) cJSON_Delete(app_session->med_components.requested);
+    app_session->med_components.requested = med_components;
+}
+
+/* Take the medComponents the PCF answered the create with, or those requested if it didn't say, as the
+ * baseline for updates */
+void _pcf_app_session_media_components_created(pcf_app_session_t *app_session)
+{
+    const OpenAPI_app_session_context_t *context = app_session->pcf_app_session_context_received;
+    cJSON *json;
+
+    if (context && context->asc_req_data && context->asc_req_data->med_components) {
+        json = _pcf_media_components_to_json(context->asc_req_data->med_components);
+        if (!json) ogs_warn("Invalid MediaComponent in AppSessionContext, updates will send every media component");
+    } else {
+        json = cJSON_Duplicate(app_session->med_components.requested, 1);
+    }
+    if (!json) {
+        json = cJSON_CreateObject();
+        ogs_assert(json);
+    }
+
+    __media_components_updates_clear(app_session);
+    if (app_session->med_components.acknowledged) cJSON_Delete(app_session->med_components.acknowledged);
+    if (app_session->med_components.requested) cJSON_Delete(app_session->med_components.requested);
+    app_session->med_components.acknowledged = json;
+    app_session->med_components.requested = cJSON_Duplicate(json, 1);
+    ogs_assert(app_session->med_components.requested);
+}
+
+/* Work out the medComponents merge patch for the MediaComponentRm map media_component_rm, which is freed.
+ *
+ * The map is compared with what has already been requested, so updates still in flight aren't repeated.
+ * Sets *patch to NULL if nothing changes. Returns false if the map is invalid.
+ */
+bool _pcf_app_session_media_components_diff(pcf_app_session_t *app_session, OpenAPI_list_t *media_component_rm, cJSON **patch)
+{
+    cJSON *target;
+    bool ok;
+
+    *patch = NULL;
+
+    target = _pcf_media_components_rm_to_json(media_component_rm);
+    if (media_component_rm) _pcf_media_components_free(media_component_rm);
+    if (!target) return false;
+
+    ok = _json_merge_patch_diff(app_session->med_components.requested, target, patch);
+    cJSON_Delete(target);
+
+    return ok;
+}
+
+/* The PATCH request request_id carrying patch has been sent */
+void _pcf_app_session_media_components_sent(pcf_app_session_t *app_session, uintptr_t request_id, const cJSON *patch)
+{
+    pcf_media_components_update_t *update;
+
+    update = ogs_calloc(1, sizeof(*update));
+    ogs_assert(update);
+    update->request_id = request_id;
+    update->patch = cJSON_Duplicate(patch, 1);
+    ogs_assert(update->patch);
+    ogs_list_add(&app_session->med_components.updates, update);
+
+    _json_merge_patch_apply(&app_session->med_components.requested, patch);
+}
+
+/* The PCF answered the PATCH request request_id, acknowledged is false if it refused it */
+void _pcf_app_session_media_components_answered(pcf_app_session_t *app_session, uintptr_t request_id, bool acknowledged)
+{
+    pcf_media_components_update_t *update, *next;
+
+    ogs_list_for_each(&app_session->med_components.updates, update) {
+        if (update->request_id == request_id) break;
+    }
+    if (!update) return;
+
+    if (!acknowledged) {
+        /* drop the refused patch and work out what the PCF will have once the others are answered */
+        __media_components_update_free(app_session, update);
+        if (app_session->med_components.requested) cJSON_Delete(app_session->med_components.requested);
+        app_session->med_components.requested = cJSON_Duplicate(app_session->med_components.acknowledged, 1);
+        ogs_list_for_each(&app_session->med_components.updates, update) {
+            _json_merge_patch_apply(&app_session->med_components.requested, update->patch);
+        }
+        return;
+    }
+
+    /* answers may be reordered, apply patches to the baseline in the order they were sent */
+    update->acknowledged = true;
+    ogs_list_for_each_safe(&app_session->med_components.updates, next, update) {
+        if (!update->acknowledged) break;
+        _json_merge_patch_apply(&app_session->med_components.acknowledged, update->patch);
+        __media_components_update_free(app_session, update);
+    }
+}
+
+/*** Private functions ***/
+
+static void __media_components_update_free(pcf_app_session_t *app_session, pcf_media_components_update_t *update)
+{
+    ogs_list_remove(&app_session->med_components.updates, update);
+    cJSON_Delete(update->patch);
+    ogs_free(update);
+}
+
+static void __media_components_updates_clear(pcf_app_session_t *app_session)
+{
+    pcf_media_components_update_t *update, *next;
+
+    ogs_list_for_each_safe(&app_session->med_components.updates, next, update) {
+        __media_components_update_free(app_session, update);
+    }
+}
+
 /* vim:ts=8:sts=4:sw=4:expandtab:
  */
@@ -28,10 +28,20 @@ typedef struct pcf_event_notification_s {
     void *user_data;
 } pcf_event_notification_t;
 	
+/* A medComponents merge patch sent to the PCF and not yet applied to the acknowledged map */
+typedef struct pcf_media_components_update_s {
+    ogs_lnode_t node;
+    uintptr_t request_id;  /* the PATCH request carrying patch */
+    cJSON *patch;
+    bool acknowledged;     /* answered, but waiting for earlier updates to be answered */
+} pcf_media_components_update_t;
+
 typedef struct pcf_app_session_s {
     
     ogs_lnode_t   node;	
 
+    uintptr_t handle; /* generation tagged handle, used in notification URLs and client callbacks */
+
     uint64_t policyauthorization_features;
 
     char *pcf_app_session_id;
@@ -51,9 +61,14 @@ typedef struct pcf_app_session_s {
 
     OpenAPI_app_session_context_t *pcf_app_session_context_requested;
     OpenAPI_app_session_context_t *pcf_app_session_context_received;
-    OpenAPI_app_session_context_update_data_patch_t *pcf_app_session_context_updates;
     OpenAPI_app_session_context_update_data_patch_t *pcf_app_session_context_updates_received;
 
+    struct {
+        cJSON *acknowledged; /* medComponents map as last acknowledged by the PCF */
+        cJSON *requested;    /* acknowledged with the patches in updates applied, or the map sent in the create */
+        ogs_list_t updates;  /* Nodes of this list are pcf_media_components_update_t, in the order sent */
+    } med_components;
+
 
     struct {
         pcf_app_session_change_callback callback;
@@ -64,6 +79,9 @@ typedef struct pcf_app_session_s {
 
     char *notif_url;
 
+    struct pcf_bulk_create_s *bulk_create; /* batch waiting on this AppSession's create response, NULL if none */
+    size_t bulk_create_item;               /* index of this AppSession in bulk_create */
+
 } pcf_app_session_t;
 
 typedef struct pcf_npcf_policyauthorization_param_s {
@@ -84,7 +102,15 @@ extern bool _pcf_app_session_remove_event_notification(pcf_app_session_t *app_se
 extern bool _pcf_app_session_change_callback_call(pcf_app_session_t *app_session, bool delete_or_error);
 extern bool _pcf_app_session_notifications_callback_call(pcf_app_session_t *app_session,
 	       					         OpenAPI_events_notification_t *notifications);
-extern bool _pcf_app_session_exists(pcf_app_session_t *app_session);
+extern int _pcf_app_session_notification_events_mask(const pcf_app_session_t *app_session);
+extern pcf_app_session_t *_pcf_app_session_find_by_handle(uintptr_t handle);
+extern ue_network_identifier_t *_pcf_ue_network_identifier_clone(const ue_network_identifier_t *to_clone);
+extern void _pcf_ue_network_identifier_free(ue_network_identifier_t *ue_net);
+extern void _pcf_app_session_media_components_requested(pcf_app_session_t *app_session, cJSON *med_components);
+extern void _pcf_app_session_media_components_created(pcf_app_session_t *app_session);
+extern bool _pcf_app_session_media_components_diff(pcf_app_session_t *app_session, OpenAPI_list_t *media_component_rm, cJSON **patch);
+extern void _pcf_app_session_media_components_sent(pcf_app_session_t *app_session, uintptr_t request_id, const cJSON *patch);
+extern void _pcf_app_session_media_components_answered(pcf_app_session_t *app_session, uintptr_t request_id, bool acknowledged);
 
 #ifdef __cplusplus
 }
@@ -12,6 +12,7 @@ https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
 
 #include "pcf-client-sess.h"
 #include "pcf-client.h"
+#include "pcf-bulk-create.h"
 #include "utils.h"
 #include "pcf-service-consumer.h"
 /*#include "openapi/model/events_subsc_put_data.h"
@@ -225,7 +226,7 @@ void pcf_policyauthorization_create(
    
     supported_features = ogs_uint64_from_string(AscReqData->supp_feat);
     sess->policyauthorization_features &= supported_features;
-    sess->pcf_app_session_id = ogs_strdup(message.h.resource.component[1]);
+    pcf_sess_set_pcf_app_session_id(sess, message.h.resource.component[1]);
 
     app_sess_context = OpenAPI_app_session_context_convertToJSON(AppSessionContext);
     app_sess_context_text = cJSON_Print(app_sess_context);
@@ -238,37 +239,21 @@ void pcf_policyauthorization_create(
         ogs_error("AppSessionContext change callback failed");
     }
 
+    _pcf_app_session_media_components_created(sess);
+
+    _pcf_bulk_create_item_finished(sess, true);
+
 cleanup:
     ogs_sbi_header_free(&header);
 }
 
 void pcf_policyauthorization_delete(pcf_app_session_t *app_sess)
 {
-    pcf_session_t *session;
-    pcf_app_session_t *sess, *next = NULL;
+    pcf_app_session_t *sess;
     ogs_assert(app_sess);
 
-    if(app_sess->pcf_session) {
-        session = app_sess->pcf_session;
-        ogs_assert(session);
-    }
-
-    ogs_list_for_each_safe(&session->pcf_app_sessions, next, sess){
-        if(!strcmp(app_sess->pcf_app_session_id, sess->pcf_app_session_id)){
-	    break;
-	}
-
-    }
-
-   if(sess)
-   {
-       ogs_list_remove(&session->pcf_app_sessions, sess);
-
-       pcf_app_sess_remove(sess);
-
-   }
-
-
+    sess = pcf_session_find_by_pcf_app_session_id(app_sess->pcf_app_session_id);
+    if (sess) pcf_app_sess_remove(sess);
 }
 
 /* vim:ts=8:sts=4:sw=4:expandtab:
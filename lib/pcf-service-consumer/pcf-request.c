@@ -0,0 +1,383 @@
+/*
+ * License: 5G-MAG Public License (v1.0)
+ * Copyright: (C) 2023 British Broadcasting Corporation
+ *
+ * For full license terms please see the LICENSE file distributed with this
+ * program. If this file is missing then the license can be retrieved from
+ * https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
+ */
+
+#include "ogs-core.h"
+#include "ogs-sbi.h"
+#include "ogs-app.h"
+
+#include "context.h"
+#include "pcf-client-sess.h"
+
+#include "pcf-request.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+static bool __window_full(const pcf_session_t *pcf_session);
+static bool __transient_failure(const pcf_retry_policy_t *policy, int state, ogs_sbi_response_t *response);
+static ogs_time_t __backoff(const pcf_retry_policy_t *policy, unsigned int retry, ogs_sbi_response_t *response);
+static void __retry_timer_expired(void *data);
+static bool __send(pcf_request_t *request);
+static void __send_queued(pcf_session_t *pcf_session);
+static void __request_free(pcf_request_t *request);
+static int __client_notify_cb(int status, ogs_sbi_response_t *response, void *data);
+
+/* Library Internals */
+
+void _pcf_session_requests_init(pcf_session_t *pcf_session)
+{
+    int i;
+
+    ogs_list_init(&pcf_session->requests.queued);
+    ogs_list_init(&pcf_session->requests.sent);
+    pcf_session->requests.num_queued = 0;
+    pcf_session->requests.num_sent = 0;
+    pcf_session->requests.max_in_flight = PCF_SESSION_DEFAULT_MAX_IN_FLIGHT;
+    pcf_session->requests.reject_when_full = false;
+
+    for (i = 0; i < PCF_REQUEST_OPERATION_MAX; i++) {
+        pcf_retry_policy_t *policy = &pcf_session->requests.retry_policies[i];
+
+        policy->max_attempts = (i == PCF_REQUEST_OPERATION_DELETE) ?
+                                PCF_RETRY_DEFAULT_DELETE_MAX_ATTEMPTS : PCF_RETRY_DEFAULT_MAX_ATTEMPTS;
+        policy->deadline = PCF_RETRY_DEFAULT_DEADLINE;
+        policy->initial_backoff = PCF_RETRY_DEFAULT_INITIAL_BACKOFF;
+        policy->max_backoff = PCF_RETRY_DEFAULT_MAX_BACKOFF;
+        policy->retry_unanswered = (i != PCF_REQUEST_OPERATION_CREATE);
+    }
+}
+
+/* Send request for the AppSession app_session_handle now if pcf_session has a free slot, otherwise queue it behind
+ * the requests already waiting, or refuse it if the session rejects when full. Releases are never refused.
+ *
+ * Takes ownership of request. Returns false if it was refused or couldn't be sent, the response callback is then
+ * never called for it.
+ */
+bool _pcf_session_send_request(pcf_session_t *pcf_session, ogs_sbi_request_t *request, uintptr_t app_session_handle,
+                               pcf_request_operation_t operation)
+{
+    return _pcf_session_send_request_with_id(pcf_session, request, app_session_handle, operation, NULL);
+}
+
+/* As _pcf_session_send_request(), also setting *request_id, if given, to the id the response will carry */
+bool _pcf_session_send_request_with_id(pcf_session_t *pcf_session, ogs_sbi_request_t *request, uintptr_t app_session_handle,
+                                       pcf_request_operation_t operation, uintptr_t *request_id)
+{
+    pcf_request_t *pcf_request;
+
+    if (!request) return false;
+
+    if (_pcf_session_request_refused(pcf_session, operation)) {
+        ogs_warn("PCF session has %zu requests outstanding, refusing %s %s", pcf_session->requests.num_sent,
+                 request->h.method, request->h.uri);
+        ogs_sbi_request_free(request);
+        return false;
+    }
+
+    pcf_request = ogs_calloc(1, sizeof(*pcf_request));
+    ogs_assert(pcf_request);
+    pcf_request->pcf_session = pcf_session;
+    pcf_request->app_session_handle = app_session_handle;
+    pcf_request->operation = operation;
+    pcf_request->request = request;
+    _pcf_client_context_request_add(pcf_request);
+    if (request_id) *request_id = pcf_request->id;
+
+    /* keep FIFO order, nothing jumps ahead of requests already queued */
+    if (__window_full(pcf_session) || pcf_session->requests.num_queued) {
+        ogs_list_add(&pcf_session->requests.queued, pcf_request);
+        pcf_session->requests.num_queued++;
+        ogs_debug("PCF session window full, %zu requests queued", pcf_session->requests.num_queued);
+        return true;
+    }
+
+    if (!__send(pcf_request)) {
+        __request_free(pcf_request);
+        return false;
+    }
+
+    return true;
+}
+
+/* True if _pcf_session_send_request() would refuse a request for this operation right now */
+bool _pcf_session_request_refused(const pcf_session_t *pcf_session, pcf_request_operation_t operation)
+{
+    return operation != PCF_REQUEST_OPERATION_DELETE && pcf_session->requests.reject_when_full &&
+           __window_full(pcf_session);
+}
+
+/* max_in_flight of 0 means no limit */
+void _pcf_session_set_max_in_flight(pcf_session_t *pcf_session, size_t max_in_flight, bool reject_when_full)
+{
+    pcf_session->requests.max_in_flight = max_in_flight;
+    pcf_session->requests.reject_when_full = reject_when_full;
+
+    __send_queued(pcf_session);
+}
+
+bool _pcf_session_set_retry_policy(pcf_session_t *pcf_session, pcf_request_operation_t operation,
+                                   const pcf_retry_policy_t *policy)
+{
+    if ((unsigned int)operation >= PCF_REQUEST_OPERATION_MAX || !policy) return false;
+    if (!policy->max_attempts || policy->deadline < 0 || policy->initial_backoff < 0 ||
+            policy->max_backoff < policy->initial_backoff) return false;
+
+    pcf_session->requests.retry_policies[operation] = *policy;
+
+    return true;
+}
+
+/* Drop the queued requests and forget those awaiting a response, their responses are then ignored */
+void _pcf_session_requests_clear(pcf_session_t *pcf_session)
+{
+    pcf_request_t *request, *next;
+
+    ogs_list_for_each_safe(&pcf_session->requests.queued, next, request) {
+        ogs_list_remove(&pcf_session->requests.queued, request);
+        __request_free(request);
+    }
+    pcf_session->requests.num_queued = 0;
+
+    ogs_list_for_each_safe(&pcf_session->requests.sent, next, request) {
+        ogs_list_remove(&pcf_session->requests.sent, request);
+        __request_free(request);
+    }
+    pcf_session->requests.num_sent = 0;
+}
+
+/* Returns NULL if id, from SBI client callback data, isn't one of our requests */
+pcf_request_t *_pcf_request_find(uintptr_t id)
+{
+    return _pcf_client_context_request_find(id);
+}
+
+/* Decide whether the response for request, or the failure to get one, is final.
+ *
+ * When it returns PCF_REQUEST_RESULT_RETRYING the request keeps its slot and will be sent again after the backoff,
+ * the response should be discarded. Otherwise call _pcf_request_finished().
+ */
+pcf_request_result_t _pcf_request_check_response(pcf_request_t *request, int state, ogs_sbi_response_t *response)
+{
+    const pcf_retry_policy_t *policy = &request->pcf_session->requests.retry_policies[request->operation];
+    ogs_time_t delay;
+
+    if (!__transient_failure(policy, state, response)) return PCF_REQUEST_RESULT_COMPLETE;
+
+    if (request->attempts >= policy->max_attempts) {
+        ogs_error("PCF %s request failed after %u attempts", _pcf_request_operation_name(request->operation),
+                  request->attempts);
+        return PCF_REQUEST_RESULT_GAVE_UP;
+    }
+
+    delay = __backoff(policy, request->attempts, response);
+    if (policy->deadline && ogs_time_now() + delay > request->first_sent + policy->deadline) {
+        ogs_error("PCF %s request failed, no time left to retry", _pcf_request_operation_name(request->operation));
+        return PCF_REQUEST_RESULT_GAVE_UP;
+    }
+
+    if (!request->retry_timer) {
+        request->retry_timer = ogs_timer_add(ogs_app()->timer_mgr, __retry_timer_expired, (void*)request->id);
+        ogs_assert(request->retry_timer);
+    }
+    ogs_timer_start(request->retry_timer, delay);
+
+    ogs_warn("PCF %s request failed, retrying in %lldms (attempt %u of %u)",
+             _pcf_request_operation_name(request->operation), (long long)(delay / 1000), request->attempts + 1,
+             policy->max_attempts);
+
+    return PCF_REQUEST_RESULT_RETRYING;
+}
+
+const char *_pcf_request_operation_name(pcf_request_operation_t operation)
+{
+    switch (operation) {
+    case PCF_REQUEST_OPERATION_CREATE:
+        return "create";
+    case PCF_REQUEST_OPERATION_UPDATE:
+        return "update";
+    case PCF_REQUEST_OPERATION_SUBSCRIBE:
+        return "subscribe";
+    case PCF_REQUEST_OPERATION_DELETE:
+        return "delete";
+    default:
+        break;
+    }
+    return "unknown";
+}
+
+/* The response for request has arrived, free its slot for the next queued request.
+ *
+ * Returns the handle of the AppSession the request was for.
+ */
+uintptr_t _pcf_request_finished(pcf_request_t *request)
+{
+    pcf_session_t *pcf_session = request->pcf_session;
+    uintptr_t app_session_handle = request->app_session_handle;
+
+    ogs_list_remove(&pcf_session->requests.sent, request);
+    pcf_session->requests.num_sent--;
+    __request_free(request);
+
+    __send_queued(pcf_session);
+
+    return app_session_handle;
+}
+
+/*** Private functions ***/
+
+static bool __window_full(const pcf_session_t *pcf_session)
+{
+    return pcf_session->requests.max_in_flight &&
+           pcf_session->requests.num_sent >= pcf_session->requests.max_in_flight;
+}
+
+/* A 429 or 503 means the PCF didn't act on the request, so it is always worth retrying. Timeouts, connection failures and
+ * a 504 leave it unknown whether the PCF acted, so these are only retried if the policy allows */
+static bool __transient_failure(const pcf_retry_policy_t *policy, int state, ogs_sbi_response_t *response)
+{
+    if (state == OGS_DONE) return false; /* shutting down */
+    if (state != OGS_OK) return policy->retry_unanswered;
+    if (!response) return false;
+
+    switch (response->status) {
+    case OGS_SBI_HTTP_STATUS_TOO_MANY_REQUESTS:
+    case OGS_SBI_HTTP_STATUS_SERVICE_UNAVAILABLE:
+        return true;
+    case OGS_SBI_HTTP_STATUS_GATEWAY_TIMEOUT:
+        return policy->retry_unanswered;
+    default:
+        break;
+    }
+
+    return false;
+}
+
+/* Exponential backoff with equal jitter, at least any Retry-After delay-seconds, retry counts from 1 */
+static ogs_time_t __backoff(const pcf_retry_policy_t *policy, unsigned int retry, ogs_sbi_response_t *response)
+{
+    ogs_time_t backoff = policy->initial_backoff;
+    ogs_time_t delay;
+    const char *retry_after;
+
+    while (--retry && backoff < policy->max_backoff) backoff *= 2;
+    if (backoff > policy->max_backoff) backoff = policy->max_backoff;
+
+    delay = backoff / 2;
+    if (backoff / 2 > 0) delay += ogs_random32() % (backoff / 2 + 1);
+
+    if (response && (retry_after = (const char*)ogs_sbi_header_get(response->http.headers, "Retry-After")) != NULL) {
+        const char *p;
+        long long seconds = 0;
+
+        for (p = retry_after; *p >= '0' && *p <= '9' && seconds < 86400; p++) seconds = seconds * 10 + (*p - '0');
+        if (p != retry_after && ogs_time_from_sec(seconds) > delay) delay = ogs_time_from_sec(seconds);
+    }
+
+    return delay;
+}
+
+/* Send the request again, a failure to send goes through the response handling like any other */
+static void __retry_timer_expired(void *data)
+{
+    pcf_request_t *request = _pcf_client_context_request_find((uintptr_t)data);
+    bool rv;
+
+    if (!request) return;
+
+    request->attempts++;
+    rv = ogs_sbi_client_send_request(request->pcf_session->client, __client_notify_cb, request->request, (void*)request->id);
+    if (ogs_unlikely(rv == false)) {
+        ogs_error("Error resending request");
+        __client_notify_cb(OGS_ERROR, NULL, (void*)request->id);
+    }
+}
+
+/* Send request and add it to the sent list */
+static bool __send(pcf_request_t *request)
+{
+    pcf_session_t *pcf_session = request->pcf_session;
+    bool rv;
+
+    request->attempts = 1;
+    request->first_sent = ogs_time_now();
+    rv = ogs_sbi_client_send_request(pcf_session->client, __client_notify_cb, request->request, (void*)request->id);
+    if (ogs_unlikely(rv == false)) {
+        ogs_error("Error sending request");
+        return false;
+    }
+
+    ogs_list_add(&pcf_session->requests.sent, request);
+    pcf_session->requests.num_sent++;
+
+    return true;
+}
+
+/* Send queued requests, oldest first, while there is room */
+static void __send_queued(pcf_session_t *pcf_session)
+{
+    pcf_request_t *request;
+
+    while (!__window_full(pcf_session) && (request = ogs_list_first(&pcf_session->requests.queued)) != NULL) {
+        ogs_list_remove(&pcf_session->requests.queued, request);
+        pcf_session->requests.num_queued--;
+        if (!__send(request)) {
+            /* the caller was told it was accepted, so report the failure as a failed response */
+            ogs_list_add(&pcf_session->requests.sent, request);
+            pcf_session->requests.num_sent++;
+            __client_notify_cb(OGS_ERROR, NULL, (void*)request->id);
+        }
+    }
+}
+
+static void __request_free(pcf_request_t *request)
+{
+    _pcf_client_context_request_remove(request);
+    if (request->retry_timer) ogs_timer_delete(request->retry_timer);
+    if (request->request) ogs_sbi_request_free(request->request);
+    ogs_free(request);
+}
+
+static int __client_notify_cb(int status, ogs_sbi_response_t *response, void *data)
+{
+    int rv;
+    ogs_event_t *event;
+
+    ogs_assert(data);
+
+    if (status != OGS_OK) {
+        ogs_log_message(
+                status == OGS_DONE ? OGS_LOG_DEBUG : OGS_LOG_WARN, 0,
+                "client_notify_cb() failed [%d]", status);
+    }
+
+    event = ogs_event_new(OGS_EVENT_SBI_CLIENT);
+    event->sbi.response = response;
+    event->sbi.data = data;
+    event->sbi.state = status;
+
+    rv = ogs_queue_push(ogs_app()->queue, event);
+    if (rv !=OGS_OK) {
+        ogs_error("OGS Queue Push failed %d", rv);
+        ogs_sbi_response_free(response);
+        ogs_event_free(event);
+        return OGS_ERROR;
+    }
+
+    ogs_pollset_notify(ogs_app()->pollset);
+
+    return (status == OGS_OK)?OGS_OK:OGS_ERROR;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+/* vim:ts=8:sts=4:sw=4:expandtab:
+ */
@@ -0,0 +1,76 @@
+/*
+ * License: 5G-MAG Public License (v1.0)
+ * Copyright: (C) 2023 British Broadcasting Corporation
+ *
+ * For full license terms please see the LICENSE file distributed with this
+ * program. If this file is missing then the license can be retrieved from
+ * https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
+ */
+
+#ifndef PCF_REQUEST_H
+#define PCF_REQUEST_H
+
+#include "ogs-core.h"
+#include "ogs-sbi.h"
+
+#include "context.h"
+#include "pcf-service-consumer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Default for the most requests one PCF session has outstanding at once */
+#define PCF_SESSION_DEFAULT_MAX_IN_FLIGHT 128
+
+/* Default retry policy */
+#define PCF_RETRY_DEFAULT_MAX_ATTEMPTS 3
+#define PCF_RETRY_DEFAULT_DELETE_MAX_ATTEMPTS 5
+#define PCF_RETRY_DEFAULT_DEADLINE ogs_time_from_sec(30)
+#define PCF_RETRY_DEFAULT_INITIAL_BACKOFF ogs_time_from_msec(250)
+#define PCF_RETRY_DEFAULT_MAX_BACKOFF ogs_time_from_sec(5)
+
+/* What to do with a response */
+typedef enum pcf_request_result_e {
+    PCF_REQUEST_RESULT_COMPLETE, /* handle the response */
+    PCF_REQUEST_RESULT_RETRYING, /* transient failure, the request will be sent again */
+    PCF_REQUEST_RESULT_GAVE_UP   /* transient failure but no attempts are left */
+} pcf_request_result_t;
+
+/* A request to the PCF, from being queued or sent until its response has been taken */
+typedef struct pcf_request_s {
+    ogs_lnode_t node;              /* in pcf_session_t.requests.queued or .sent */
+    uintptr_t id;                  /* passed as the SBI client callback data */
+    pcf_session_t *pcf_session;
+    uintptr_t app_session_handle;  /* AppSession the request is for */
+    pcf_request_operation_t operation;
+    ogs_sbi_request_t *request;    /* kept to send again, every retry is the same request */
+    unsigned int attempts;         /* times sent so far */
+    ogs_time_t first_sent;
+    ogs_timer_t *retry_timer;      /* NULL until the first retry */
+} pcf_request_t;
+
+/* Library Internals */
+void _pcf_session_requests_init(pcf_session_t *pcf_session);
+bool _pcf_session_send_request(pcf_session_t *pcf_session, ogs_sbi_request_t *request, uintptr_t app_session_handle,
+                               pcf_request_operation_t operation);
+bool _pcf_session_send_request_with_id(pcf_session_t *pcf_session, ogs_sbi_request_t *request, uintptr_t app_session_handle,
+                                       pcf_request_operation_t operation, uintptr_t *request_id);
+bool _pcf_session_request_refused(const pcf_session_t *pcf_session, pcf_request_operation_t operation);
+void _pcf_session_set_max_in_flight(pcf_session_t *pcf_session, size_t max_in_flight, bool reject_when_full);
+bool _pcf_session_set_retry_policy(pcf_session_t *pcf_session, pcf_request_operation_t operation,
+                                   const pcf_retry_policy_t *policy);
+void _pcf_session_requests_clear(pcf_session_t *pcf_session);
+pcf_request_t *_pcf_request_find(uintptr_t id);
+pcf_request_result_t _pcf_request_check_response(pcf_request_t *request, int state, ogs_sbi_response_t *response);
+const char *_pcf_request_operation_name(pcf_request_operation_t operation);
+uintptr_t _pcf_request_finished(pcf_request_t *request);
+
+#ifdef __cplusplus
+}
+#endif
+
+/* vim:ts=8:sts=4:sw=4:expandtab:
+ */
+
+#endif /* PCF_REQUEST_H */
@@ -10,36 +10,62 @@ https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
 #include "pcf-build.h"
 #include "pcf-service-consumer.h"
 #include "pcf-client-sess.h"
+#include "pcf-bulk-create.h"
+#include "pcf-request.h"
 #include "npcf-process.h"
 #include "utils.h"
 
 
-static int client_notify_cb(int status, ogs_sbi_response_t *response, void *data);
-
 pcf_session_t *pcf_session_new(const ogs_sockaddr_t *pcf_address)
 {
     pcf_session_t *pcf_session;
-    OpenAPI_uri_scheme_e scheme = OpenAPI_uri_scheme_http;
 
     pcf_session = ogs_calloc(1, sizeof(pcf_session_t));
     if(!pcf_session){
         return NULL;
     }
-    ogs_copyaddrinfo(&pcf_session->pcf_addr, pcf_address);
-    
-    pcf_session->client = ogs_sbi_client_add(scheme, NULL /*pcf_session->pcf_addr.fqdn*/, 0 /*port_num*/,
-                                             (pcf_session->pcf_addr->ogs_sa_family == AF_INET)?pcf_session->pcf_addr:NULL,
-                                             (pcf_session->pcf_addr->ogs_sa_family == AF_INET6)?pcf_session->pcf_addr:NULL);
-    if(!pcf_session->client) {
-	ogs_freeaddrinfo(pcf_session->pcf_addr);
+
+    /* share the SBI client of any other session for this PCF */
+    pcf_session->connection = _pcf_client_context_connection_ref(pcf_address);
+    if(!pcf_session->connection) {
 	ogs_free(pcf_session);
         return NULL;
     }
+    pcf_session->pcf_addr = pcf_session->connection->pcf_addr;
+    pcf_session->client = pcf_session->connection->client;
+
     ogs_list_init(&pcf_session->pcf_app_sessions);
+    ogs_list_init(&pcf_session->bulk_creates);
+    _pcf_session_requests_init(pcf_session);
     ogs_list_add(&pcf_self()->pcf_sessions, pcf_session);
     return pcf_session;
 }
 
+void pcf_session_set_max_in_flight(pcf_session_t *session, size_t max_in_flight, bool reject_when_full)
+{
+    if (!session) return;
+    _pcf_session_set_max_in_flight(session, max_in_flight, reject_when_full);
+}
+
+bool pcf_session_set_retry_policy(pcf_session_t *session, pcf_request_operation_t operation,
+                                  const pcf_retry_policy_t *policy)
+{
+    if (!session) return false;
+    return _pcf_session_set_retry_policy(session, operation, policy);
+}
+
+size_t pcf_session_requests_in_flight(const pcf_session_t *session)
+{
+    if (!session) return 0;
+    return session->requests.num_sent;
+}
+
+size_t pcf_session_requests_queued(const pcf_session_t *session)
+{
+    if (!session) return 0;
+    return session->requests.num_queued;
+}
+
 void pcf_service_consumer_final(void)
 {
     pcf_context_final();
@@ -48,12 +74,12 @@ void pcf_service_consumer_final(void)
 void pcf_session_free(pcf_session_t *session)
 {
     ogs_assert(session);
+    _pcf_bulk_create_cancel_all(session);
     pcf_sess_remove_all(session);  //Free pcf_app_sessions
+    _pcf_session_requests_clear(session);
+    _pcf_client_context_notification_server_remove(session);
     ogs_list_remove(&pcf_self()->pcf_sessions, session);
-    if(session->pcf_addr)
-    	ogs_freeaddrinfo(session->pcf_addr);
-    if(session->client)
-        ogs_sbi_client_remove(session->client);
+    _pcf_client_context_connection_unref(session->connection);
     ogs_free(session);
 }
 
@@ -62,26 +88,64 @@ bool pcf_session_create_app_session(pcf_session_t *session,
                 OpenAPI_list_t *media_component,
                 pcf_app_session_notification_callback notify_callback, void *notify_user_data,
                 pcf_app_session_change_callback change_callback, void *change_user_data)
+{
+    return _pcf_session_create_app_session(session, ue_connection, events, NULL, media_component, notify_callback,
+                                           notify_user_data, change_callback, change_user_data) != NULL;
+}
+
+bool pcf_session_create_app_session_with_media_profile(pcf_session_t *session,
+                const ue_network_identifier_t *ue_connection, int events,
+                const char *media_profile, OpenAPI_list_t *media_component,
+                pcf_app_session_notification_callback notify_callback, void *notify_user_data,
+                pcf_app_session_change_callback change_callback, void *change_user_data)
+{
+    return _pcf_session_create_app_session(session, ue_connection, events, media_profile, media_component, notify_callback,
+                                           notify_user_data, change_callback, change_user_data) != NULL;
+}
+
+bool pcf_session_create_app_sessions(pcf_session_t *session,
+                const pcf_app_session_create_item_t *items, size_t num_items, int events, size_t max_in_flight,
+                pcf_app_session_notification_callback notify_callback, void *notify_user_data,
+                pcf_app_session_change_callback change_callback, void *change_user_data,
+                pcf_app_sessions_create_result_callback result_callback,
+                pcf_app_sessions_create_done_callback done_callback, void *result_user_data)
+{
+    return _pcf_bulk_create_start(session, items, num_items, events, max_in_flight, notify_callback, notify_user_data,
+                                  change_callback, change_user_data, result_callback, done_callback, result_user_data);
+}
+
+/* Send the create request for a new AppSession, returns the AppSession awaiting the PCF response or NULL on error */
+pcf_app_session_t *_pcf_session_create_app_session(pcf_session_t *session,
+                const ue_network_identifier_t *ue_connection, int events,
+                const char *media_profile, OpenAPI_list_t *media_component,
+                pcf_app_session_notification_callback notify_callback, void *notify_user_data,
+                pcf_app_session_change_callback change_callback, void *change_user_data)
 {
     pcf_app_session_t *sess; 
     ogs_sbi_request_t *request;
     bool rv;
 
     sess = _pcf_app_session_new(session, ue_connection, events, notify_callback, notify_user_data, change_callback, change_user_data);
-    if(!sess)
-        return false;
+    if(!sess) {
+        if (media_component) _pcf_media_components_free(media_component);
+        return NULL;
+    }
 
     _pcf_client_sess_ipv4addr_set_from_sockaddr(sess, (const ogs_sockaddr_t *)sess->ue_network_identifier->address);
 
     _pcf_client_sess_ipv6prefix_set_from_sockaddr(sess, (const ogs_sockaddr_t *)sess->ue_network_identifier->address);
 
-    request = pcf_policyauthorization_request_create(sess, media_component, events);
-    rv =  ogs_sbi_client_send_request(session->client, client_notify_cb, request, sess);
+    request = pcf_policyauthorization_request_create(sess, media_profile, media_component, events);
+    if (!request) {
+        _pcf_app_session_free(sess);
+        return NULL;
+    }
+    rv = _pcf_session_send_request(session, request, sess->handle, PCF_REQUEST_OPERATION_CREATE);
     if (ogs_unlikely(rv == false)) {
-        ogs_error("Error sending request");
-    }      
-    ogs_sbi_request_free(request);
-    return rv;
+        _pcf_app_session_free(sess);
+        return NULL;
+    }
+    return sess;
 }
 
 bool pcf_session_update_app_session(pcf_app_session_t *app_sess, OpenAPI_list_t *media_component)
@@ -90,27 +154,44 @@ bool pcf_session_update_app_session(pcf_app_session_t *app_sess, OpenAPI_list_t
     ogs_sbi_request_t *request;
     bool rv;
     pcf_app_session_t *sess;
+    cJSON *patch;
+    uintptr_t request_id;
 
-    if(!app_sess)
+    if(!app_sess) {
+        if (media_component) _pcf_media_components_free(media_component);
         return false;
+    }
 
     sess = _pcf_client_context_active_sessions_exists(app_sess);
 
     if(sess){
 
-        request = pcf_policyauthorization_request_update(sess, media_component);
+        if (!_pcf_app_session_media_components_diff(sess, media_component, &patch)) {
+            ogs_error("Invalid MediaComponentRm in AppSessionContext update");
+            return false;
+        }
+
+        /* nothing has changed, the PCF already has these media components */
+        if (!patch) return true;
+
+        request = pcf_policyauthorization_request_update(sess, patch);
+        if (!request) {
+            cJSON_Delete(patch);
+            return false;
+        }
 
-        rv =  ogs_sbi_client_send_request(sess->pcf_session->client, client_notify_cb, request, sess);
-        ogs_expect(rv == true);
+        rv = _pcf_session_send_request_with_id(sess->pcf_session, request, sess->handle, PCF_REQUEST_OPERATION_UPDATE,
+                                               &request_id);
         if (rv == false){
-            ogs_error("Error sending request");
-            ogs_sbi_request_free(request);
+            cJSON_Delete(patch);
             return false;
         }
 
-        ogs_sbi_request_free(request);
+        _pcf_app_session_media_components_sent(sess, request_id, patch);
+        cJSON_Delete(patch);
         return true;
     }
+    if (media_component) _pcf_media_components_free(media_component);
     return false;
 }
 
@@ -124,12 +205,11 @@ void pcf_app_session_free(pcf_app_session_t *sess)
 
     request = pcf_policyauthorization_request_delete(sess);
     ogs_assert(sess->pcf_session->client);
-    rv =  ogs_sbi_client_send_request(sess->pcf_session->client, client_notify_cb, request, sess);
+    rv = _pcf_session_send_request(sess->pcf_session, request, sess->handle, PCF_REQUEST_OPERATION_DELETE);
     if (rv == false){
         ogs_error("Error sending request to delete");
        
     }
-    ogs_sbi_request_free(request);
 
     /*_pcf_app_session_free(sess);*/
 }
@@ -142,28 +222,36 @@ bool pcf_app_session_subscribe_event(pcf_app_session_t *app_session,
     bool rv;
     int merged = 0;
     int events_mask;
+    long num_events;
 
     if(!app_session || !callback)
         return false;
 
-    events_mask = events_subsc_req_data_to_events_mask(evt_subsc_req);
-    _pcf_app_session_add_event_notification(app_session, events_mask, callback, user_data);
+    /* leave the AppSession as it was if the request can't be sent */
+    if (_pcf_session_request_refused(app_session->pcf_session, PCF_REQUEST_OPERATION_SUBSCRIBE)) {
+        ogs_error("Error sending request to subscribe");
+        return false;
+    }
 
+    num_events = app_session->pcf_app_session_context_requested->asc_req_data->ev_subsc->events->count;
     merged = merge_event_subsc_to_app_session_context(app_session, evt_subsc_req);
 
     if (merged) {
         request = pcf_policyauthorization_req_subscribe_event(app_session);
 
-        rv =  ogs_sbi_client_send_request(app_session->pcf_session->client, client_notify_cb, request, app_session);
+        rv = _pcf_session_send_request(app_session->pcf_session, request, app_session->handle, PCF_REQUEST_OPERATION_SUBSCRIBE);
 
         if (rv == false){
-            ogs_error("Error sending request to delete");
+            ogs_error("Error sending request to subscribe");
+            unmerge_event_subsc_from_app_session_context(app_session, num_events);
+            return false;
 	}
 
-        ogs_sbi_request_free(request);
-
     }   
 
+    events_mask = events_subsc_req_data_to_events_mask(evt_subsc_req);
+    _pcf_app_session_add_event_notification(app_session, events_mask, callback, user_data);
+
     return true;
 }
 
@@ -178,12 +266,12 @@ bool pcf_app_session_unsubscribe_event(pcf_app_session_t *app_session,
 
     request = pcf_policyauthorization_req_unsubscribe_event(app_session);
 
-    rv =  ogs_sbi_client_send_request(app_session->pcf_session->client, client_notify_cb, request, app_session);
+    rv = _pcf_session_send_request(app_session->pcf_session, request, app_session->handle, PCF_REQUEST_OPERATION_SUBSCRIBE);
 
     if (rv == false){
-       ogs_error("Error sending request to delete");
+       ogs_error("Error sending request to unsubscribe");
+       return 0;
     }
-    ogs_sbi_request_free(request);
 
     return 1;
 
@@ -194,38 +282,5 @@ bool pcf_session_process_event(ogs_event_t *e)
     return _pcf_process_event(e);
 }
 
-/******************* Private functions ********************/
-
-static int client_notify_cb(int status, ogs_sbi_response_t *response, void *data)
-{
-    int rv;
-    ogs_event_t *event;
-
-    ogs_assert(data);
-
-    if (status != OGS_OK) {
-        ogs_log_message(
-                status == OGS_DONE ? OGS_LOG_DEBUG : OGS_LOG_WARN, 0,
-                "client_notify_cb() failed [%d]", status);
-    }
-
-    event = ogs_event_new(OGS_EVENT_SBI_CLIENT);
-    event->sbi.response = response;
-    event->sbi.data = data;
-    event->sbi.state = status;
-
-    rv = ogs_queue_push(ogs_app()->queue, event);
-    if (rv !=OGS_OK) {
-        ogs_error("OGS Queue Push failed %d", rv);
-        ogs_sbi_response_free(response);
-        ogs_event_free(event);
-        return OGS_ERROR;
-    }
-
-    ogs_pollset_notify(ogs_app()->pollset);
-	    
-    return (status == OGS_OK)?OGS_OK:OGS_ERROR;
-}
-
 /* vim:ts=8:sts=4:sw=4:expandtab:
  */
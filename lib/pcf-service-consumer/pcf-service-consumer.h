@@ -92,6 +92,37 @@ typedef struct ue_network_identifier_s {
     char *ip_domain;         /** The IP domain for the UE's PDU session. */
 } ue_network_identifier_t;
 
+/**
+ * One AppSessionContext to create with pcf_session_create_app_sessions()
+ */
+typedef struct pcf_app_session_create_item_s {
+    const ue_network_identifier_t *ue_connection; /** The UE that this AppSessionContext will be for. */
+    OpenAPI_list_t *media_component;              /** The `MediaComponent` map for this AppSessionContext, the library takes
+                                                      ownership, even if pcf_session_create_app_sessions() fails. */
+    const char *media_profile;                    /** Identifies @p media_component as one of the caller's media profiles,
+                                                      or NULL. See pcf_session_create_app_session_with_media_profile(). */
+} pcf_app_session_create_item_t;
+
+/**
+ * Callback for the result of one item in pcf_session_create_app_sessions()
+ *
+ * @param item The index of the item in the array passed to pcf_session_create_app_sessions().
+ * @param app_session The AppSessionContext created, or NULL if it could not be created.
+ * @param user_data The `result_user_data` passed to pcf_session_create_app_sessions().
+ */
+typedef void (*pcf_app_sessions_create_result_callback)(size_t item, pcf_app_session_t *app_session, void *user_data);
+
+/**
+ * Callback for the completion of pcf_session_create_app_sessions()
+ *
+ * Called once every item has been reported to the result callback.
+ *
+ * @param created The number of AppSessionContexts created.
+ * @param failed The number of AppSessionContexts that could not be created.
+ * @param user_data The `result_user_data` passed to pcf_session_create_app_sessions().
+ */
+typedef void (*pcf_app_sessions_create_done_callback)(size_t created, size_t failed, void *user_data);
+
 /**
  * AppSessionContext event notification bits
  *
@@ -126,6 +157,34 @@ typedef enum pcf_app_session_event_type_e {
     PCF_APP_SESSION_EVENT_TYPE_ALL = 0xFFFFF
 } pcf_app_session_event_type_t;
 
+/**
+ * The kinds of request to the PCF, each with its own retry policy
+ */
+typedef enum pcf_request_operation_e {
+    PCF_REQUEST_OPERATION_CREATE = 0, /**< Creating an AppSessionContext */
+    PCF_REQUEST_OPERATION_UPDATE,     /**< Updating the MediaComponents of an AppSessionContext */
+    PCF_REQUEST_OPERATION_SUBSCRIBE,  /**< Subscribing to, or unsubscribing from, AppSessionContext events */
+    PCF_REQUEST_OPERATION_DELETE,     /**< Releasing an AppSessionContext */
+    PCF_REQUEST_OPERATION_MAX
+} pcf_request_operation_t;
+
+/**
+ * How a request is retried after a 429 or 503 response, and optionally after a timeout, a connection failure or a 504
+ * response
+ *
+ * A timeout, connection failure or 504 leaves it unknown whether the PCF acted on the request, so those are only
+ * retried when `retry_unanswered` is set. Each retry waits for a random time between half and all of the backoff. The backoff starts at
+ * `initial_backoff` and doubles after each retry, up to `max_backoff`. A longer Retry-After from the PCF is
+ * used instead.
+ */
+typedef struct pcf_retry_policy_s {
+    unsigned int max_attempts;  /** Most times to send the request, including the first, 1 for no retries. */
+    ogs_time_t deadline;        /** Longest after the first attempt to still send a retry, 0 for no limit. */
+    ogs_time_t initial_backoff; /** Backoff before the first retry. */
+    ogs_time_t max_backoff;     /** Longest backoff. */
+    bool retry_unanswered;      /** `true` to also retry after a timeout, a connection failure or a 504 response. */
+} pcf_retry_policy_t;
+
 /**
  * Create a new PCF session
  *
@@ -139,6 +198,58 @@ typedef enum pcf_app_session_event_type_e {
  */
 PCF_SVC_CONSUMER_API pcf_session_t *pcf_session_new(const ogs_sockaddr_t *pcf_address);
 
+/**
+ * Limit the requests a PCF session has outstanding
+ *
+ * Requests beyond @p max_in_flight wait in a queue and are sent in order as responses arrive. With
+ * @p reject_when_full the create, update and subscribe calls instead fail straight away while the limit is
+ * reached. Releasing an AppSessionContext is always queued. New sessions allow 128 requests and queue.
+ *
+ * @param session The PCF session to limit.
+ * @param max_in_flight The most requests to have sent and awaiting a response, 0 for no limit.
+ * @param reject_when_full `true` to refuse requests while @p max_in_flight are outstanding, `false` to queue them.
+ */
+PCF_SVC_CONSUMER_API void pcf_session_set_max_in_flight(pcf_session_t *session, size_t max_in_flight, bool reject_when_full);
+
+/**
+ * Set how one kind of request is retried on a PCF session
+ *
+ * Once a request has used all its attempts, or the deadline has passed, the AppSessionContext is treated as
+ * failed. It is removed and the change callback is called with `NULL`. If an update or subscription failed, the
+ * PCF is first asked to release the AppSessionContext.
+ *
+ * The defaults are 3 attempts for creates, updates and subscriptions, and 5 attempts for releases. All
+ * operations default to a 30 second deadline and a backoff from 250ms up to 5s. Creates are only retried after a 429 or
+ * 503 response by default, as a repeated create could leave a second AppSessionContext on the PCF; the other
+ * operations also retry unanswered requests.
+ *
+ * @param session The PCF session to set the policy for.
+ * @param operation The kind of request the policy is for.
+ * @param policy The retry policy, this is copied.
+ *
+ * @return `true` if the policy was set or `false` if a parameter was invalid.
+ */
+PCF_SVC_CONSUMER_API bool pcf_session_set_retry_policy(pcf_session_t *session, pcf_request_operation_t operation,
+                                                       const pcf_retry_policy_t *policy);
+
+/**
+ * Get the number of requests sent on a PCF session and awaiting a response
+ *
+ * @param session The PCF session to check.
+ *
+ * @return The number of requests in flight.
+ */
+PCF_SVC_CONSUMER_API size_t pcf_session_requests_in_flight(const pcf_session_t *session);
+
+/**
+ * Get the number of requests waiting for a PCF session to have room to send them
+ *
+ * @param session The PCF session to check.
+ *
+ * @return The queue depth.
+ */
+PCF_SVC_CONSUMER_API size_t pcf_session_requests_queued(const pcf_session_t *session);
+
 /**
  * Tidy up PCF service consumer
  *
@@ -166,11 +277,74 @@ PCF_SVC_CONSUMER_API bool pcf_session_create_app_session(pcf_session_t *session,
                 pcf_app_session_notification_callback notify_callback, void *notify_user_data,
                 pcf_app_session_change_callback change_callback, void *change_user_data);
 
+/**
+ * Create a new AppSessionContext for one of the caller's media profiles
+ *
+ * As pcf_session_create_app_session(), but @p media_profile names the shape of @p media_component. Every AppSessionContext
+ * created for the same AF application with the same @p media_profile must use the same media components, as the
+ * serialised media components of the first one are reused for the others without looking at @p media_component again.
+ *
+ * @param session The PCF connection session to create the new AppSessionContext on.
+ * @param ue_connection The address of the UE that this AppSessionContext will be for.
+ * @param events The bit mask of the ORed `pcf_app_session_event_type_t` representing the notifications to report to
+ *               @p notify_callback.
+ * @param media_profile The caller's identifier for the media components, NULL to behave as pcf_session_create_app_session().
+ * @param media_component The requested list of `MediaComponent` entries describing UE connections and requested bitrates that this
+ *                        AppSessionContext will manage.
+ * @param notify_callback The callback to use when a notification matching one of @p events is received for this AppSessionContext.
+ * @param notify_user_data The `user_data` to pass to the @p notify_callback when it's called.
+ * @param change_callback The callback to call when an AppSessionContext is created or destroyed by the PCF.
+ * @param change_user_data The `user_data` to pass to the @p change_callback when it's called.
+ */
+PCF_SVC_CONSUMER_API bool pcf_session_create_app_session_with_media_profile(pcf_session_t *session,
+                const ue_network_identifier_t *ue_connection, int events,
+                const char *media_profile, OpenAPI_list_t *media_component,
+                pcf_app_session_notification_callback notify_callback, void *notify_user_data,
+                pcf_app_session_change_callback change_callback, void *change_user_data);
+
+/**
+ * Create many AppSessionContexts
+ *
+ * The POST requests are pipelined over the PCF session's connection, with at most @p max_in_flight outstanding at once. Each
+ * item is reported to @p result_callback as its response arrives, then @p done_callback is called once for the whole batch.
+ * Items that fail before their request is sent are reported straight away, so @p result_callback, and @p done_callback if
+ * every item fails that way, may be called before pcf_session_create_app_sessions() returns.
+ *
+ * The PCF session must not be freed from inside @p result_callback or @p done_callback. If the PCF session is freed before
+ * the batch completes, the items not yet created are reported as failed.
+ *
+ * @param session The PCF connection session to create the AppSessionContexts on.
+ * @param items The AppSessionContexts to create, the array can be freed once this returns.
+ * @param num_items The number of entries in @p items.
+ * @param events The bit mask of the ORed `pcf_app_session_event_type_t` to report to @p notify_callback for every item.
+ * @param max_in_flight The most create requests to have outstanding at once, 0 for the default.
+ * @param notify_callback The callback to use when a notification matching one of @p events is received.
+ * @param notify_user_data The `user_data` to pass to the @p notify_callback when it's called.
+ * @param change_callback The callback to call when an AppSessionContext is created or destroyed by the PCF.
+ * @param change_user_data The `user_data` to pass to the @p change_callback when it's called.
+ * @param result_callback The callback for the result of each item, may be NULL.
+ * @param done_callback The callback for when every item has a result, may be NULL.
+ * @param result_user_data The `user_data` to pass to @p result_callback and @p done_callback.
+ *
+ * @return `true` if the batch was started, the callbacks will then be called, or `false` on error.
+ */
+PCF_SVC_CONSUMER_API bool pcf_session_create_app_sessions(pcf_session_t *session,
+                const pcf_app_session_create_item_t *items, size_t num_items, int events, size_t max_in_flight,
+                pcf_app_session_notification_callback notify_callback, void *notify_user_data,
+                pcf_app_session_change_callback change_callback, void *change_user_data,
+                pcf_app_sessions_create_result_callback result_callback,
+                pcf_app_sessions_create_done_callback done_callback, void *result_user_data);
+
 /**
  * Update the MediaComponents for an AppSessionContext
  *
+ * Only the MediaComponentRm fields that differ from what the PCF already has are sent, as a merge patch. If
+ * nothing differs no request is sent. A null field, or a media component mapped to NULL, removes it.
+ *
  * @param sess The AppSessionContext to update the MediaComponents for.
- * @param media_component_rm_map The map of MediaComponentRm entries for the update.
+ * @param media_component_rm_map The map of MediaComponentRm entries for the update, this is freed.
+ *
+ * @return `true` if the update was sent or wasn't needed, or `false` on error.
  */
 PCF_SVC_CONSUMER_API bool pcf_session_update_app_session(pcf_app_session_t *sess, OpenAPI_list_t *media_component_rm_map);
 
@@ -18,6 +18,15 @@
 extern "C" {
 #endif
 
+/* longest AfEvent name we look up, longer names are not AfEvents */
+#define AF_EVENT_NAME_MAX 40
+
+static const char *__skip_ws(const char *p, const char *end);
+static const char *__scan_string(const char *p, const char *end, const char **str, size_t *str_len, bool *escaped);
+static const char *__skip_value(const char *p, const char *end);
+static const char *__scan_ev_notifs(const char *p, const char *end, int *events_mask);
+static int __af_event_name_to_event_mask(const char *name, size_t len);
+
 /* Library Internals */
 char *_sockaddr_to_string(const ogs_sockaddr_t *addr)
 {
@@ -103,6 +112,196 @@ int _npcf_af_event_to_event_mask(const OpenAPI_npcf_af_event_e event_type)
     return 0;
 }
 
+/* Find the events in an EventsNotification body without building a cJSON or OpenAPI tree, only the
+ * evNotifs[].event values are looked at. Unknown event names add nothing to the mask.
+ *
+ * Returns false if the body couldn't be scanned, it should then be fully parsed to find out why.
+ */
+bool _events_notification_prescan(const char *json, size_t len, int *events_mask)
+{
+    const char *p = json;
+    const char *end = json + len;
+    bool found = false;
+
+    *events_mask = 0;
+
+    if (!json) return false;
+
+    p = __skip_ws(p, end);
+    if (p == end || *p != '{') return false;
+    p = __skip_ws(p + 1, end);
+
+    if (p != end && *p == '}') return false; /* evNotifs is mandatory */
+
+    while (p != end) {
+        const char *key;
+        size_t key_len;
+        bool escaped;
+
+        p = __scan_string(p, end, &key, &key_len, &escaped);
+        /* an escaped member name might still be evNotifs */
+        if (!p || escaped) return false;
+
+        p = __skip_ws(p, end);
+        if (p == end || *p != ':') return false;
+        p = __skip_ws(p + 1, end);
+
+        if (key_len == 8 && !memcmp(key, "evNotifs", 8)) {
+            if (found) return false;
+            found = true;
+            p = __scan_ev_notifs(p, end, events_mask);
+        } else {
+            p = __skip_value(p, end);
+        }
+        if (!p) return false;
+
+        p = __skip_ws(p, end);
+        if (p == end) return false;
+        if (*p == '}') break;
+        if (*p != ',') return false;
+        p = __skip_ws(p + 1, end);
+    }
+    if (p == end) return false;
+
+    /* only whitespace may follow */
+    if (__skip_ws(p + 1, end) != end) return false;
+
+    return found;
+}
+
+/*** Private functions ***/
+
+static const char *__skip_ws(const char *p, const char *end)
+{
+    while (p != end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) p++;
+    return p;
+}
+
+/* p is at the opening quote, returns the position after the closing quote or NULL if there isn't one. The
+ * string is left as it appears in the JSON, escaped is set if it contains escapes. */
+static const char *__scan_string(const char *p, const char *end, const char **str, size_t *str_len, bool *escaped)
+{
+    const char *start;
+
+    if (p == end || *p != '"') return NULL;
+
+    *escaped = false;
+    start = ++p;
+    while (p != end && *p != '"') {
+        if (*p == '\\') {
+            *escaped = true;
+            if (++p == end) return NULL;
+        }
+        p++;
+    }
+    if (p == end) return NULL;
+
+    *str = start;
+    *str_len = p - start;
+
+    return p + 1;
+}
+
+/* Skip any JSON value without checking what is inside objects and arrays beyond matching their brackets */
+static const char *__skip_value(const char *p, const char *end)
+{
+    int depth = 0;
+
+    do {
+        if (p == end) return NULL;
+
+        if (*p == '"') {
+            const char *str;
+            size_t str_len;
+            bool escaped;
+
+            p = __scan_string(p, end, &str, &str_len, &escaped);
+            if (!p) return NULL;
+        } else if (*p == '{' || *p == '[') {
+            depth++;
+            p++;
+        } else if (*p == '}' || *p == ']') {
+            if (!depth) return NULL;
+            depth--;
+            p++;
+        } else if (depth) {
+            p++;
+        } else {
+            /* number, true, false or null */
+            const char *start = p;
+
+            while (p != end && *p != ',' && *p != '}' && *p != ']' &&
+                   *p != ' ' && *p != '\t' && *p != '\n' && *p != '\r') p++;
+            if (p == start) return NULL;
+        }
+    } while (depth);
+
+    return p;
+}
+
+/* p is at the evNotifs array, add each AfEventNotification event to events_mask */
+static const char *__scan_ev_notifs(const char *p, const char *end, int *events_mask)
+{
+    if (p == end || *p != '[') return NULL;
+    p = __skip_ws(p + 1, end);
+    if (p != end && *p == ']') return p + 1;
+
+    while (p != end) {
+        if (*p != '{') return NULL;
+        p = __skip_ws(p + 1, end);
+
+        while (p != end && *p != '}') {
+            const char *key;
+            size_t key_len;
+            bool escaped;
+
+            p = __scan_string(p, end, &key, &key_len, &escaped);
+            if (!p || escaped) return NULL;
+
+            p = __skip_ws(p, end);
+            if (p == end || *p != ':') return NULL;
+            p = __skip_ws(p + 1, end);
+
+            if (key_len == 5 && !memcmp(key, "event", 5) && p != end && *p == '"') {
+                const char *name;
+                size_t name_len;
+
+                p = __scan_string(p, end, &name, &name_len, &escaped);
+                if (!p || escaped) return NULL;
+                *events_mask |= __af_event_name_to_event_mask(name, name_len);
+            } else {
+                p = __skip_value(p, end);
+                if (!p) return NULL;
+            }
+
+            p = __skip_ws(p, end);
+            if (p != end && *p == ',') p = __skip_ws(p + 1, end);
+            else if (p == end || *p != '}') return NULL;
+        }
+        if (p == end) return NULL;
+        p = __skip_ws(p + 1, end);
+
+        if (p == end) return NULL;
+        if (*p == ']') return p + 1;
+        if (*p != ',') return NULL;
+        p = __skip_ws(p + 1, end);
+    }
+
+    return NULL;
+}
+
+static int __af_event_name_to_event_mask(const char *name, size_t len)
+{
+    char buf[AF_EVENT_NAME_MAX + 1];
+
+    if (len > AF_EVENT_NAME_MAX) return 0;
+
+    memcpy(buf, name, len);
+    buf[len] = '\0';
+
+    return _npcf_af_event_to_event_mask(OpenAPI_npcf_af_event_FromString(buf));
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -23,6 +23,7 @@ char *_sockaddr_to_string(const ogs_sockaddr_t *addr);
 extern int events_notification_to_events_mask(const OpenAPI_events_notification_t *events_notif);
 extern int events_subsc_req_data_to_events_mask(const OpenAPI_events_subsc_req_data_t *evt_subsc_req);
 extern int _npcf_af_event_to_event_mask(const OpenAPI_npcf_af_event_e event_type);
+extern bool _events_notification_prescan(const char *json, size_t len, int *events_mask);
 
 #ifdef __cplusplus
 }
@@ -483,6 +483,45 @@ static void test1_func(abts_case *tc, void *data)
     ogs_msleep(1000);
     
     ogs_debug("BSF result = %s:%i", pcf_bind_result.pcf_address?pcf_bind_result.pcf_address:"(nil)", pcf_bind_result.pcf_port);
+    ABTS_TRUE(tc, check_pcf_address_result(&pcf_bind_result, bsf_sess));
+    if (pcf_bind_result.pcf_address) ogs_free(pcf_bind_result.pcf_address);
+    pcf_bind_result.pcf_address = NULL;
+    pcf_bind_result.pcf_port = 0;
+
+    /* Second lookup should be answered from the cache with a shared binding */
+    rv = bsf_retrieve_pcf_binding_ref_for_pdu_session(ue_address, bsf_retrieve_pcf_binding_ref_for_ue, &pcf_bind_result);
+    ABTS_INT_EQUAL(tc, 1, rv);
+
+    ogs_msleep(100);
+
+    ABTS_TRUE(tc, check_pcf_address_result(&pcf_bind_result, bsf_sess));
+    if (pcf_bind_result.pcf_address) ogs_free(pcf_bind_result.pcf_address);
+    pcf_bind_result.pcf_address = NULL;
+    pcf_bind_result.pcf_port = 0;
+
+    /* Batch lookup with a duplicated address should give one answer per address */
+    {
+        ogs_sockaddr_t *ue_addresses[2];
+
+        ue_addresses[0] = ue_address;
+        ue_addresses[1] = ue_address;
+        rv = bsf_retrieve_pcf_bindings(ue_addresses, 2, bsf_retrieve_pcf_bindings_for_ues, &pcf_bind_result);
+        ABTS_INT_EQUAL(tc, 1, rv);
+    }
+
+    ogs_msleep(100);
+
+    ABTS_TRUE(tc, check_pcf_address_result(&pcf_bind_result, bsf_sess));
+    if (pcf_bind_result.pcf_address) ogs_free(pcf_bind_result.pcf_address);
+    pcf_bind_result.pcf_address = NULL;
+    pcf_bind_result.pcf_port = 0;
+
+    /* Lookup by SUPI and DNN should find the binding already cached for the UE address */
+    rv = bsf_retrieve_pcf_binding_ref_for_supi(bsf_sess->supi, bsf_sess->dnn, NULL, bsf_retrieve_pcf_binding_ref_for_ue, &pcf_bind_result);
+    ABTS_INT_EQUAL(tc, 1, rv);
+
+    ogs_msleep(100);
+
     ABTS_TRUE(tc, check_pcf_address_result(&pcf_bind_result, bsf_sess));
     if (pcf_bind_result.pcf_address) ogs_free(pcf_bind_result.pcf_address);
 
@@ -539,3 +578,46 @@ bool bsf_retrieve_pcf_binding_for_ue(OpenAPI_pcf_binding_t *pcf_binding, void *d
    return false;
 }
 
+
+bool bsf_retrieve_pcf_binding_ref_for_ue(bsf_pcf_binding_t *pcf_binding, void *data){
+   const OpenAPI_pcf_binding_t *binding;
+   pcf_binding_result_t *result = (pcf_binding_result_t*)data;
+
+   ogs_debug("bsf_retrieve_pcf_binding_ref_for_ue(pcf_binding=%p, data=%p)", pcf_binding, data);
+
+   binding = bsf_pcf_binding_get(pcf_binding);
+   if (!binding) return false;
+
+   if (result) {
+       OpenAPI_ip_end_point_t *endp;
+
+       endp = (OpenAPI_ip_end_point_t*)OpenAPI_list_find(binding->pcf_ip_end_points, 0)->data;
+       if (endp->ipv6_address) {
+           result->pcf_address = ogs_strdup(endp->ipv6_address);
+       } else if (endp->ipv4_address) {
+           result->pcf_address = ogs_strdup(endp->ipv4_address);
+       }
+       result->pcf_port = endp->port;
+   }
+
+   bsf_pcf_binding_unref(pcf_binding);
+   return true;
+}
+
+void bsf_retrieve_pcf_bindings_for_ues(const bsf_pcf_binding_result_t *results, size_t count, void *data)
+{
+    pcf_binding_result_t *result = (pcf_binding_result_t*)data;
+    size_t i;
+
+    ogs_debug("bsf_retrieve_pcf_bindings_for_ues(results=%p, count=%zu, data=%p)", results, count, data);
+
+    for (i = 0; i < count; i++) {
+        /* duplicates share the same binding */
+        if (results[i].pcf_binding != results[0].pcf_binding) return;
+    }
+
+    if (count && result) {
+        bsf_pcf_binding_ref(results[0].pcf_binding);
+        bsf_retrieve_pcf_binding_ref_for_ue(results[0].pcf_binding, result);
+    }
+}
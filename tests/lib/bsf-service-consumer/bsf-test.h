@@ -12,6 +12,8 @@
 
 #include "test-common.h"
 
+#include "bsf-service-consumer.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -19,6 +21,8 @@ extern "C" {
 extern int bsf_test_initialise(void);
 extern void bsf_test_terminate(void);
 extern bool bsf_retrieve_pcf_binding_for_ue(OpenAPI_pcf_binding_t *pcf_binding, void *data);
+extern bool bsf_retrieve_pcf_binding_ref_for_ue(bsf_pcf_binding_t *pcf_binding, void *data);
+extern void bsf_retrieve_pcf_bindings_for_ues(const bsf_pcf_binding_result_t *results, size_t count, void *data);
 extern abts_suite *test_bsf(abts_suite *suite);
 
 #ifdef __cplusplus
@@ -0,0 +1,11 @@
+/*
+ * License: 5G-MAG Public License (v1.0)
+ * Copyright: (C) 2025 British Broadcasting Corporation
+ *
+ * For full license terms please see the LICENSE file distributed with this
+ * program. If this file is missing then the license can be retrieved from
+ * https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
+ */
+#include "json-merge-patch.c"
+/* vim:ts=8:sts=4:sw=4:expandtab:
+ */
@@ -0,0 +1,269 @@
+/*
+ * License: 5G-MAG Public License (v1.0)
+ * Copyright: (C) 2025 British Broadcasting Corporation
+ *
+ * For full license terms please see the LICENSE file distributed with this
+ * program. If this file is missing then the license can be retrieved from
+ * https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
+ */
+#include <stdarg.h>
+#include <stdbool.h>
+
+#include "ogs-core.h"
+
+#include "cache-policy.h"
+
+#include "unit-test.h"
+
+/* Sun, 06 Nov 1994 08:49:37 GMT */
+#define RESPONSE_TIME ogs_time_from_sec(784111777)
+#define DEFAULT_MAX_AGE 5
+
+#define UT_FRESH_FOR(POLICY, SECONDS) UT_INT_EQUAL((int)(((POLICY).fresh_until - RESPONSE_TIME) / OGS_USEC_PER_SEC), (SECONDS))
+
+static void __policy(cache_policy_t *policy, ...);
+
+static bool test_max_age(unit_test_ctx *ctx)
+{
+    cache_policy_t policy;
+
+    __policy(&policy, "Cache-Control", "max-age=60", NULL);
+    UT_FRESH_FOR(policy, 60);
+    UT_BOOL_FALSE(policy.no_store);
+    UT_BOOL_FALSE(policy.must_revalidate);
+    UT_INT_EQUAL(policy.stale_while_revalidate, -1);
+    UT_INT_EQUAL(policy.stale_if_error, -1);
+    UT_STR_EQUAL(policy.etag, "");
+
+    /* quoted arguments and any case of header and directive names */
+    __policy(&policy, "cache-control", "Max-Age=\"45\"", NULL);
+    UT_FRESH_FOR(policy, 45);
+
+    /* an invalid max-age means already stale */
+    __policy(&policy, "Cache-Control", "max-age=soon", NULL);
+    UT_FRESH_FOR(policy, 0);
+
+    /* with no freshness information the default is used */
+    __policy(&policy, "Content-Type", "application/json", NULL);
+    UT_FRESH_FOR(policy, DEFAULT_MAX_AGE);
+
+    return true;
+}
+
+static bool test_s_maxage(unit_test_ctx *ctx)
+{
+    cache_policy_t policy;
+
+    /* the cache is shared, so s-maxage wins over max-age */
+    __policy(&policy, "Cache-Control", "max-age=60, s-maxage=30", NULL);
+    UT_FRESH_FOR(policy, 30);
+
+    __policy(&policy, "Cache-Control", "s-maxage=90,max-age=10", NULL);
+    UT_FRESH_FOR(policy, 90);
+
+    return true;
+}
+
+static bool test_expires(unit_test_ctx *ctx)
+{
+    cache_policy_t policy;
+
+    __policy(&policy, "Date", "Sun, 06 Nov 1994 08:49:37 GMT", "Expires", "Sun, 06 Nov 1994 08:50:37 GMT", NULL);
+    UT_FRESH_FOR(policy, 60);
+
+    /* without a Date, Expires is relative to when the response arrived */
+    __policy(&policy, "Expires", "Sun, 06 Nov 1994 08:51:37 GMT", NULL);
+    UT_FRESH_FOR(policy, 120);
+
+    /* an invalid Expires means already expired */
+    __policy(&policy, "Expires", "0", NULL);
+    UT_FRESH_FOR(policy, 0);
+
+    /* max-age wins over Expires */
+    __policy(&policy, "Cache-Control", "max-age=10", "Expires", "Sun, 06 Nov 1994 08:50:37 GMT", NULL);
+    UT_FRESH_FOR(policy, 10);
+
+    return true;
+}
+
+static bool test_age(unit_test_ctx *ctx)
+{
+    cache_policy_t policy;
+
+    __policy(&policy, "Cache-Control", "max-age=60", "Age", "20", NULL);
+    UT_FRESH_FOR(policy, 40);
+
+    __policy(&policy, "Cache-Control", "max-age=60", "Age", "100", NULL);
+    UT_FRESH_FOR(policy, 0);
+
+    __policy(&policy, "Cache-Control", "max-age=60", "Age", "old", NULL);
+    UT_FRESH_FOR(policy, 60);
+
+    /* the apparent age from Date counts when it is larger than Age */
+    __policy(&policy, "Cache-Control", "max-age=60", "Date", "Sun, 06 Nov 1994 08:49:27 GMT", "Age", "5", NULL);
+    UT_FRESH_FOR(policy, 50);
+
+    __policy(&policy, "Cache-Control", "max-age=60", "Date", "Sun, 06 Nov 1994 08:49:27 GMT", "Age", "15", NULL);
+    UT_FRESH_FOR(policy, 45);
+
+    return true;
+}
+
+static bool test_no_store(unit_test_ctx *ctx)
+{
+    cache_policy_t policy;
+
+    __policy(&policy, "Cache-Control", "no-store, max-age=60", NULL);
+    UT_BOOL_TRUE(policy.no_store);
+    UT_FRESH_FOR(policy, 0);
+
+    /* no-cache would need revalidating on every use, so it isn't stored either */
+    __policy(&policy, "Cache-Control", "max-age=60, No-Cache", NULL);
+    UT_BOOL_TRUE(policy.no_store);
+    UT_FRESH_FOR(policy, 0);
+
+    __policy(&policy, "Cache-Control", "no-cache=\"Set-Cookie\"", NULL);
+    UT_BOOL_TRUE(policy.no_store);
+
+    return true;
+}
+
+static bool test_stale(unit_test_ctx *ctx)
+{
+    cache_policy_t policy;
+
+    __policy(&policy, "Cache-Control", "max-age=60, stale-while-revalidate=30, stale-if-error=600", NULL);
+    UT_FRESH_FOR(policy, 60);
+    UT_INT_EQUAL(policy.stale_while_revalidate, 30);
+    UT_INT_EQUAL(policy.stale_if_error, 600);
+    UT_BOOL_FALSE(policy.must_revalidate);
+
+    __policy(&policy, "Cache-Control", "stale-while-revalidate=later, stale-if-error", NULL);
+    UT_INT_EQUAL(policy.stale_while_revalidate, -1);
+    UT_INT_EQUAL(policy.stale_if_error, -1);
+
+    __policy(&policy, "Cache-Control", "max-age=60, must-revalidate", NULL);
+    UT_BOOL_TRUE(policy.must_revalidate);
+
+    __policy(&policy, "Cache-Control", "proxy-revalidate, max-age=60", NULL);
+    UT_BOOL_TRUE(policy.must_revalidate);
+
+    return true;
+}
+
+static bool test_etag(unit_test_ctx *ctx)
+{
+    cache_policy_t policy;
+
+    __policy(&policy, "ETag", " W/\"abc\" ", NULL);
+    UT_STR_EQUAL(policy.etag, "W/\"abc\"");
+
+    /* too long to keep */
+    __policy(&policy, "ETag", "\"0123456789012345678901234567890123456789012345678901234567890123456789012345678901\"", NULL);
+    UT_STR_EQUAL(policy.etag, "");
+
+    return true;
+}
+
+static bool test_http_date(unit_test_ctx *ctx)
+{
+    ogs_time_t t = 0;
+
+    UT_BOOL_TRUE(_cache_policy_parse_http_date("Sun, 06 Nov 1994 08:49:37 GMT", &t));
+    UT_BOOL_TRUE(t == RESPONSE_TIME);
+
+    UT_BOOL_TRUE(_cache_policy_parse_http_date("Thu, 29 Feb 2024 23:59:59 GMT", &t));
+    UT_BOOL_TRUE(t == ogs_time_from_sec(1709251199));
+
+    /* only IMF-fixdate is accepted */
+    UT_BOOL_FALSE(_cache_policy_parse_http_date("Sunday, 06-Nov-94 08:49:37 GMT", &t));
+    UT_BOOL_FALSE(_cache_policy_parse_http_date("Sun Nov  6 08:49:37 1994", &t));
+    UT_BOOL_FALSE(_cache_policy_parse_http_date("Sun, 06 Nov 1994 08:49:37 UTC", &t));
+    UT_BOOL_FALSE(_cache_policy_parse_http_date("Sun, 06 Nov 1994 08:49", &t));
+    UT_BOOL_FALSE(_cache_policy_parse_http_date("Sun, 06 Noo 1994 08:49:37 GMT", &t));
+    UT_BOOL_FALSE(_cache_policy_parse_http_date("Sun, 32 Nov 1994 08:49:37 GMT", &t));
+    UT_BOOL_FALSE(_cache_policy_parse_http_date(NULL, &t));
+
+    return true;
+}
+
+/* Work out the cache policy for a response received at RESPONSE_TIME with the NULL terminated header name and
+ * value pairs */
+static void __policy(cache_policy_t *policy, ...)
+{
+    ogs_hash_t *headers = ogs_hash_make();
+    const char *name;
+    va_list ap;
+
+    ogs_assert(headers);
+
+    va_start(ap, policy);
+    while ((name = va_arg(ap, const char *))) {
+        const char *value = va_arg(ap, const char *);
+
+        ogs_hash_set(headers, name, OGS_HASH_KEY_STRING, value);
+    }
+    va_end(ap);
+
+    _cache_policy_from_headers(headers, RESPONSE_TIME, DEFAULT_MAX_AGE, policy);
+
+    ogs_hash_destroy(headers);
+}
+
+/** Test descriptors **/
+
+static const unit_test_t test_max_age_desc = {
+    .name = "cache-policy: max-age",
+    .fn = test_max_age
+};
+
+static const unit_test_t test_s_maxage_desc = {
+    .name = "cache-policy: s-maxage",
+    .fn = test_s_maxage
+};
+
+static const unit_test_t test_expires_desc = {
+    .name = "cache-policy: Expires",
+    .fn = test_expires
+};
+
+static const unit_test_t test_age_desc = {
+    .name = "cache-policy: Age",
+    .fn = test_age
+};
+
+static const unit_test_t test_no_store_desc = {
+    .name = "cache-policy: no-store and no-cache",
+    .fn = test_no_store
+};
+
+static const unit_test_t test_stale_desc = {
+    .name = "cache-policy: stale-while-revalidate, stale-if-error and must-revalidate",
+    .fn = test_stale
+};
+
+static const unit_test_t test_etag_desc = {
+    .name = "cache-policy: ETag",
+    .fn = test_etag
+};
+
+static const unit_test_t test_http_date_desc = {
+    .name = "cache-policy: HTTP dates",
+    .fn = test_http_date
+};
+
+__attribute__ ((constructor))
+static void _init_fn()
+{
+    register_unit_test(&test_max_age_desc);
+    register_unit_test(&test_s_maxage_desc);
+    register_unit_test(&test_expires_desc);
+    register_unit_test(&test_age_desc);
+    register_unit_test(&test_no_store_desc);
+    register_unit_test(&test_stale_desc);
+    register_unit_test(&test_etag_desc);
+    register_unit_test(&test_http_date_desc);
+}
+
+/* vim:ts=8:sts=4:sw=4:expandtab:
+ */
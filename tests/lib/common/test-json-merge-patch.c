@@ -0,0 +1,203 @@
+/*
+ * License: 5G-MAG Public License (v1.0)
+ * Copyright: (C) 2025 British Broadcasting Corporation
+ *
+ * For full license terms please see the LICENSE file distributed with this
+ * program. If this file is missing then the license can be retrieved from
+ * https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
+ */
+#include <stdbool.h>
+
+#include "ogs-core.h"
+#include "ogs-sbi.h"
+
+#include "json-merge-patch.h"
+
+#include "unit-test.h"
+
+static bool __json_equal(const char *name, const cJSON *json, const char *expected);
+
+static bool test_apply_nested(unit_test_ctx *ctx)
+{
+    cJSON *target = cJSON_Parse("{\"a\":{\"b\":1,\"c\":2},\"d\":3}");
+    cJSON *patch = cJSON_Parse("{\"a\":{\"b\":5,\"c\":null},\"e\":{\"f\":{\"g\":1}}}");
+    bool ok;
+
+    UT_PTR_NOT_NULL(target);
+    UT_PTR_NOT_NULL(patch);
+
+    _json_merge_patch_apply(&target, patch);
+    ok = __json_equal("target", target, "{\"a\":{\"b\":5},\"d\":3,\"e\":{\"f\":{\"g\":1}}}");
+
+    cJSON_Delete(target);
+    cJSON_Delete(patch);
+
+    return ok;
+}
+
+static bool test_apply_nulls(unit_test_ctx *ctx)
+{
+    cJSON *target = cJSON_Parse("{\"a\":1,\"b\":{\"c\":2}}");
+    cJSON *patch = cJSON_Parse("{\"a\":null,\"x\":null,\"b\":{\"c\":null},\"n\":{\"m\":null,\"o\":{\"p\":null,\"q\":3}}}");
+    bool ok;
+
+    UT_PTR_NOT_NULL(target);
+    UT_PTR_NOT_NULL(patch);
+
+    /* nulls remove members, even inside members the target didn't have */
+    _json_merge_patch_apply(&target, patch);
+    ok = __json_equal("target", target, "{\"b\":{},\"n\":{\"o\":{\"q\":3}}}");
+
+    cJSON_Delete(target);
+    cJSON_Delete(patch);
+
+    return ok;
+}
+
+static bool test_apply_replace(unit_test_ctx *ctx)
+{
+    cJSON *target = cJSON_Parse("{\"a\":{\"b\":1},\"c\":[1,2]}");
+    cJSON *patch = cJSON_Parse("{\"a\":\"x\",\"c\":[{\"d\":null}]}");
+    cJSON *array = cJSON_Parse("[1,2]");
+    cJSON *none = NULL;
+    bool ok;
+
+    UT_PTR_NOT_NULL(target);
+    UT_PTR_NOT_NULL(patch);
+    UT_PTR_NOT_NULL(array);
+
+    /* anything but an object is replaced whole, arrays included */
+    _json_merge_patch_apply(&target, patch);
+    ok = __json_equal("target", target, "{\"a\":\"x\",\"c\":[{\"d\":null}]}");
+
+    /* a patch that isn't an object replaces the target */
+    _json_merge_patch_apply(&target, array);
+    if (ok) ok = __json_equal("target", target, "[1,2]");
+
+    /* with no target the patch is merged into an empty object */
+    _json_merge_patch_apply(&none, patch);
+    if (ok) ok = __json_equal("none", none, "{\"a\":\"x\",\"c\":[{\"d\":null}]}");
+
+    cJSON_Delete(target);
+    cJSON_Delete(patch);
+    cJSON_Delete(array);
+    cJSON_Delete(none);
+
+    return ok;
+}
+
+static bool test_diff_nested(unit_test_ctx *ctx)
+{
+    cJSON *base = cJSON_Parse("{\"a\":{\"b\":1,\"c\":2},\"d\":3,\"e\":[1]}");
+    cJSON *target = cJSON_Parse("{\"a\":{\"b\":1,\"c\":4},\"d\":null,\"e\":[1,2],\"f\":{\"g\":true}}");
+    cJSON *patch = NULL;
+    bool ok;
+
+    UT_PTR_NOT_NULL(base);
+    UT_PTR_NOT_NULL(target);
+
+    ok = _json_merge_patch_diff(base, target, &patch);
+    if (!ok) fprintf(stderr, "expected _json_merge_patch_diff() to succeed\n");
+    if (ok) ok = __json_equal("patch", patch, "{\"a\":{\"c\":4},\"d\":null,\"e\":[1,2],\"f\":{\"g\":true}}");
+
+    /* applying the patch gives the target without its nulls */
+    _json_merge_patch_apply(&base, patch);
+    if (ok) ok = __json_equal("base", base, "{\"a\":{\"b\":1,\"c\":4},\"e\":[1,2],\"f\":{\"g\":true}}");
+
+    cJSON_Delete(base);
+    cJSON_Delete(target);
+    cJSON_Delete(patch);
+
+    return ok;
+}
+
+static bool test_diff_unchanged(unit_test_ctx *ctx)
+{
+    cJSON *base = cJSON_Parse("{\"a\":{\"b\":1,\"c\":[1,2]},\"d\":\"x\"}");
+    cJSON *target = cJSON_Parse("{\"a\":{\"b\":1,\"c\":[1,2]},\"z\":null}");
+    cJSON *empty = cJSON_CreateObject();
+    cJSON *patch = NULL;
+
+    UT_PTR_NOT_NULL(base);
+    UT_PTR_NOT_NULL(target);
+    UT_PTR_NOT_NULL(empty);
+
+    /* equal members and nulls for members base doesn't have change nothing */
+    UT_BOOL_TRUE(_json_merge_patch_diff(base, target, &patch));
+    UT_PTR_NULL(patch);
+
+    UT_BOOL_TRUE(_json_merge_patch_diff(NULL, empty, &patch));
+    UT_PTR_NULL(patch);
+
+    /* the target must be an object */
+    UT_BOOL_FALSE(_json_merge_patch_diff(base, NULL, &patch));
+    UT_PTR_NULL(patch);
+
+    cJSON_Delete(base);
+    cJSON_Delete(target);
+    cJSON_Delete(empty);
+
+    return true;
+}
+
+static bool __json_equal(const char *name, const cJSON *json, const char *expected)
+{
+    cJSON *expected_json = cJSON_Parse(expected);
+    bool equal;
+
+    if (!expected_json) {
+        fprintf(stderr, "expected JSON %s is invalid\n", expected);
+        return false;
+    }
+
+    equal = json && cJSON_Compare(json, expected_json, 1);
+    if (!equal) {
+        char *text = json ? cJSON_PrintUnformatted(json) : NULL;
+
+        fprintf(stderr, "expected %s to be %s, result %s\n", name, expected, text ? text : "<null>");
+        if (text) cJSON_free(text);
+    }
+    cJSON_Delete(expected_json);
+
+    return equal;
+}
+
+/** Test descriptors **/
+
+static const unit_test_t test_apply_nested_desc = {
+    .name = "json-merge-patch: apply nested objects",
+    .fn = test_apply_nested
+};
+
+static const unit_test_t test_apply_nulls_desc = {
+    .name = "json-merge-patch: apply nulls",
+    .fn = test_apply_nulls
+};
+
+static const unit_test_t test_apply_replace_desc = {
+    .name = "json-merge-patch: apply non-object values",
+    .fn = test_apply_replace
+};
+
+static const unit_test_t test_diff_nested_desc = {
+    .name = "json-merge-patch: diff nested objects",
+    .fn = test_diff_nested
+};
+
+static const unit_test_t test_diff_unchanged_desc = {
+    .name = "json-merge-patch: diff with nothing changed",
+    .fn = test_diff_unchanged
+};
+
+__attribute__ ((constructor))
+static void _init_fn()
+{
+    register_unit_test(&test_apply_nested_desc);
+    register_unit_test(&test_apply_nulls_desc);
+    register_unit_test(&test_apply_replace_desc);
+    register_unit_test(&test_diff_nested_desc);
+    register_unit_test(&test_diff_unchanged_desc);
+}
+
+/* vim:ts=8:sts=4:sw=4:expandtab:
+ */
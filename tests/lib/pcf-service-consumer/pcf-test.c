@@ -161,7 +161,7 @@ static bool check_npcf_policyauthortization_af_session_create_result(pcf_app_ses
 
 static bool check_npcf_policyauthortization_af_session_update_result(pcf_app_session_t *result)
 {
-    if (!result  || !result->pcf_app_session_context_updates || !result->pcf_app_session_context_updates_received)
+    if (!result  || !result->pcf_app_session_context_updates_received || result->med_components.updates_in_flight)
             return false;
     return true;
 }
@@ -540,9 +540,10 @@ static void test1_func(abts_case *tc, void *data)
 
     ABTS_TRUE(tc, check_npcf_policyauthortization_evt_subsc_result(af_pcf_app_session));
 
+    /* change the bandwidths so there is something to update */
+    af_param.qos_type = 2;
     media_component = media_component_create(&af_param);
     ogs_assert(media_component);
-    af_pcf_app_session->pcf_app_session_context_updates = NULL;
     af_pcf_app_session->pcf_app_session_context_updates_received = NULL;
 
     pcf_session_update_app_session(af_pcf_app_session, media_component);
@@ -551,6 +552,13 @@ static void test1_func(abts_case *tc, void *data)
 
     ABTS_TRUE(tc, check_npcf_policyauthortization_af_session_update_result(af_pcf_app_session));
 
+    /* the same media components again send nothing */
+    media_component = media_component_create(&af_param);
+    ogs_assert(media_component);
+
+    ABTS_TRUE(tc, pcf_session_update_app_session(af_pcf_app_session, media_component));
+    ABTS_INT_EQUAL(tc, 0, af_pcf_app_session->med_components.updates_in_flight);
+
     pcf_app_session_unsubscribe_event(af_pcf_app_session, evt_subsc_req);
     
     ogs_msleep(10000);
@@ -0,0 +1,178 @@
+/*
+ * License: 5G-MAG Public License (v1.0)
+ * Copyright: (C) 2025 British Broadcasting Corporation
+ *
+ * For full license terms please see the LICENSE file distributed with this
+ * program. If this file is missing then the license can be retrieved from
+ * https://drive.google.com/file/d/1cinCiA778IErENZ3JN52VFW-1ffHpx7Z/view
+ */
+#include <stdbool.h>
+#include <string.h>
+
+#include "ogs-core.h"
+
+#include "pcf-service-consumer.h"
+#include "utils.h"
+
+#include "unit-test.h"
+
+#define PRESCAN(JSON, MASK) _events_notification_prescan((JSON), strlen(JSON), (MASK))
+
+static bool test_prescan_events(unit_test_ctx *ctx)
+{
+    int mask = -1;
+
+    UT_BOOL_TRUE(PRESCAN("{\"evNotifs\":[{\"event\":\"QOS_NOTIF\"}]}", &mask));
+    UT_INT_EQUAL(mask, PCF_APP_SESSION_EVENT_TYPE_QOS_NOTIF);
+
+    /* other members, whitespace and other AfEventNotification members are skipped */
+    UT_BOOL_TRUE(PRESCAN(" {\n  \"accessType\": \"3GPP_ACCESS\",\n  \"evNotifs\": [\n"
+                         "    {\"event\": \"USAGE_REPORT\", \"flows\": [{\"medCompN\": 1, \"fNums\": [1, 2]}]},\n"
+                         "    {\"flows\": [], \"event\": \"PLMN_CHG\"}\n  ],\n  \"ratType\": null\n} \n", &mask));
+    UT_INT_EQUAL(mask, PCF_APP_SESSION_EVENT_TYPE_USAGE_REPORT | PCF_APP_SESSION_EVENT_TYPE_PLMN_CHG);
+
+    return true;
+}
+
+static bool test_prescan_escaped(unit_test_ctx *ctx)
+{
+    int mask;
+
+    /* escapes in other strings are skipped over */
+    UT_BOOL_TRUE(PRESCAN("{\"note\":\"a \\\"quoted\\\" } ]\",\"evNotifs\":[{\"event\":\"PLMN_CHG\",\"x\":\"\\\\\"}]}",
+                         &mask));
+    UT_INT_EQUAL(mask, PCF_APP_SESSION_EVENT_TYPE_PLMN_CHG);
+
+    /* an escaped member name or event name can't be matched without decoding, so the body must be parsed */
+    UT_BOOL_FALSE(PRESCAN("{\"ev\\u004eotifs\":[{\"event\":\"QOS_NOTIF\"}]}", &mask));
+    UT_BOOL_FALSE(PRESCAN("{\"evNotifs\":[{\"ev\\u0065nt\":\"QOS_NOTIF\"}]}", &mask));
+    UT_BOOL_FALSE(PRESCAN("{\"evNotifs\":[{\"event\":\"QOS\\u005fNOTIF\"}]}", &mask));
+
+    return true;
+}
+
+static bool test_prescan_nested(unit_test_ctx *ctx)
+{
+    int mask;
+
+    /* only the top level evNotifs and the event members of its entries count */
+    UT_BOOL_TRUE(PRESCAN("{\"other\":{\"evNotifs\":[{\"event\":\"QOS_NOTIF\"}]},\"evNotifs\":[{\"event\":\"PLMN_CHG\"}]}",
+                         &mask));
+    UT_INT_EQUAL(mask, PCF_APP_SESSION_EVENT_TYPE_PLMN_CHG);
+
+    UT_BOOL_TRUE(PRESCAN("{\"evNotifs\":[{\"qncReports\":[{\"flows\":[{\"event\":\"QOS_NOTIF\"}]}],\"event\":\"ANI_REPORT\"}]}",
+                         &mask));
+    UT_INT_EQUAL(mask, PCF_APP_SESSION_EVENT_TYPE_ANI_REPORT);
+
+    /* a nested evNotifs on its own is no evNotifs at all */
+    UT_BOOL_FALSE(PRESCAN("{\"other\":{\"evNotifs\":[{\"event\":\"QOS_NOTIF\"}]}}", &mask));
+
+    return true;
+}
+
+static bool test_prescan_truncated(unit_test_ctx *ctx)
+{
+    static const char json[] = "{\"accessType\":\"3GPP_ACCESS\",\"evNotifs\":[{\"event\":\"QOS_NOTIF\",\"flows\":[{\"medCompN\":1}]},"
+                               "{\"event\":\"PLMN_CHG\"}],\"ratType\":null}";
+    size_t len;
+    int mask;
+
+    UT_BOOL_TRUE(_events_notification_prescan(json, sizeof(json) - 1, &mask));
+    UT_INT_EQUAL(mask, PCF_APP_SESSION_EVENT_TYPE_QOS_NOTIF | PCF_APP_SESSION_EVENT_TYPE_PLMN_CHG);
+
+    /* every truncation must be rejected rather than read past the end */
+    for (len = 0; len < sizeof(json) - 1; len++) {
+        if (_events_notification_prescan(json, len, &mask)) {
+            fprintf(stderr, "expected body truncated to %zu bytes to be rejected\n", len);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool test_prescan_malformed(unit_test_ctx *ctx)
+{
+    int mask;
+
+    UT_BOOL_FALSE(_events_notification_prescan(NULL, 0, &mask));
+    UT_BOOL_FALSE(PRESCAN("", &mask));
+    UT_BOOL_FALSE(PRESCAN("[]", &mask));
+    UT_BOOL_FALSE(PRESCAN("{}", &mask));
+    UT_BOOL_FALSE(PRESCAN("{\"evNotifs\":{\"event\":\"QOS_NOTIF\"}}", &mask));
+    UT_BOOL_FALSE(PRESCAN("{\"evNotifs\":[\"QOS_NOTIF\"]}", &mask));
+    UT_BOOL_FALSE(PRESCAN("{\"evNotifs\" [{\"event\":\"QOS_NOTIF\"}]}", &mask));
+    UT_BOOL_FALSE(PRESCAN("{\"evNotifs\":[{\"event\":\"QOS_NOTIF\"}] \"x\":1}", &mask));
+    UT_BOOL_FALSE(PRESCAN("{\"evNotifs\":[{\"event\":\"QOS_NOTIF\"}]}}", &mask));
+    UT_BOOL_FALSE(PRESCAN("{\"evNotifs\":[{\"event\":\"QOS_NOTIF\"}]} x", &mask));
+    UT_BOOL_FALSE(PRESCAN("{\"x\":],\"evNotifs\":[{\"event\":\"QOS_NOTIF\"}]}", &mask));
+
+    /* a second evNotifs would leave it unclear which one counts */
+    UT_BOOL_FALSE(PRESCAN("{\"evNotifs\":[{\"event\":\"QOS_NOTIF\"}],\"evNotifs\":[{\"event\":\"PLMN_CHG\"}]}", &mask));
+
+    return true;
+}
+
+static bool test_prescan_unknown_events(unit_test_ctx *ctx)
+{
+    int mask;
+
+    UT_BOOL_TRUE(PRESCAN("{\"evNotifs\":[{\"event\":\"NOT_AN_AF_EVENT\"},{\"event\":\"QOS_NOTIF\"}]}", &mask));
+    UT_INT_EQUAL(mask, PCF_APP_SESSION_EVENT_TYPE_QOS_NOTIF);
+
+    /* names longer than any AfEvent are not looked up */
+    UT_BOOL_TRUE(PRESCAN("{\"evNotifs\":[{\"event\":\"QOS_NOTIF_QOS_NOTIF_QOS_NOTIF_QOS_NOTIF_QOS_NOTIF\"}]}", &mask));
+    UT_INT_EQUAL(mask, PCF_APP_SESSION_EVENT_TYPE_NONE);
+
+    /* an event that isn't a string adds nothing */
+    UT_BOOL_TRUE(PRESCAN("{\"evNotifs\":[{\"event\":7},{\"event\":null}]}", &mask));
+    UT_INT_EQUAL(mask, PCF_APP_SESSION_EVENT_TYPE_NONE);
+
+    return true;
+}
+
+/** Test descriptors **/
+
+static const unit_test_t test_prescan_events_desc = {
+    .name = "events-prescan: find the notified events",
+    .fn = test_prescan_events
+};
+
+static const unit_test_t test_prescan_escaped_desc = {
+    .name = "events-prescan: escaped strings",
+    .fn = test_prescan_escaped
+};
+
+static const unit_test_t test_prescan_nested_desc = {
+    .name = "events-prescan: nested evNotifs and event members",
+    .fn = test_prescan_nested
+};
+
+static const unit_test_t test_prescan_truncated_desc = {
+    .name = "events-prescan: truncated bodies",
+    .fn = test_prescan_truncated
+};
+
+static const unit_test_t test_prescan_malformed_desc = {
+    .name = "events-prescan: malformed bodies",
+    .fn = test_prescan_malformed
+};
+
+static const unit_test_t test_prescan_unknown_events_desc = {
+    .name = "events-prescan: unknown events",
+    .fn = test_prescan_unknown_events
+};
+
+__attribute__ ((constructor))
+static void _init_fn()
+{
+    register_unit_test(&test_prescan_events_desc);
+    register_unit_test(&test_prescan_escaped_desc);
+    register_unit_test(&test_prescan_nested_desc);
+    register_unit_test(&test_prescan_truncated_desc);
+    register_unit_test(&test_prescan_malformed_desc);
+    register_unit_test(&test_prescan_unknown_events_desc);
+}
+
+/* vim:ts=8:sts=4:sw=4:expandtab:
+ */